@@ -0,0 +1,155 @@
+#include "acquisitionScheduler.hh"
+
+#include <algorithm>
+#include <ctime>
+
+#include "util.h"
+
+namespace cee {
+	// Address range selectable with the PCF8591's A0-A2 pins.
+	static constexpr uint32_t PCF8591_FIRST_ADDRESS = 0x48;
+	static constexpr uint32_t PCF8591_LAST_ADDRESS = 0x4F;
+
+	static int64_t GetMonotonicNs() {
+		timespec now;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		return static_cast<int64_t>(now.tv_sec) * NSEC_PER_SEC + now.tv_nsec;
+	}
+
+	AcquisitionScheduler::AcquisitionScheduler()
+	 : m_ChannelMap{ 0, 1, 2, 3 }, m_StartNs(GetMonotonicNs()), m_Target(nullptr),
+	   m_Generation(0), m_Pending(0), m_Failed(false), m_Stop(false)
+	{
+	}
+
+	AcquisitionScheduler::~AcquisitionScheduler() {
+		m_Stop.store(true);
+		m_Generation.fetch_add(1, std::memory_order_release);
+		m_Generation.notify_all();
+		for (auto&& bus : m_Buses) {
+			if (bus->worker.joinable())
+				bus->worker.join();
+		}
+	}
+
+	size_t AcquisitionScheduler::AddBus(const std::shared_ptr<I2C>& i2c, std::span<const uint32_t> addresses) {
+		std::vector<uint32_t> found(addresses.begin(), addresses.end());
+		if (found.empty()) {
+			for (uint32_t address : i2c->ScanForDevices()) {
+				if (address >= PCF8591_FIRST_ADDRESS && address <= PCF8591_LAST_ADDRESS)
+					found.push_back(address);
+			}
+		}
+
+		auto bus = std::make_unique<Bus>();
+		bus->i2c = i2c;
+		bus->firstDevice = m_Devices.size();
+		bus->deviceCount = found.size();
+		for (uint32_t address : found) {
+			auto device = std::make_unique<Device>();
+			device->adc = std::make_unique<ADC>(i2c, ADCType::PCF8591, address);
+			device->bus = static_cast<uint32_t>(m_Buses.size());
+			device->address = address;
+			device->transfers = 0;
+			device->failures = 0;
+			device->busyNs = 0;
+			m_Devices.push_back(std::move(device));
+		}
+		m_Frame.resize(GetChannelCount());
+
+		// The first bus is read on the caller's thread.
+		if (!m_Buses.empty())
+			bus->worker = std::thread(&AcquisitionScheduler::Worker, this, bus.get());
+		m_Buses.push_back(std::move(bus));
+		return found.size();
+	}
+
+	void AcquisitionScheduler::SetChannelMap(std::span<const uint32_t, 4> channels) {
+		std::copy(channels.begin(), channels.end(), m_ChannelMap);
+	}
+
+	void AcquisitionScheduler::ReadBus(const Bus& bus) {
+		for (size_t i = bus.firstDevice; i < bus.firstDevice + bus.deviceCount; i++) {
+			Device& device = *m_Devices[i];
+			int64_t start = GetMonotonicNs();
+			bool ok = device.adc->ReadAllChannels(std::span<uint8_t, 4>(m_Target + i * 4, 4));
+			device.busyNs.fetch_add(GetMonotonicNs() - start, std::memory_order_relaxed);
+			device.transfers.fetch_add(1, std::memory_order_relaxed);
+			if (!ok) {
+				device.failures.fetch_add(1, std::memory_order_relaxed);
+				m_Failed.store(true, std::memory_order_relaxed);
+			}
+		}
+	}
+
+	void AcquisitionScheduler::Worker(const Bus* bus) {
+		uint64_t seen = 0;
+		for (;;) {
+			m_Generation.wait(seen, std::memory_order_acquire);
+			seen = m_Generation.load(std::memory_order_acquire);
+			if (m_Stop.load())
+				return;
+
+			ReadBus(*bus);
+			if (m_Pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+				m_Pending.notify_one();
+		}
+	}
+
+	bool AcquisitionScheduler::AcquireAll(std::span<uint8_t> frame) {
+		if (m_Buses.empty() || frame.size() < GetChannelCount())
+			return false;
+
+		m_Target = frame.data();
+		m_Failed.store(false, std::memory_order_relaxed);
+		m_Pending.store(static_cast<uint32_t>(m_Buses.size() - 1), std::memory_order_relaxed);
+		m_Generation.fetch_add(1, std::memory_order_release);
+		m_Generation.notify_all();
+
+		ReadBus(*m_Buses[0]);
+
+		uint32_t pending;
+		while ((pending = m_Pending.load(std::memory_order_acquire)) != 0) {
+			m_Pending.wait(pending, std::memory_order_acquire);
+		}
+		return !m_Failed.load(std::memory_order_relaxed);
+	}
+
+	bool AcquisitionScheduler::Acquire(int64_t, std::span<uint8_t, 4> samples) {
+		if (!AcquireAll(m_Frame))
+			return false;
+
+		for (size_t i = 0; i < samples.size(); i++) {
+			samples[i] = m_ChannelMap[i] < m_Frame.size() ? m_Frame[m_ChannelMap[i]] : 0;
+		}
+		return true;
+	}
+
+	std::vector<AcquisitionDeviceStats> AcquisitionScheduler::GetStats() const {
+		double elapsed = static_cast<double>(GetMonotonicNs() - m_StartNs);
+		std::vector<AcquisitionDeviceStats> stats;
+		stats.reserve(m_Devices.size());
+		for (auto&& device : m_Devices) {
+			AcquisitionDeviceStats deviceStats;
+			deviceStats.bus = device->bus;
+			deviceStats.address = device->address;
+			deviceStats.transfers = device->transfers.load(std::memory_order_relaxed);
+			deviceStats.failures = device->failures.load(std::memory_order_relaxed);
+			deviceStats.utilisation = elapsed > 0.0 ? device->busyNs.load(std::memory_order_relaxed) / elapsed : 0.0;
+			stats.push_back(deviceStats);
+		}
+		return stats;
+	}
+
+	void AcquisitionScheduler::PrintStats(FILE* stream) const {
+		for (auto&& device : GetStats()) {
+			fprintf(stream, "Bus %u device 0x%.2X: %llu transfers, %llu failures, %.1f%% bus utilisation\n",
+					device.bus, device.address,
+					static_cast<unsigned long long>(device.transfers),
+					static_cast<unsigned long long>(device.failures),
+					device.utilisation * 100.0);
+		}
+		fflush(stream);
+	}
+}
+
@@ -0,0 +1,93 @@
+#ifndef CEE_ACQUISITION_SCHEDULER_H_
+#define CEE_ACQUISITION_SCHEDULER_H_
+
+#include <atomic>
+#include <memory>
+#include <span>
+#include <thread>
+#include <vector>
+
+#include <cstdint>
+#include <cstdio>
+
+#include "adc.hh"
+#include "i2c.hh"
+#include "sampleSource.hh"
+
+namespace cee {
+	struct AcquisitionDeviceStats {
+		uint32_t bus;
+		uint32_t address;
+		uint64_t transfers;
+		uint64_t failures;
+		double utilisation; // fraction of wall time the bus spent on this device
+	};
+
+	// Owns several PCF8591s spread over one or more I2C buses and reads one
+	// four-channel frame from every device per sample period. Devices on a
+	// bus are read back to back; separate buses run in parallel, the first
+	// one on the calling thread and the rest on worker threads.
+	class AcquisitionScheduler : public SampleSource {
+	public:
+		AcquisitionScheduler();
+		virtual ~AcquisitionScheduler();
+
+		// Adds a bus with the given devices, or every PCF8591 found by
+		// ScanForDevices if `addresses` is empty. Returns the number of
+		// devices added.
+		size_t AddBus(const std::shared_ptr<I2C>& i2c, std::span<const uint32_t> addresses = {});
+
+		size_t GetDeviceCount() const { return m_Devices.size(); }
+		size_t GetChannelCount() const { return m_Devices.size() * 4; }
+
+		// Chooses which of the scheduler's channels (device * 4 + input)
+		// feeds each cee::EcgChannel in Acquire().
+		void SetChannelMap(std::span<const uint32_t, 4> channels);
+
+		// Reads every device; frame holds GetChannelCount() bytes in device
+		// order.
+		bool AcquireAll(std::span<uint8_t> frame);
+
+		virtual bool Acquire(int64_t timestamp, std::span<uint8_t, 4> samples) override;
+		virtual const char* GetName() const override { return "multi"; }
+
+		std::vector<AcquisitionDeviceStats> GetStats() const;
+		virtual void PrintStats(FILE* stream) const override;
+
+	private:
+		struct Device {
+			std::unique_ptr<ADC> adc;
+			uint32_t bus;
+			uint32_t address;
+			std::atomic<uint64_t> transfers;
+			std::atomic<uint64_t> failures;
+			std::atomic<uint64_t> busyNs;
+		};
+
+		struct Bus {
+			std::shared_ptr<I2C> i2c;
+			size_t firstDevice;
+			size_t deviceCount;
+			std::thread worker;
+		};
+
+		void ReadBus(const Bus& bus);
+		void Worker(const Bus* bus);
+
+	private:
+		std::vector<std::unique_ptr<Bus>> m_Buses;
+		std::vector<std::unique_ptr<Device>> m_Devices;
+		uint32_t m_ChannelMap[4];
+		std::vector<uint8_t> m_Frame;
+		int64_t m_StartNs;
+
+		uint8_t* m_Target;
+		std::atomic<uint64_t> m_Generation;
+		std::atomic<uint32_t> m_Pending;
+		std::atomic<bool> m_Failed;
+		std::atomic<bool> m_Stop;
+	};
+}
+
+#endif
+
@@ -1,11 +1,16 @@
 #include "adc.hh"
 
 #include <cassert>
+#include <cstring>
 
 namespace cee {
 	ADC::ADC(const std::shared_ptr<I2C>& i2c, ADCType type, uint32_t address, uint32_t channel, bool autoIncrement)
 	 : m_I2CBus(i2c), m_Type(type), m_Address(address), m_Channel(channel), m_AutoIncrement(autoIncrement)
 	{
+		if (!m_I2CBus->CheckForDevice(m_Address)) {
+			printf("ADC WARNING: no device found at 0x%.2X\n", m_Address);
+			fflush(stdout);
+		}
 		SetControlByte();
 	}
 
@@ -20,8 +25,26 @@ namespace cee {
 	}
 
 	uint8_t ADC::ReadChannel(uint32_t channel) {
-		SetChannel(channel);
-		return Read();
+		switch (m_Type) {
+		case ADCType::PCF8591:
+		{
+			// Program the channel and read the conversion in one combined
+			// transaction instead of a separate write and read. The first
+			// byte is the previous conversion, from whichever channel was
+			// selected before, so as in ReadBlock it is read and dropped.
+			m_Channel = channel;
+			uint8_t controlByte = GetControlByte();
+			uint8_t buffer[] = { 0, 0 };
+			if (m_I2CBus->WriteReadDevice(m_Address, &controlByte, 1, buffer, 2) == 2) {
+				return buffer[1];
+			}
+		}
+		break;
+
+		default:
+			assert(0 &&"Unsupported ADC type");
+		}
+		return static_cast<uint8_t>(-1);
 	}
 
 	uint8_t ADC::Read() {
@@ -41,15 +64,53 @@ namespace cee {
 		return static_cast<uint8_t>(-1);
 	}
 
-	void ADC::SetControlByte() {
+	bool ADC::ReadAllChannels(std::span<uint8_t, 4> samples) {
+		return ReadBlock(samples.data(), 1);
+	}
+
+	bool ADC::ReadBlock(uint8_t* data, size_t frames) {
 		switch (m_Type) {
 		case ADCType::PCF8591:
 		{
-			if (m_Channel > 3) {
-				printf("ADC WARNING: setting wrong channel (%u), setting to 0\n", m_Channel);
-				m_Channel = 0;
+			// The PCF8591 returns the previous conversion as the first byte
+			// of every read, so one extra leading byte is fetched and dropped.
+			size_t size = frames * 4 + 1;
+			if (size > UINT16_MAX) {
+				printf("ADC WARNING: burst of %zu frames too large\n", frames);
+				return false;
 			}
-			uint8_t controlByte = 0x40 | ((!!m_AutoIncrement) << 2) | (m_Channel & 0b11);
+			if (m_BurstBuffer.size() < size)
+				m_BurstBuffer.resize(size);
+
+			// Auto-increment from channel 0, without touching m_Channel or
+			// m_AutoIncrement so single channel reads are unaffected.
+			uint8_t controlByte = 0x40 | (1 << 2);
+			if (m_I2CBus->WriteReadDevice(m_Address, &controlByte, 1, m_BurstBuffer.data(), size) != static_cast<ssize_t>(size)) {
+				return false;
+			}
+			memcpy(data, m_BurstBuffer.data() + 1, frames * 4);
+			return true;
+		}
+
+		default:
+			assert(0 &&"Unsupported ADC type");
+		}
+		return false;
+	}
+
+	uint8_t ADC::GetControlByte() {
+		if (m_Channel > 3) {
+			printf("ADC WARNING: setting wrong channel (%u), setting to 0\n", m_Channel);
+			m_Channel = 0;
+		}
+		return 0x40 | ((!!m_AutoIncrement) << 2) | (m_Channel & 0b11);
+	}
+
+	void ADC::SetControlByte() {
+		switch (m_Type) {
+		case ADCType::PCF8591:
+		{
+			uint8_t controlByte = GetControlByte();
 			if (m_I2CBus->WriteToDevice(m_Address, &controlByte, 1) != 1) {
 				printf("Failed setting ADC 0x%.2X control byte\n", m_Address);
 				fflush(stdout);
@@ -2,6 +2,8 @@
 #define CEE_ADC_H_
 
 #include <memory>
+#include <span>
+#include <vector>
 
 #include "i2c.hh"
 
@@ -21,9 +23,16 @@ namespace cee {
 		uint8_t ReadChannel(uint32_t channel);
 		uint8_t Read();
 
+		// Reads all four inputs in one auto-incrementing burst.
+		bool ReadAllChannels(std::span<uint8_t, 4> samples);
+		// Reads `frames` consecutive four-channel frames in one transfer,
+		// channel-interleaved into data (frames * 4 bytes).
+		bool ReadBlock(uint8_t* data, size_t frames);
+
 	private:
 		void SetControlByte();
 		void SetChannel(uint32_t channel);
+		uint8_t GetControlByte();
 
 	private:
 		std::shared_ptr<I2C> m_I2CBus;
@@ -31,6 +40,7 @@ namespace cee {
 		uint32_t m_Address;
 		uint32_t m_Channel;
 		bool m_AutoIncrement;
+		std::vector<uint8_t> m_BurstBuffer;
 	};
 }
 
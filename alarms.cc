@@ -0,0 +1,26 @@
+#include "alarms.hh"
+
+namespace cee {
+	constexpr uint32_t EXTREME_TACHY_RATE = 150;
+	constexpr uint32_t TACHY_RATE = 120;
+	constexpr uint32_t BRADY_RATE = 50;
+	constexpr uint32_t EXTREME_BRADY_RATE = 40;
+
+	Alarm EvaluateAlarm(uint32_t rate, bool leadsConnected, uint8_t quality) {
+		if (!leadsConnected)
+			return { AlarmLevel::CYAN, "ECG LEADS OFF" };
+		if (quality < MIN_ANALYSIS_QUALITY)
+			return { AlarmLevel::CYAN, "ECG NOISY" };
+		if (rate > EXTREME_TACHY_RATE)
+			return { AlarmLevel::RED, "**XTREME TACHY" };
+		if (rate > TACHY_RATE)
+			return { AlarmLevel::YELLOW, "*TACHY" };
+		if (rate == 0)
+			return { AlarmLevel::RED, "***ASYSTOLE" };
+		if (rate < EXTREME_BRADY_RATE)
+			return { AlarmLevel::RED, "**XTREME BRADY" };
+		if (rate < BRADY_RATE)
+			return { AlarmLevel::YELLOW, "*BRADY" };
+		return { AlarmLevel::NONE, nullptr };
+	}
+}
@@ -0,0 +1,29 @@
+#ifndef CEE_ALARMS_H_
+#define CEE_ALARMS_H_
+
+#include <cstdint>
+
+namespace cee {
+	// In increasing priority; values match the bedside alarm sounds.
+	enum class AlarmLevel : int8_t {
+		NONE   = 0,
+		CYAN   = 1,
+		YELLOW = 2,
+		RED    = 3
+	};
+
+	struct Alarm {
+		AlarmLevel level;
+		const char* message;  // nullptr with AlarmLevel::NONE
+	};
+
+	// Samples scoring below this are left out of beat detection.
+	constexpr uint8_t MIN_ANALYSIS_QUALITY = 10;
+
+	// The bedside alarm for one patient. With a lead off or the signal too
+	// noisy to analyse the rate is stale, so that is reported instead of a
+	// rate alarm.
+	Alarm EvaluateAlarm(uint32_t rate, bool leadsConnected, uint8_t quality);
+}
+
+#endif
@@ -0,0 +1,286 @@
+#include "beatClassifier.hh"
+
+#include <algorithm>
+#include <cmath>
+
+#include "dspKernels.hh"
+
+namespace cee {
+	constexpr float MATCH_CORRELATION = 0.9f;
+	constexpr float MISMATCH_CORRELATION = 0.75f;
+	// Below this rate the QRS is only a few samples wide and sampling phase
+	// alone costs about 0.1 of correlation, so both limits are relaxed.
+	constexpr float LOW_SAMPLE_RATE = 150.f;
+	constexpr float LOW_RATE_RELAXATION = 0.12f;
+	constexpr float WIDE_QRS_MS = 120.f;
+	// Wider than the template by this much counts as wide too.
+	constexpr float WIDENING_MS = 40.f;
+	constexpr double PREMATURE_RR_FRACTION = 0.85;
+	constexpr float TEMPLATE_RATE = 1.f / 8.f;
+	// Slope fraction of the steepest QRS slope that marks onset and offset.
+	constexpr float QRS_EDGE_FRACTION = 0.2f;
+	constexpr size_t SNIPPET_RING = 32;
+	// The detector's R position wanders by a sample or two between beats,
+	// more so at low sample rates, so correlation is taken at the best of
+	// a few shifts.
+	constexpr int32_t MAX_ALIGN_SHIFT = 2;
+
+	const char* GetBeatClassName(BeatClass beatClass) {
+		switch (beatClass) {
+		case BeatClass::UNCLASSIFIED: return "unclassified";
+		case BeatClass::NORMAL: return "normal";
+		case BeatClass::PVC: return "pvc";
+		case BeatClass::UNKNOWN: return "unknown";
+		}
+		return "unknown";
+	}
+
+	BeatClassifier::BeatClassifier(float sampleRate)
+	 : m_SampleRate(sampleRate)
+	{
+		m_PreSamples = static_cast<size_t>(std::lround(0.2f * sampleRate));
+		m_PostSamples = static_cast<size_t>(std::lround(0.3f * sampleRate));
+		m_SnippetLength = m_PreSamples + 1 + m_PostSamples;
+		m_QrsSearchSamples = std::max<size_t>(1, static_cast<size_t>(std::lround(0.1f * sampleRate)));
+		// Correlation covers the QRS (-120 ms to +160 ms) rather than the
+		// whole snippet, whose T wave moves with rate.
+		m_CorrelationBegin = m_PreSamples - std::min(m_PreSamples - MAX_ALIGN_SHIFT, static_cast<size_t>(std::lround(0.12f * sampleRate)));
+		m_CorrelationLength = std::min(m_SnippetLength - MAX_ALIGN_SHIFT - m_CorrelationBegin,
+				static_cast<size_t>(std::lround(0.28f * sampleRate)) + 1);
+
+		float relaxation = sampleRate < LOW_SAMPLE_RATE ? LOW_RATE_RELAXATION : 0.f;
+		m_MatchCorrelation = MATCH_CORRELATION - relaxation;
+		m_MismatchCorrelation = MISMATCH_CORRELATION - relaxation;
+
+		m_Snippets.resize(SNIPPET_RING * m_SnippetLength);
+		m_SnippetWidths.resize(SNIPPET_RING);
+		m_SnippetReseedable.resize(SNIPPET_RING);
+		m_Template.resize(m_SnippetLength);
+		Reset();
+	}
+
+	void BeatClassifier::Reset() {
+		m_PendingCount = 0;
+		m_SnippetCount = 0;
+		m_NextSnippet = 0;
+		std::fill(m_Template.begin(), m_Template.end(), 0.f);
+		m_TemplateWidth = 0.f;
+		m_HaveTemplate = false;
+		m_UnmatchedRun = 0;
+		m_LastBeatTimestamp = 0;
+		m_RrAverage = 0.0;
+		m_HaveBeat = false;
+	}
+
+	void BeatClassifier::AddBeat(const BeatEvent& beat) {
+		// Beats come in order, so if the queue is full the oldest is stale.
+		if (m_PendingCount == MAX_PENDING) {
+			std::copy(m_Pending + 1, m_Pending + MAX_PENDING, m_Pending);
+			m_PendingCount--;
+		}
+		m_Pending[m_PendingCount++] = beat;
+	}
+
+	size_t BeatClassifier::Process(std::span<const EcgFixed> lead, uint64_t headSequence, BeatClassification* out, size_t maxCount) {
+		size_t done = 0;
+		while (done < m_PendingCount && done < maxCount) {
+			const BeatEvent& beat = m_Pending[done];
+			// The R peak is refined within +/-m_QrsSearchSamples, so the
+			// snippet may reach that much further either way.
+			if (beat.sequence + m_PostSamples + m_QrsSearchSamples >= headSequence)
+				break;
+			if (beat.sequence < m_PreSamples + m_QrsSearchSamples
+					|| beat.sequence + lead.size() < headSequence + m_PreSamples + m_QrsSearchSamples) {
+				// Not (or no longer) fully in the lead history.
+				out[done] = { beat.sequence, beat.timestamp, BeatClass::UNCLASSIFIED, 0.f, 0.f, 0.f };
+			} else {
+				out[done] = Classify(beat, lead);
+			}
+			done++;
+		}
+
+		std::copy(m_Pending + done, m_Pending + m_PendingCount, m_Pending);
+		m_PendingCount -= done;
+		return done;
+	}
+
+	void BeatClassifier::ExtractSnippet(const BeatEvent& beat, std::span<const EcgFixed> lead, float* snippet) const {
+		const size_t mask = lead.size() - 1;
+
+		// The detector's position is where the slope peaked, which can be
+		// on either side of the R wave; use the largest deflection nearby.
+		uint64_t peak = beat.sequence;
+		int32_t peakValue = -1;
+		for (uint64_t sequence = beat.sequence - m_QrsSearchSamples; sequence <= beat.sequence + m_QrsSearchSamples; sequence++) {
+			int32_t value = std::abs(static_cast<int32_t>(lead[sequence & mask]));
+			if (value > peakValue) {
+				peakValue = value;
+				peak = sequence;
+			}
+		}
+
+		const uint64_t first = peak - m_PreSamples;
+		float mean = 0.f;
+		for (size_t n = 0; n < m_SnippetLength; n++) {
+			snippet[n] = lead[(first + n) & mask];
+			mean += snippet[n];
+		}
+		mean /= m_SnippetLength;
+		for (size_t n = 0; n < m_SnippetLength; n++)
+			snippet[n] -= mean;
+	}
+
+	float BeatClassifier::Correlate(const float* a, const float* b, int32_t* bestShift) const {
+		const float* window = a + m_CorrelationBegin;
+		const float aEnergy = DotProduct(window, window, m_CorrelationLength);
+		float best = -1.f;
+		for (int32_t shift = -MAX_ALIGN_SHIFT; shift <= MAX_ALIGN_SHIFT; shift++) {
+			const float* shifted = b + m_CorrelationBegin + shift;
+			float bEnergy = DotProduct(shifted, shifted, m_CorrelationLength);
+			if (aEnergy <= 0.f || bEnergy <= 0.f)
+				continue;
+			float correlation = DotProduct(window, shifted, m_CorrelationLength) / std::sqrt(aEnergy * bEnergy);
+			if (correlation > best) {
+				best = correlation;
+				if (bestShift)
+					*bestShift = shift;
+			}
+		}
+		return best;
+	}
+
+	float BeatClassifier::MeasureQrsWidth(const float* snippet) const {
+		// Search +/-100 ms around the R peak for the steepest slope, then
+		// walk out from the peak until the slope falls below a fraction of
+		// it.
+		const size_t center = m_PreSamples;
+		const size_t begin = center > m_QrsSearchSamples ? center - m_QrsSearchSamples : 1;
+		const size_t end = std::min(center + m_QrsSearchSamples, m_SnippetLength - 1);
+		auto slope = [snippet](size_t n) { return std::fabs(snippet[n] - snippet[n - 1]); };
+
+		float maxSlope = 0.f;
+		for (size_t n = begin; n <= end; n++)
+			maxSlope = std::max(maxSlope, slope(n));
+		if (maxSlope <= 0.f)
+			return 0.f;
+
+		const float edge = maxSlope * QRS_EDGE_FRACTION;
+		size_t onset = center;
+		while (onset > begin && slope(onset) > edge)
+			onset--;
+		size_t offset = center + 1;
+		while (offset < end && slope(offset) > edge)
+			offset++;
+
+		return (offset - onset) * 1000.f / m_SampleRate;
+	}
+
+	BeatClassification BeatClassifier::Classify(const BeatEvent& beat, std::span<const EcgFixed> lead) {
+		float* snippet = m_Snippets.data() + m_NextSnippet * m_SnippetLength;
+		ExtractSnippet(beat, lead, snippet);
+		const size_t slot = m_NextSnippet;
+		float width = MeasureQrsWidth(snippet);
+		m_SnippetWidths[slot] = width;
+		m_SnippetReseedable[slot] = false;
+		m_NextSnippet = (m_NextSnippet + 1) % SNIPPET_RING;
+		m_SnippetCount = std::min(m_SnippetCount + 1, SNIPPET_RING);
+
+		int64_t rr = m_HaveBeat ? beat.timestamp - m_LastBeatTimestamp : 0;
+		m_LastBeatTimestamp = beat.timestamp;
+		m_HaveBeat = true;
+
+		BeatClassification result = { beat.sequence, beat.timestamp, BeatClass::UNCLASSIFIED, 0.f, width, snippet[m_PreSamples] };
+		if (!m_HaveTemplate) {
+			if (m_SnippetCount >= LEARNING_BEATS)
+				SeedTemplate(false);
+			if (rr > 0)
+				m_RrAverage = m_RrAverage > 0.0 ? m_RrAverage + (rr - m_RrAverage) * TEMPLATE_RATE : rr;
+			return result;
+		}
+
+		int32_t shift = 0;
+		result.correlation = Correlate(m_Template.data(), snippet, &shift);
+		bool wide = width > WIDE_QRS_MS || width > m_TemplateWidth + WIDENING_MS;
+		bool premature = rr > 0 && m_RrAverage > 0.0 && rr < PREMATURE_RR_FRACTION * m_RrAverage;
+
+		if (result.correlation >= m_MatchCorrelation && !wide) {
+			result.beatClass = BeatClass::NORMAL;
+		} else if ((result.correlation < m_MismatchCorrelation || wide) && premature) {
+			result.beatClass = BeatClass::PVC;
+		} else if (result.correlation < m_MismatchCorrelation && wide) {
+			// Grossly different and wide is ventricular even without
+			// prematurity, e.g. an escape beat.
+			result.beatClass = BeatClass::PVC;
+		} else {
+			result.beatClass = BeatClass::UNKNOWN;
+		}
+
+		// A long run of narrow, on-time beats that all fail to match means
+		// the dominant morphology has changed (or the seed was poor): learn
+		// it again from those beats. Wide or premature beats neither count
+		// nor break the run, so a run of VT can't become the template.
+		if (result.beatClass == BeatClass::NORMAL) {
+			m_UnmatchedRun = 0;
+		} else if (!wide && !premature) {
+			m_SnippetReseedable[slot] = true;
+			if (++m_UnmatchedRun >= LEARNING_BEATS) {
+				SeedTemplate(true);
+				m_UnmatchedRun = 0;
+			}
+		}
+
+		if (result.beatClass == BeatClass::NORMAL) {
+			// Averaged in at the aligned position, so the template doesn't
+			// smear.
+			size_t begin = std::max<int32_t>(0, -shift);
+			size_t end = m_SnippetLength - std::max<int32_t>(0, shift);
+			for (size_t n = begin; n < end; n++)
+				m_Template[n] += (snippet[n + shift] - m_Template[n]) * TEMPLATE_RATE;
+			m_TemplateWidth += (width - m_TemplateWidth) * TEMPLATE_RATE;
+			if (rr > 0)
+				m_RrAverage += (rr - m_RrAverage) * TEMPLATE_RATE;
+		}
+		return result;
+	}
+
+	void BeatClassifier::SeedTemplate(bool reseed) {
+		// The medoid of the last LEARNING_BEATS beats, or when reseeding of
+		// the last LEARNING_BEATS narrow, on-time ones: the one with the
+		// highest total correlation against the rest.
+		size_t candidates[LEARNING_BEATS];
+		size_t count = 0;
+		for (size_t k = 0; k < m_SnippetCount && count < LEARNING_BEATS; k++) {
+			size_t slot = (m_NextSnippet + SNIPPET_RING - 1 - k) % SNIPPET_RING;
+			if (!reseed || m_SnippetReseedable[slot])
+				candidates[count++] = slot;
+		}
+		if (count == 0)
+			return;
+
+		size_t best = candidates[0];
+		float bestScore = -static_cast<float>(LEARNING_BEATS);
+		for (size_t i = 0; i < count; i++) {
+			const float* a = m_Snippets.data() + candidates[i] * m_SnippetLength;
+			float score = 0.f;
+			for (size_t j = 0; j < count; j++) {
+				if (i != j)
+					score += Correlate(a, m_Snippets.data() + candidates[j] * m_SnippetLength, nullptr);
+			}
+			if (score > bestScore) {
+				bestScore = score;
+				best = candidates[i];
+			}
+		}
+
+		// A new morphology has to be consistent from beat to beat; a run of
+		// noise or mixed beats keeps the old template.
+		if (reseed && bestScore < m_MatchCorrelation * (count - 1))
+			return;
+
+		const float* seed = m_Snippets.data() + best * m_SnippetLength;
+		std::copy(seed, seed + m_SnippetLength, m_Template.begin());
+		m_TemplateWidth = m_SnippetWidths[best];
+		m_HaveTemplate = true;
+	}
+}
+
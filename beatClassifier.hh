@@ -0,0 +1,112 @@
+#ifndef CEE_BEAT_CLASSIFIER_H_
+#define CEE_BEAT_CLASSIFIER_H_
+
+#include <span>
+#include <vector>
+
+#include <cstdint>
+#include <cstddef>
+
+#include "fixedPoint.hh"
+#include "qrsDetector.hh"
+
+namespace cee {
+	enum class BeatClass : uint8_t {
+		UNCLASSIFIED = 0,
+		NORMAL,
+		PVC,
+		UNKNOWN       // doesn't match the template but isn't premature
+	};
+
+	const char* GetBeatClassName(BeatClass beatClass);
+
+	struct BeatClassification {
+		uint64_t sequence;
+		int64_t timestamp;
+		BeatClass beatClass;
+		float correlation;   // against the dominant template, -1 to 1
+		float qrsWidthMs;
+		float rAmplitude;    // R peak above the snippet mean, EcgFixed units
+	};
+
+	// Classifies detector beats against a running dominant-beat template.
+	// Each beat is cut from the lead as a snippet 200 ms before to 300 ms
+	// after the R peak, compared to the template by normalised cross
+	// correlation over the QRS (DotProduct kernel), allowing a couple of
+	// samples of misalignment, and measured for QRS width. A beat
+	// that matches poorly or is wide, and arrives early, is a PVC; beats
+	// that match update the template.
+	// The template is seeded from the first LEARNING_BEATS beats by taking
+	// the one that best matches the others, so a PVC early on can't become
+	// the template. It is seeded again the same way after LEARNING_BEATS
+	// narrow, on-time beats fail to match with no normal beat between, if
+	// those beats agree with each other; wide or premature beats are never
+	// used, so a run of VT can't take over. Snippets live in a preallocated
+	// ring and nothing allocates once constructed.
+	class BeatClassifier {
+	public:
+		static constexpr size_t LEARNING_BEATS = 8;
+		static constexpr size_t MAX_PENDING = 8;
+
+	public:
+		BeatClassifier(float sampleRate);
+		~BeatClassifier() = default;
+
+		void Reset();
+
+		// Queues a beat until the lead holds its whole snippet.
+		void AddBeat(const BeatEvent& beat);
+		// `lead` is a sequence-indexed ring (LeadBuffer::GetLead) whose
+		// newest sample is headSequence - 1. Classifies every queued beat
+		// whose snippet is complete; returns the number written to `out`.
+		size_t Process(std::span<const EcgFixed> lead, uint64_t headSequence, BeatClassification* out, size_t maxCount);
+
+		size_t GetSnippetLength() const { return m_SnippetLength; }
+		bool HasTemplate() const { return m_HaveTemplate; }
+
+	private:
+		BeatClassification Classify(const BeatEvent& beat, std::span<const EcgFixed> lead);
+		// Copies the snippet with its mean removed.
+		void ExtractSnippet(const BeatEvent& beat, std::span<const EcgFixed> lead, float* snippet) const;
+		// Best normalised correlation of the QRS window of `a` against `b`
+		// shifted by up to MAX_ALIGN_SHIFT samples.
+		float Correlate(const float* a, const float* b, int32_t* bestShift) const;
+		float MeasureQrsWidth(const float* snippet) const;
+		// `reseed` limits the candidates to narrow, on-time beats and
+		// requires them to agree.
+		void SeedTemplate(bool reseed);
+
+	private:
+		float m_SampleRate;
+		size_t m_PreSamples;
+		size_t m_PostSamples;
+		size_t m_SnippetLength;
+		size_t m_QrsSearchSamples;
+		size_t m_CorrelationBegin;
+		size_t m_CorrelationLength;
+		float m_MatchCorrelation;
+		float m_MismatchCorrelation;
+
+		BeatEvent m_Pending[MAX_PENDING];
+		size_t m_PendingCount;
+
+		// Ring of recent snippets, m_SnippetLength floats each.
+		std::vector<float> m_Snippets;
+		std::vector<float> m_SnippetWidths;
+		std::vector<uint8_t> m_SnippetReseedable;
+		size_t m_SnippetCount;
+		size_t m_NextSnippet;
+
+		std::vector<float> m_Template;
+		float m_TemplateWidth;
+		bool m_HaveTemplate;
+		uint32_t m_UnmatchedRun;
+
+		int64_t m_LastBeatTimestamp;
+		double m_RrAverage;     // ns, normal beats only
+		bool m_HaveBeat;
+	};
+}
+
+#endif
+
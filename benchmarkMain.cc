@@ -0,0 +1,790 @@
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <cmath>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+
+#include "util.h"
+#include "adc.hh"
+#include "dataProcessing.hh"
+#include "dspKernels.hh"
+#include "ecgSample.hh"
+#include "hrv.hh"
+#include "i2c.hh"
+#include "qrsDetector.hh"
+#include "runningMedian.hh"
+#include "sampleSource.hh"
+#include "virtualI2C.hh"
+
+#define PCF8591_ADDRESS          0x48
+#define KERNEL_BENCH_SAMPLES     (1 << 24)
+#define HRV_WINDOW               300
+#define HRV_SPECTRUM_PERIOD_NS   10000000000ll
+#define HRV_CHECK_BEATS          997
+#define MEDIAN_BENCH_SAMPLES     1000000
+#define MEDIAN_NAIVE_SAMPLES     100000
+#define DETECTOR_SECONDS         300
+
+static int64_t GetMonotonicNs() {
+	timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return static_cast<int64_t>(now.tv_sec) * NSEC_PER_SEC + now.tv_nsec;
+}
+
+// Mock I2C bus: the real cee::I2C runs against a descriptor on /dev/null
+// and the target is linked with --wrap for ioctl, read and write, so every
+// syscall it makes on that descriptor is counted and answered by an
+// emulated PCF8591 instead of reaching the kernel.
+struct MockBusCounters {
+	uint64_t syscalls;
+	uint64_t transactions;   // START to STOP on the wire, probes included
+	uint64_t bytes;
+};
+
+static int g_MockFd = -1;
+static MockBusCounters g_MockCounters;
+static uint32_t g_MockSlave = 0;
+static uint8_t g_MockControl = 0;
+static uint8_t g_MockConversion = 0x80;
+
+static void MockWriteControl(const uint8_t* data, size_t size) {
+	if (size > 0)
+		g_MockControl = data[0];
+}
+
+static void MockReadConversions(uint8_t* data, size_t size) {
+	uint32_t channel = g_MockControl & 0b11;
+	for (size_t i = 0; i < size; i++) {
+		data[i] = g_MockConversion;
+		g_MockConversion = static_cast<uint8_t>(0x40 * channel + i);
+		if (g_MockControl & (1 << 2))
+			channel = (channel + 1) & 0b11;
+	}
+}
+
+extern "C" {
+	int __real_ioctl(int fd, unsigned long request, ...);
+	ssize_t __real_read(int fd, void* data, size_t size);
+	ssize_t __real_write(int fd, const void* data, size_t size);
+
+	int __wrap_ioctl(int fd, unsigned long request, ...) {
+		va_list args;
+		va_start(args, request);
+		void* argument = va_arg(args, void*);
+		va_end(args);
+		if (fd != g_MockFd)
+			return __real_ioctl(fd, request, argument);
+
+		g_MockCounters.syscalls++;
+		if (request == I2C_SLAVE) {
+			g_MockSlave = static_cast<uint32_t>(reinterpret_cast<uintptr_t>(argument));
+			return 0;
+		}
+		if (request == I2C_RDWR) {
+			i2c_rdwr_ioctl_data* transfer = static_cast<i2c_rdwr_ioctl_data*>(argument);
+			g_MockCounters.transactions++;
+			for (uint32_t n = 0; n < transfer->nmsgs; n++) {
+				i2c_msg& message = transfer->msgs[n];
+				if (message.addr != PCF8591_ADDRESS) {
+					errno = ENXIO;
+					return -1;
+				}
+				g_MockCounters.bytes += message.len;
+				if (message.flags & I2C_M_RD) {
+					MockReadConversions(message.buf, message.len);
+				} else {
+					MockWriteControl(message.buf, message.len);
+				}
+			}
+			return static_cast<int>(transfer->nmsgs);
+		}
+		errno = ENOTTY;
+		return -1;
+	}
+
+	ssize_t __wrap_read(int fd, void* data, size_t size) {
+		if (fd != g_MockFd)
+			return __real_read(fd, data, size);
+
+		g_MockCounters.syscalls++;
+		g_MockCounters.transactions++;
+		g_MockCounters.bytes += size;
+		if (g_MockSlave != PCF8591_ADDRESS) {
+			errno = ENXIO;
+			return -1;
+		}
+		MockReadConversions(static_cast<uint8_t*>(data), size);
+		return static_cast<ssize_t>(size);
+	}
+
+	ssize_t __wrap_write(int fd, const void* data, size_t size) {
+		if (fd != g_MockFd)
+			return __real_write(fd, data, size);
+
+		g_MockCounters.syscalls++;
+		g_MockCounters.transactions++;
+		g_MockCounters.bytes += size;
+		if (g_MockSlave != PCF8591_ADDRESS) {
+			errno = ENXIO;
+			return -1;
+		}
+		MockWriteControl(static_cast<const uint8_t*>(data), size);
+		return static_cast<ssize_t>(size);
+	}
+}
+
+class MockI2C : public cee::I2C {
+public:
+	MockI2C(int32_t fd)
+	 : cee::I2C(fd)
+	{
+	}
+};
+
+struct AdcCase {
+	const char* name;
+	size_t samplesPerCall;
+	void (*read)(cee::I2C& bus, cee::ADC& adc, uint8_t* samples);
+};
+
+// Per sample, the way ReadChannel worked before the combined transfer:
+// SetChannel then Read, each write and read preceded by an I2C_SLAVE
+// ioctl and a zero-length probe.
+static void ReadProbing(cee::I2C& bus, cee::ADC&, uint8_t* samples) {
+	uint8_t control = 0x40 | 1;
+	bus.CheckForDevice(PCF8591_ADDRESS);
+	bus.WriteToDevice(PCF8591_ADDRESS, &control, 1);
+	bus.CheckForDevice(PCF8591_ADDRESS);
+	bus.ReadFromDevice(PCF8591_ADDRESS, samples, 1);
+}
+
+static void ReadChannel(cee::I2C&, cee::ADC& adc, uint8_t* samples) {
+	samples[0] = adc.ReadChannel(1);
+}
+
+static void ReadAllChannels(cee::I2C&, cee::ADC& adc, uint8_t* samples) {
+	adc.ReadAllChannels(std::span<uint8_t, 4>(samples, 4));
+}
+
+static void ReadBlock(cee::I2C&, cee::ADC& adc, uint8_t* samples) {
+	adc.ReadBlock(samples, 16);
+}
+
+// The PCF8591 answers each read with the previous conversion, so
+// ReadChannel straight after a switch must not return the old channel.
+static bool CheckChannelSwitch() {
+	std::shared_ptr<cee::VirtualI2C> bus = std::make_shared<cee::VirtualI2C>(PCF8591_ADDRESS,
+			[](uint32_t channel) { return static_cast<uint8_t>(0x10 + channel); });
+	cee::ADC adc(bus, cee::ADCType::PCF8591, PCF8591_ADDRESS);
+	static const uint32_t s_Channels[] = { 0, 1, 3, 2, 2, 0, 1 };
+	for (uint32_t channel : s_Channels) {
+		uint8_t value = adc.ReadChannel(channel);
+		if (value != 0x10 + channel) {
+			printf("  ReadChannel(%u) returned 0x%.2X, not 0x%.2X\n", channel, value, 0x10 + channel);
+			return false;
+		}
+	}
+	return true;
+}
+
+// Syscalls, bus transactions and bytes on the wire per sample for each
+// way of reading the PCF8591, against the mock bus.
+static int RunAdc(size_t iterations) {
+	static const AdcCase s_Cases[] = {
+		{ "probe per call (before)", 1, ReadProbing },
+		{ "ReadChannel", 1, ReadChannel },
+		{ "ReadAllChannels", 4, ReadAllChannels },
+		{ "ReadBlock(16)", 64, ReadBlock },
+	};
+
+	g_MockFd = open("/dev/null", O_RDWR);
+	if (g_MockFd < 0) {
+		printf("Failed to open /dev/null for the mock bus: %s.\n", strerror(errno));
+		return EXIT_FAILURE;
+	}
+	std::shared_ptr<MockI2C> bus = std::make_shared<MockI2C>(g_MockFd);
+	cee::ADC adc(bus, cee::ADCType::PCF8591, PCF8591_ADDRESS);
+	uint8_t samples[64];
+
+	printf("PCF8591 reads on a mock bus, %zu calls each.\n", iterations);
+	printf("%-26s %14s %14s %14s %12s\n", "path", "syscalls/smp", "transfers/smp", "bytes/smp", "ns/smp");
+	for (const AdcCase& test : s_Cases) {
+		g_MockCounters = MockBusCounters{};
+		int64_t start = GetMonotonicNs();
+		for (size_t n = 0; n < iterations; n++)
+			test.read(*bus, adc, samples);
+		double elapsed = static_cast<double>(GetMonotonicNs() - start);
+
+		double count = static_cast<double>(iterations * test.samplesPerCall);
+		printf("%-26s %14.3f %14.3f %14.3f %12.1f\n", test.name, g_MockCounters.syscalls / count,
+				g_MockCounters.transactions / count, g_MockCounters.bytes / count, elapsed / count);
+	}
+
+	bool switched = CheckChannelSwitch();
+	printf("ReadChannel returns the selected channel after a switch: %s\n", switched ? "yes" : "NO");
+	return switched ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+static const cee::SimdLevel SIMD_LEVELS[] = { cee::SimdLevel::SCALAR, cee::SimdLevel::SSE4, cee::SimdLevel::AVX2, cee::SimdLevel::NEON };
+
+struct KernelBuffers {
+	std::vector<float> a, b, out;
+	std::vector<int16_t> a16, b16, out16;
+	std::vector<int32_t> out32;
+	std::vector<uint32_t> crossings;
+};
+
+// QRS-like input: a small noisy baseline with occasional large bursts, so
+// the integrator's window sums fall back to small values after a peak.
+static void FillKernelBuffers(KernelBuffers& buffers, size_t count, uint32_t seed) {
+	std::mt19937 random(seed);
+	std::normal_distribution<float> noise(0.f, 1.f);
+	buffers.a.resize(count);
+	buffers.b.resize(count);
+	buffers.out.resize(count);
+	buffers.a16.resize(count);
+	buffers.b16.resize(count);
+	buffers.out16.resize(count);
+	buffers.out32.resize(count);
+	buffers.crossings.resize(count);
+	for (size_t i = 0; i < count; i++) {
+		float burst = (i % 250) < 20 ? 500.f : 1.f;
+		buffers.a[i] = burst * noise(random);
+		buffers.b[i] = noise(random);
+		buffers.a16[i] = static_cast<int16_t>(random());
+		buffers.b16[i] = static_cast<int16_t>(random() >> 3);
+	}
+}
+
+struct KernelCase {
+	const char* name;
+	std::function<void(KernelBuffers& buffers, size_t count)> run;
+};
+
+static const KernelCase KERNEL_CASES[] = {
+	{ "Derivative", [](KernelBuffers& buffers, size_t count) { cee::Derivative(buffers.a.data(), buffers.out.data(), count); } },
+	{ "Square", [](KernelBuffers& buffers, size_t count) { cee::Square(buffers.a.data(), buffers.out.data(), count); } },
+	{ "Smooth3", [](KernelBuffers& buffers, size_t count) { cee::Smooth3(buffers.a.data(), buffers.out.data(), count); } },
+	{ "MovingWindowIntegrate(38)", [](KernelBuffers& buffers, size_t count) { cee::MovingWindowIntegrate(buffers.a.data(), buffers.out.data(), count, 38); } },
+	{ "MovingWindowIntegrate(75)", [](KernelBuffers& buffers, size_t count) { cee::MovingWindowIntegrate(buffers.a.data(), buffers.out.data(), count, 75); } },
+	{ "FindThresholdCrossings", [](KernelBuffers& buffers, size_t count) {
+		buffers.out32[0] = static_cast<int32_t>(cee::FindThresholdCrossings(buffers.a.data(), count, 100.f, buffers.crossings.data(), count));
+	} },
+	{ "DotProduct", [](KernelBuffers& buffers, size_t count) { buffers.out[0] = cee::DotProduct(buffers.a.data(), buffers.b.data(), count); } },
+	{ "Derivative(int16)", [](KernelBuffers& buffers, size_t count) { cee::Derivative(buffers.a16.data(), buffers.out16.data(), count); } },
+	{ "Square(int16)", [](KernelBuffers& buffers, size_t count) { cee::Square(buffers.a16.data(), buffers.out32.data(), count); } },
+	{ "WeightedSum(int16)", [](KernelBuffers& buffers, size_t count) {
+		cee::WeightedSum(buffers.a16.data(), 3, buffers.b16.data(), -5, 2, buffers.out16.data(), count);
+	} },
+};
+
+// Compares every level against the scalar table: bit-exact for all but
+// the two that sum in a different order.
+static bool CheckKernels(cee::SimdLevel level) {
+	static const size_t s_Windows[] = { 1, 2, 3, 7, 38, 75, 200 };
+	std::vector<size_t> counts;
+	for (size_t count = 0; count <= 70; count++)
+		counts.push_back(count);
+	counts.insert(counts.end(), { 1000, 4099, 100003 });
+
+	KernelBuffers buffers, reference;
+	size_t failures = 0;
+	auto fail = [&](const char* kernel, size_t count, size_t window, size_t index) {
+		if (failures++ < 10)
+			printf("  %s: %s differs from scalar at count %zu, window %zu, index %zu\n", cee::GetSimdLevelName(level),
+					kernel, count, window, index);
+	};
+
+	for (size_t count : counts) {
+		FillKernelBuffers(buffers, std::max<size_t>(count, 1), static_cast<uint32_t>(count));
+		float peak = 0.f;
+		for (size_t i = 0; i < count; i++)
+			peak = std::max(peak, std::fabs(buffers.a[i]));
+
+		for (const KernelCase& test : KERNEL_CASES) {
+			if (strncmp(test.name, "MovingWindowIntegrate", 21) == 0 || strcmp(test.name, "DotProduct") == 0)
+				continue;
+			reference = buffers;
+			cee::SetSimdLevel(cee::SimdLevel::SCALAR);
+			test.run(reference, count);
+			cee::SetSimdLevel(level);
+			test.run(buffers, count);
+			for (size_t i = 0; i < count; i++) {
+				if (memcmp(&buffers.out[i], &reference.out[i], sizeof(float)) != 0 || buffers.out16[i] != reference.out16[i]
+						|| buffers.out32[i] != reference.out32[i] || buffers.crossings[i] != reference.crossings[i]) {
+					fail(test.name, count, 0, i);
+					break;
+				}
+			}
+		}
+
+		// The running sums agree to float rounding of each output, plus
+		// double rounding relative to the largest window sum seen.
+		for (size_t window : s_Windows) {
+			reference = buffers;
+			cee::SetSimdLevel(cee::SimdLevel::SCALAR);
+			cee::MovingWindowIntegrate(reference.a.data(), reference.out.data(), count, window);
+			cee::SetSimdLevel(level);
+			cee::MovingWindowIntegrate(buffers.a.data(), buffers.out.data(), count, window);
+			for (size_t i = 0; i < count; i++) {
+				float tolerance = 2e-7f * std::fabs(reference.out[i]) + 1e-12f * peak;
+				if (std::fabs(buffers.out[i] - reference.out[i]) > tolerance) {
+					fail("MovingWindowIntegrate", count, window, i);
+					break;
+				}
+			}
+		}
+
+		cee::SetSimdLevel(cee::SimdLevel::SCALAR);
+		float expected = cee::DotProduct(buffers.a.data(), buffers.b.data(), count);
+		cee::SetSimdLevel(level);
+		float actual = cee::DotProduct(buffers.a.data(), buffers.b.data(), count);
+		double magnitude = 0.0;
+		for (size_t i = 0; i < count; i++)
+			magnitude += std::fabs(buffers.a[i] * buffers.b[i]);
+		if (std::fabs(actual - expected) > 1e-5 * magnitude)
+			fail("DotProduct", count, 0, 0);
+	}
+	return failures == 0;
+}
+
+// Checks every supported level against scalar, then times each kernel at
+// 1K to 1M samples, in ns per sample.
+static int RunKernels() {
+	std::vector<cee::SimdLevel> levels;
+	for (cee::SimdLevel level : SIMD_LEVELS) {
+		if (cee::SetSimdLevel(level))
+			levels.push_back(level);
+	}
+
+	bool matched = true;
+	for (cee::SimdLevel level : levels) {
+		if (level == cee::SimdLevel::SCALAR)
+			continue;
+		bool match = CheckKernels(level);
+		printf("%s matches scalar: %s\n", cee::GetSimdLevelName(level), match ? "yes" : "NO");
+		matched &= match;
+	}
+
+	printf("%-26s %8s", "ns/sample", "samples");
+	for (cee::SimdLevel level : levels)
+		printf(" %9s", cee::GetSimdLevelName(level));
+	printf("\n");
+
+	KernelBuffers buffers;
+	FillKernelBuffers(buffers, 1000000, 1);
+	for (const KernelCase& test : KERNEL_CASES) {
+		for (size_t count : { 1000, 10000, 100000, 1000000 }) {
+			printf("%-26s %8zu", test.name, count);
+			const size_t repeats = std::max<size_t>(1, KERNEL_BENCH_SAMPLES / count);
+			for (cee::SimdLevel level : levels) {
+				cee::SetSimdLevel(level);
+				test.run(buffers, count);
+				int64_t start = GetMonotonicNs();
+				for (size_t n = 0; n < repeats; n++)
+					test.run(buffers, count);
+				printf(" %9.3f", static_cast<double>(GetMonotonicNs() - start) / (repeats * count));
+			}
+			printf("\n");
+			fflush(stdout);
+		}
+	}
+	cee::SetSimdLevel(cee::GetSupportedSimdLevel());
+	return matched ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// The window the analyser should be holding, recomputed from scratch with
+// the same acceptance rules, and a Lomb-Scargle scan with direct trig.
+class NaiveHrv {
+public:
+	void AddBeat(int64_t timestamp) {
+		int64_t rr = (timestamp - m_LastBeat) / 1000;
+		bool haveBeat = m_HaveBeat;
+		m_LastBeat = timestamp;
+		m_HaveBeat = true;
+		if (!haveBeat)
+			return;
+		if (rr < 300000 || rr > 2000000) {
+			m_ChainValid = false;
+			return;
+		}
+		m_Intervals.push_back({ timestamp, rr, m_ChainValid });
+		if (m_Intervals.size() > HRV_WINDOW)
+			m_Intervals.erase(m_Intervals.begin());
+		m_ChainValid = true;
+	}
+
+	cee::HrvMetrics GetMetrics() const {
+		cee::HrvMetrics metrics = {};
+		metrics.intervals = static_cast<uint32_t>(m_Intervals.size());
+		double sum = 0.0, squares = 0.0, differences = 0.0;
+		uint32_t count = 0, nn50 = 0;
+		for (size_t n = 0; n < m_Intervals.size(); n++) {
+			sum += m_Intervals[n].rr;
+			// The oldest interval's predecessor has left the window.
+			if (n > 0 && m_Intervals[n].chained) {
+				double difference = static_cast<double>(m_Intervals[n].rr - m_Intervals[n - 1].rr);
+				differences += difference * difference;
+				count++;
+				nn50 += std::fabs(difference) > 50000.0;
+			}
+		}
+		double mean = sum / m_Intervals.size();
+		for (const Interval& interval : m_Intervals)
+			squares += (interval.rr - mean) * (interval.rr - mean);
+		metrics.meanRrMs = static_cast<float>(mean / 1000.0);
+		metrics.sdnnMs = static_cast<float>(std::sqrt(squares / m_Intervals.size()) / 1000.0);
+		metrics.rmssdMs = count ? static_cast<float>(std::sqrt(differences / count) / 1000.0) : 0.f;
+		metrics.pnn50 = count ? 100.f * nn50 / count : 0.f;
+		return metrics;
+	}
+
+	void GetSpectrum(double& lf, double& hf) const {
+		const size_t count = m_Intervals.size();
+		double mean = 0.0;
+		for (const Interval& interval : m_Intervals)
+			mean += interval.rr;
+		mean /= count;
+		const int64_t start = m_Intervals.front().timestamp;
+		const double duration = (m_Intervals.back().timestamp - start) * 1e-9;
+		const double scale = 2.0 * duration / count * 0.001;
+		lf = hf = 0.0;
+		for (double frequency = 0.04; frequency < 0.40; frequency += 0.001) {
+			const double omega = 2.0 * M_PI * frequency;
+			double sin2 = 0.0, cos2 = 0.0;
+			for (const Interval& interval : m_Intervals) {
+				double t = (interval.timestamp - start) * 1e-9;
+				sin2 += std::sin(2.0 * omega * t);
+				cos2 += std::cos(2.0 * omega * t);
+			}
+			double tau = std::atan2(sin2, cos2) / (2.0 * omega);
+			double yc = 0.0, ys = 0.0, cc = 0.0, ss = 0.0;
+			for (const Interval& interval : m_Intervals) {
+				double t = (interval.timestamp - start) * 1e-9;
+				double c = std::cos(omega * (t - tau)), s = std::sin(omega * (t - tau));
+				double y = (interval.rr - mean) * 1e-3;
+				yc += y * c;
+				ys += y * s;
+				cc += c * c;
+				ss += s * s;
+			}
+			double power = 0.5 * (yc * yc / cc + ys * ys / ss) * scale;
+			(frequency < 0.15 ? lf : hf) += power;
+		}
+	}
+
+private:
+	struct Interval {
+		int64_t timestamp;
+		int64_t rr;
+		bool chained;
+	};
+
+	std::vector<Interval> m_Intervals;
+	int64_t m_LastBeat = 0;
+	bool m_HaveBeat = false;
+	bool m_ChainValid = false;
+};
+
+static bool Near(double actual, double expected, double tolerance) {
+	return std::fabs(actual - expected) <= tolerance * std::max(1.0, std::fabs(expected));
+}
+
+// A synthetic 24 h RR series, 800 ms with 0.1 Hz (LF, 450 ms^2) and
+// 0.25 Hz (HF, 200 ms^2) modulation, 5 ms of jitter and an occasional
+// spurious beat, through the analyser with a spectrum every 10 s. The
+// running sums and the rotated Lomb-Scargle scan are checked against
+// NaiveHrv along the way.
+static int RunHrv() {
+	std::mt19937 random(1);
+	std::normal_distribution<double> jitter(0.0, 5.0);
+	std::uniform_real_distribution<double> uniform(0.0, 1.0);
+	std::vector<int64_t> beats;
+	for (double t = 0.0; t < 24.0 * 3600.0; ) {
+		double rr = 800.0 + 30.0 * std::sin(2.0 * M_PI * 0.1 * t) + 20.0 * std::sin(2.0 * M_PI * 0.25 * t) + jitter(random);
+		if (uniform(random) < 0.001)
+			beats.push_back(static_cast<int64_t>((t + 0.2) * 1e9));
+		t += rr * 1e-3;
+		beats.push_back(static_cast<int64_t>(t * 1e9));
+	}
+
+	cee::HrvAnalyzer analyzer(HRV_WINDOW);
+	int64_t addNs = 0, spectrumNs = 0, maxSpectrumNs = 0;
+	size_t spectra = 0;
+	int64_t nextSpectrum = HRV_SPECTRUM_PERIOD_NS;
+	for (int64_t beat : beats) {
+		int64_t start = GetMonotonicNs();
+		analyzer.AddBeat(beat);
+		int64_t middle = GetMonotonicNs();
+		addNs += middle - start;
+		if (beat >= nextSpectrum) {
+			analyzer.UpdateSpectrum();
+			int64_t elapsed = GetMonotonicNs() - middle;
+			spectrumNs += elapsed;
+			maxSpectrumNs = std::max(maxSpectrumNs, elapsed);
+			spectra++;
+			nextSpectrum += HRV_SPECTRUM_PERIOD_NS;
+		}
+	}
+	printf("%zu beats over 24 h, window %d, spectrum every %.0f s.\n", beats.size(), HRV_WINDOW, HRV_SPECTRUM_PERIOD_NS / 1e9);
+	printf("  AddBeat        %8.1f ns/beat, %.2f ms total\n", static_cast<double>(addNs) / beats.size(), addNs / 1e6);
+	printf("  UpdateSpectrum %8.3f ms mean, %.3f ms max, %zu spectra, %.1f ms total\n", spectrumNs / 1e6 / spectra,
+			maxSpectrumNs / 1e6, spectra, spectrumNs / 1e6);
+
+	// A second pass for the checks, off the clock.
+	cee::HrvAnalyzer checked(HRV_WINDOW);
+	NaiveHrv naive;
+	size_t mismatches = 0, spectrumChecks = 0;
+	double lfSum = 0.0, hfSum = 0.0, naiveNs = 0.0, rotatedNs = 0.0;
+	for (size_t n = 0; n < beats.size(); n++) {
+		checked.AddBeat(beats[n]);
+		naive.AddBeat(beats[n]);
+		if (n % HRV_CHECK_BEATS != 0 || n < HRV_WINDOW)
+			continue;
+
+		cee::HrvMetrics metrics = checked.GetMetrics();
+		cee::HrvMetrics expected = naive.GetMetrics();
+		bool match = metrics.intervals == expected.intervals && Near(metrics.meanRrMs, expected.meanRrMs, 1e-6)
+				&& Near(metrics.sdnnMs, expected.sdnnMs, 1e-4) && Near(metrics.rmssdMs, expected.rmssdMs, 1e-5)
+				&& metrics.pnn50 == expected.pnn50;
+
+		// The naive scan is slow, so only every tenth checkpoint.
+		if ((n / HRV_CHECK_BEATS) % 10 == 0) {
+			double lf, hf;
+			int64_t start = GetMonotonicNs();
+			naive.GetSpectrum(lf, hf);
+			int64_t middle = GetMonotonicNs();
+			checked.UpdateSpectrum();
+			rotatedNs += static_cast<double>(GetMonotonicNs() - middle);
+			naiveNs += static_cast<double>(middle - start);
+			metrics = checked.GetMetrics();
+			match &= Near(metrics.lfPower, lf, 1e-5) && Near(metrics.hfPower, hf, 1e-5);
+			lfSum += metrics.lfPower;
+			hfSum += metrics.hfPower;
+			spectrumChecks++;
+		}
+		if (!match && mismatches++ < 10) {
+			printf("  beat %zu: SDNN %.3f/%.3f RMSSD %.3f/%.3f pNN50 %.2f/%.2f LF %.2f HF %.2f\n", n, metrics.sdnnMs,
+					expected.sdnnMs, metrics.rmssdMs, expected.rmssdMs, metrics.pnn50, expected.pnn50, metrics.lfPower, metrics.hfPower);
+		}
+	}
+	printf("  Lomb-Scargle with direct trig %.3f ms, rotated %.3f ms per spectrum\n", naiveNs / 1e6 / spectrumChecks,
+			rotatedNs / 1e6 / spectrumChecks);
+	printf("  mean LF %.1f ms^2 (450 injected), HF %.1f ms^2 (200 injected)\n", lfSum / spectrumChecks, hfSum / spectrumChecks);
+	printf("  running sums and spectrum match the direct computation: %s\n", mismatches ? "NO" : "yes");
+	return mismatches ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+// The median of the last `window` samples by sorting a copy every sample.
+template<typename T>
+class NaiveMedian {
+public:
+	NaiveMedian(size_t window)
+	 : m_Window(window), m_Next(0)
+	{
+	}
+
+	T Process(T value) {
+		if (m_Values.size() < m_Window) {
+			m_Values.push_back(value);
+		} else {
+			m_Values[m_Next] = value;
+			m_Next = (m_Next + 1) % m_Window;
+		}
+		m_Sorted = m_Values;
+		std::sort(m_Sorted.begin(), m_Sorted.end());
+		size_t middle = m_Sorted.size() / 2;
+		T median = m_Sorted[middle];
+		if ((m_Sorted.size() & 1) == 0)
+			median = (median + m_Sorted[middle - 1]) / 2;
+		return median;
+	}
+
+private:
+	size_t m_Window;
+	size_t m_Next;
+	std::vector<T> m_Values;
+	std::vector<T> m_Sorted;
+};
+
+// ECG-like input with a wandering baseline and, for integers, a narrow
+// code range so the window is full of ties.
+template<typename T>
+static std::vector<T> MakeMedianInput(size_t count, uint32_t seed) {
+	std::mt19937 random(seed);
+	std::normal_distribution<float> noise(0.f, 1.f);
+	std::vector<T> input(count);
+	for (size_t i = 0; i < count; i++) {
+		float value = 20.f * std::sin(static_cast<float>(i) * 0.005f) + ((i % 200) < 10 ? 60.f : 0.f) + 4.f * noise(random);
+		input[i] = static_cast<T>(value);
+	}
+	return input;
+}
+
+template<typename T>
+static bool CheckMedian(const char* type) {
+	bool matched = true;
+	for (size_t window : { 1, 2, 3, 4, 5, 8, 51, 150, 151, 301 }) {
+		std::vector<T> input = MakeMedianInput<T>(20 * window + 1000, static_cast<uint32_t>(window));
+		cee::RunningMedian<T> median(window);
+		NaiveMedian<T> naive(window);
+		for (size_t i = 0; i < input.size(); i++) {
+			T actual = median.Process(input[i]);
+			T expected = naive.Process(input[i]);
+			if (actual != expected) {
+				printf("  %s window %zu: sample %zu median %g, sorted %g\n", type, window, i,
+						static_cast<double>(actual), static_cast<double>(expected));
+				matched = false;
+				break;
+			}
+		}
+	}
+	return matched;
+}
+
+template<typename T>
+static void BenchMedian(const char* type, size_t window) {
+	std::vector<T> input = MakeMedianInput<T>(MEDIAN_BENCH_SAMPLES, 1);
+	cee::RunningMedian<T> median(window);
+	NaiveMedian<T> naive(window);
+	volatile T sink = 0;
+
+	int64_t start = GetMonotonicNs();
+	for (T value : input)
+		sink = median.Process(value);
+	double heapNs = static_cast<double>(GetMonotonicNs() - start) / input.size();
+
+	start = GetMonotonicNs();
+	for (size_t i = 0; i < MEDIAN_NAIVE_SAMPLES; i++)
+		sink = naive.Process(input[i]);
+	double naiveNs = static_cast<double>(GetMonotonicNs() - start) / MEDIAN_NAIVE_SAMPLES;
+	(void)sink;
+
+	printf("%-8s %8zu %12.1f %12.1f %10.1fx\n", type, window, heapNs, naiveNs, naiveNs / heapNs);
+}
+
+// Checks RunningMedian against a sort per sample, growing window and ties
+// included, then times both at the baseline filter's window lengths.
+static int RunMedian() {
+	bool matched = CheckMedian<float>("float") && CheckMedian<int16_t>("int16") && CheckMedian<int32_t>("int32");
+	printf("RunningMedian matches a sort per sample: %s\n", matched ? "yes" : "NO");
+
+	printf("%-8s %8s %12s %12s %11s\n", "type", "window", "heap ns", "sort ns", "speedup");
+	// 200 and 600 ms at 250 and 500 Hz.
+	for (size_t window : { 51, 151, 101, 301 }) {
+		BenchMedian<float>("float", window);
+		BenchMedian<int16_t>("int16", window);
+	}
+
+	std::vector<cee::EcgFixed> input = MakeMedianInput<cee::EcgFixed>(MEDIAN_BENCH_SAMPLES, 2);
+	for (float rate : { 250.f, 500.f }) {
+		cee::BaselineFilter<cee::EcgFixed> baseline(rate);
+		volatile cee::EcgFixed sink = 0;
+		int64_t start = GetMonotonicNs();
+		for (cee::EcgFixed value : input)
+			sink = baseline.Process(value);
+		(void)sink;
+		printf("BaselineFilter<EcgFixed> at %.0f Hz: %.1f ns/sample\n", rate,
+				static_cast<double>(GetMonotonicNs() - start) / input.size());
+	}
+	return matched ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+struct DetectorCase {
+	const char* name;
+	cee::EcgRhythm rhythm;
+};
+
+// Lead II of the synthetic patient through the bedside chain (baseline
+// removal, QRS filter, detector), counting beats.
+static size_t CountBeats(cee::EcgRhythm rhythm, float rate, size_t* searchback) {
+	cee::SyntheticSampleSource source(rate, rhythm);
+	cee::BaselineFilter<cee::EcgFixed> baseline(rate);
+	cee::DoubleDifferenceSquaredFilter<int32_t> qrsFilter;
+	cee::QrsDetector detector(rate);
+	const int64_t period = static_cast<int64_t>(NSEC_PER_SEC / rate);
+	const uint64_t samples = static_cast<uint64_t>(DETECTOR_SECONDS * rate);
+	uint8_t frame[4];
+	size_t beats = 0;
+	*searchback = 0;
+	for (uint64_t n = 0; n < samples; n++) {
+		source.Acquire(static_cast<int64_t>(n) * period, std::span<uint8_t, 4>(frame, 4));
+		int32_t filtered = qrsFilter.Process(baseline.Process(cee::AdcCodeToFixed(frame[cee::ECG_LEAD_II])));
+		cee::BeatEvent beat;
+		if (detector.Process(filtered, n, static_cast<int64_t>(n) * period, beat)) {
+			beats++;
+			*searchback += beat.searchback;
+		}
+	}
+	return beats;
+}
+
+// Beat counts for each synthetic rhythm against its nominal rate, at the
+// bedside and Holter rates. Asystole must give no beats at all.
+static int RunDetector() {
+	static const DetectorCase s_Cases[] = {
+		{ "sinus", cee::EcgRhythm::SINUS },
+		{ "tachy", cee::EcgRhythm::TACHYCARDIA },
+		{ "brady", cee::EcgRhythm::BRADYCARDIA },
+		{ "pvc", cee::EcgRhythm::PVC },
+		{ "asystole", cee::EcgRhythm::ASYSTOLE },
+	};
+
+	bool matched = true;
+	printf("%-9s %6s %8s %8s %11s\n", "rhythm", "rate", "beats", "expected", "searchback");
+	for (const DetectorCase& test : s_Cases) {
+		for (float rate : { 250.f, 500.f, 1000.f }) {
+			size_t searchback;
+			size_t beats = CountBeats(test.rhythm, rate, &searchback);
+			double expected = test.rhythm == cee::EcgRhythm::ASYSTOLE ? 0.0
+					: cee::SyntheticEcg::GetDefaultHeartRate(test.rhythm) * DETECTOR_SECONDS / 60.0;
+			// Within 5% of the nominal count, allowing for the learning
+			// period and the rhythm's variability.
+			bool match = test.rhythm == cee::EcgRhythm::ASYSTOLE ? beats == 0 : std::abs(beats - expected) <= 0.05 * expected;
+			printf("%-9s %6.0f %8zu %8.0f %11zu%s\n", test.name, rate, beats, expected, searchback, match ? "" : "  MISMATCH");
+			matched &= match;
+		}
+	}
+	printf("Beat counts match the rhythms: %s\n", matched ? "yes" : "NO");
+	return matched ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int main(int argc, char** arg) {
+	std::string suite;
+	size_t iterations = 100000;
+	for (int i = 1; i < argc; i++) {
+		if (strncmp(arg[i], "--iterations=", 13) == 0) {
+			iterations = std::max(1l, strtol(arg[i] + 13, nullptr, 10));
+		} else if (arg[i][0] != '-') {
+			suite = arg[i];
+		}
+	}
+
+	if (suite == "adc") {
+		return RunAdc(iterations);
+	} else if (suite == "kernels") {
+		return RunKernels();
+	} else if (suite == "hrv") {
+		return RunHrv();
+	} else if (suite == "median") {
+		return RunMedian();
+	} else if (suite == "detector") {
+		return RunDetector();
+	}
+	printf("Usage: %s [--iterations=N] adc|kernels|hrv|median|detector\n", arg[0]);
+	return EXIT_FAILURE;
+}
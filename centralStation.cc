@@ -0,0 +1,27 @@
+#include "centralStation.hh"
+
+#include <algorithm>
+#include <atomic>
+
+namespace cee {
+	CentralStation::CentralStation(WorkStealingPool& pool, size_t batchSize)
+	 : m_Pool(pool), m_BatchSize(std::max<size_t>(1, batchSize))
+	{
+	}
+
+	size_t CentralStation::AddPatient(std::unique_ptr<SampleSource> source, float sampleRate) {
+		m_Patients.push_back(std::make_unique<PatientPipeline>(std::move(source), sampleRate));
+		return m_Patients.size() - 1;
+	}
+
+	uint64_t CentralStation::Advance(int64_t until) {
+		std::atomic<uint64_t> processed = 0;
+		m_Pool.ParallelFor(m_Patients.size(), m_BatchSize, [&](size_t begin, size_t end) {
+			uint64_t batch = 0;
+			for (size_t bed = begin; bed < end; bed++)
+				batch += m_Patients[bed]->Advance(until);
+			processed.fetch_add(batch, std::memory_order_relaxed);
+		});
+		return processed.load(std::memory_order_relaxed);
+	}
+}
@@ -0,0 +1,42 @@
+#ifndef CEE_CENTRAL_STATION_H_
+#define CEE_CENTRAL_STATION_H_
+
+#include <memory>
+#include <vector>
+
+#include <cstdint>
+#include <cstddef>
+
+#include "patientPipeline.hh"
+#include "sampleSource.hh"
+#include "workStealingPool.hh"
+
+namespace cee {
+	// Many beds' pipelines advanced together on a work-stealing pool. Each
+	// round hands the pool batches of neighbouring beds; a batch is the
+	// unit of stealing, so it trades scheduling overhead against balance
+	// when some beds cost more than others.
+	class CentralStation {
+	public:
+		CentralStation(WorkStealingPool& pool, size_t batchSize = 4);
+		~CentralStation() = default;
+
+		// Returns the bed number.
+		size_t AddPatient(std::unique_ptr<SampleSource> source, float sampleRate);
+
+		// Brings every bed up to `until` on the pipelines' clock. Returns the
+		// samples processed across all beds.
+		uint64_t Advance(int64_t until);
+
+		size_t GetPatientCount() const { return m_Patients.size(); }
+		PatientStatus GetStatus(size_t bed) const { return m_Patients[bed]->GetStatus(); }
+		const PatientPipeline& GetPatient(size_t bed) const { return *m_Patients[bed]; }
+
+	private:
+		WorkStealingPool& m_Pool;
+		size_t m_BatchSize;
+		std::vector<std::unique_ptr<PatientPipeline>> m_Patients;
+	};
+}
+
+#endif
@@ -0,0 +1,182 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+#include <signal.h>
+#include <unistd.h>
+
+#include "util.h"
+#include "alarms.hh"
+#include "centralStation.hh"
+#include "dspKernels.hh"
+#include "sampleSource.hh"
+#include "workStealingPool.hh"
+
+#define STATUS_PERIOD_NS         1000000000l
+#define BENCH_STEP_NS            1000000000l
+#define BENCH_WARMUP_NS          2000000000l
+#define BENCH_MAX_PATIENTS       512
+
+static std::atomic<bool> g_Terminate = false;
+
+static size_t g_Patients = 16;
+static size_t g_Threads = 0;
+static size_t g_BatchSize = 4;
+static float g_SampleRate = 250.f;
+static std::string g_SampleSourceSpec = "synthetic";
+static bool g_Bench = false;
+static int64_t g_BenchSeconds = 10;
+
+extern "C" {
+	void signalHandler(int) {
+		const char* errorMessage = "Recieved signal...\tstopping.\n";
+		write(STDERR_FILENO, errorMessage, strlen(errorMessage));
+
+		g_Terminate = true;
+	}
+}
+
+static int64_t GetMonotonicNs() {
+	timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return static_cast<int64_t>(now.tv_sec) * NSEC_PER_SEC + now.tv_nsec;
+}
+
+// A bare "synthetic" spec spreads the beds over every rhythm, so the alarm
+// paths all see some load; each bed gets its own seed either way.
+static std::unique_ptr<cee::SampleSource> CreateBedSource(size_t bed) {
+	static const char* const s_Rhythms[] = { "sinus", "sinus", "tachy", "brady", "pvc", "sinus", "asystole", "sinus" };
+	std::string spec = g_SampleSourceSpec;
+	if (spec == "synthetic") {
+		spec += ":";
+		spec += s_Rhythms[bed % std::size(s_Rhythms)];
+	}
+	return cee::CreateSampleSource(spec, g_SampleRate, static_cast<uint32_t>(bed + 1));
+}
+
+static bool AddPatients(cee::CentralStation& station, size_t count) {
+	for (size_t bed = 0; bed < count; bed++) {
+		std::unique_ptr<cee::SampleSource> source = CreateBedSource(bed);
+		if (!source) {
+			return false;
+		}
+		station.AddPatient(std::move(source), g_SampleRate);
+	}
+	return true;
+}
+
+static int RunMonitor() {
+	cee::WorkStealingPool pool(g_Threads);
+	cee::CentralStation station(pool, g_BatchSize);
+	if (!AddPatients(station, g_Patients)) {
+		return EXIT_FAILURE;
+	}
+	printf("Monitoring %zu beds at %.0f Hz on %zu threads (%s).\n", station.GetPatientCount(), g_SampleRate,
+			pool.GetThreadCount(), cee::GetSimdLevelName(cee::GetSimdLevel()));
+
+	const int64_t start = GetMonotonicNs();
+	int64_t nextStatus = start + STATUS_PERIOD_NS;
+	while (!g_Terminate) {
+		int64_t before = GetMonotonicNs();
+		station.Advance(before - start);
+		int64_t after = GetMonotonicNs();
+
+		if (after >= nextStatus) {
+			// Only beds in alarm are listed; the load is the share of real
+			// time the last round took.
+			size_t alarms = 0;
+			for (size_t bed = 0; bed < station.GetPatientCount(); bed++) {
+				cee::PatientStatus status = station.GetStatus(bed);
+				if (status.alarm.level == cee::AlarmLevel::NONE) {
+					continue;
+				}
+				alarms++;
+				printf("  bed %3zu  %3u bpm  quality %3u  %s\n", bed + 1, status.rate, status.quality, status.alarm.message);
+			}
+			printf("%.0f s: %zu beds, %zu in alarm, round %.2f ms\n", (after - start) / 1e9, station.GetPatientCount(),
+					alarms, (after - before) / 1e6);
+			nextStatus += STATUS_PERIOD_NS;
+		}
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+	return EXIT_SUCCESS;
+}
+
+// Runs every bed as fast as the pool allows, one second of signal per
+// round, for each patient count from 1 to BENCH_MAX_PATIENTS and each
+// thread count from 1 to the hardware's.
+static int RunBench() {
+	std::vector<size_t> threadCounts;
+	const size_t hardwareThreads = g_Threads ? g_Threads : std::max(1u, std::thread::hardware_concurrency());
+	for (size_t threads = 1; threads < hardwareThreads; threads *= 2) {
+		threadCounts.push_back(threads);
+	}
+	threadCounts.push_back(hardwareThreads);
+
+	printf("Throughput at %.0f Hz, %lld s of signal per bed, batches of %zu (%s).\n", g_SampleRate,
+			static_cast<long long>(g_BenchSeconds), g_BatchSize, cee::GetSimdLevelName(cee::GetSimdLevel()));
+	printf("%8s %8s %10s %14s %12s %10s\n", "threads", "beds", "wall ms", "samples/s", "x realtime", "steals");
+	for (size_t threads : threadCounts) {
+		cee::WorkStealingPool pool(threads);
+		for (size_t patients = 1; patients <= BENCH_MAX_PATIENTS && !g_Terminate; patients *= 2) {
+			cee::CentralStation station(pool, g_BatchSize);
+			if (!AddPatients(station, patients)) {
+				return EXIT_FAILURE;
+			}
+			// Past the baseline filters' fill and the detector's learning.
+			station.Advance(BENCH_WARMUP_NS);
+
+			uint64_t steals = pool.GetStealCount();
+			uint64_t samples = 0;
+			int64_t start = GetMonotonicNs();
+			for (int64_t second = 1; second <= g_BenchSeconds; second++) {
+				samples += station.Advance(BENCH_WARMUP_NS + second * BENCH_STEP_NS);
+			}
+			double wall = (GetMonotonicNs() - start) / 1e9;
+
+			// Bed-seconds of signal analysed per second: how many beds this
+			// configuration could keep up with in real time.
+			double realtime = patients * g_BenchSeconds / wall;
+			printf("%8zu %8zu %10.1f %14.0f %12.0f %10llu\n", threads, patients, wall * 1e3, samples / wall, realtime,
+					static_cast<unsigned long long>(pool.GetStealCount() - steals));
+			fflush(stdout);
+		}
+	}
+	return EXIT_SUCCESS;
+}
+
+int main(int argc, char** arg) {
+	for (int i = 1; i < argc; i++) {
+		if (strncmp(arg[i], "--patients=", 11) == 0) {
+			g_Patients = std::max(1l, strtol(arg[i] + 11, nullptr, 10));
+		} else if (strncmp(arg[i], "--threads=", 10) == 0) {
+			g_Threads = std::max(0l, strtol(arg[i] + 10, nullptr, 10));
+		} else if (strncmp(arg[i], "--batch=", 8) == 0) {
+			g_BatchSize = std::max(1l, strtol(arg[i] + 8, nullptr, 10));
+		} else if (strncmp(arg[i], "--rate=", 7) == 0) {
+			g_SampleRate = std::max(50.f, strtof(arg[i] + 7, nullptr));
+		} else if (strncmp(arg[i], "--source=", 9) == 0) {
+			g_SampleSourceSpec = arg[i] + 9;
+		} else if (strcmp(arg[i], "--bench") == 0) {
+			g_Bench = true;
+		} else if (strncmp(arg[i], "--bench=", 8) == 0) {
+			g_Bench = true;
+			g_BenchSeconds = std::max(1l, strtol(arg[i] + 8, nullptr, 10));
+		}
+	}
+
+	signal(SIGINT, signalHandler);
+	signal(SIGTERM, signalHandler);
+
+	return g_Bench ? RunBench() : RunMonitor();
+}
@@ -9,41 +9,110 @@
 #include <cstddef>
 #include <cmath>
 
+#include "fixedPoint.hh"
+
 namespace cee {
-	template<typename T>
+	// The filters below take float or fixed-point (int16_t/int32_t) samples.
+	// Integer samples are filtered exactly in SampleTraits<T>::Accumulator,
+	// squares are scaled by 2^-SQUARE_SHIFT and every stored result
+	// saturates to T.
+	template<DspSample T>
 	std::vector<T>& CalculateDoubleDifferenceSquared(const std::vector<T>& data, std::vector<T>& out) {
-		static_assert(std::is_floating_point<T>::value, "T must be a floating point type.");
-		static std::vector<T> intemediate;
-		intemediate.clear();
-		intemediate.resize(data.size());
+		using Traits = SampleTraits<T>;
+		using Accumulator = typename Traits::Accumulator;
 		out.clear();
 		out.resize(data.size());
+		if (data.size() < 3)
+			return out;
 
-		for (uint32_t i = 2; i < data.size() - 2; i++) {
-			intemediate[i] = (-2.f * data[i - 2]) + (-1.f * data[i - 1]) +  (1.f * data[i + 1]) + (2.f * data[i + 2]);
-			intemediate[i] = intemediate[i] * intemediate[i];
-		}
-		for (uint32_t i = 1; i < intemediate.size() - 1; i++) {
-			out[i] = (1.f * intemediate[i - 1]) +  (2.f * intemediate[i]) + (1.f * intemediate[i + 1]);
+		auto differenceSquared = [&data](size_t i) -> Accumulator {
+			if (i < 2 || i + 2 >= data.size())
+				return Accumulator(0);
+			Accumulator difference = (-2 * Accumulator(data[i - 2])) - Accumulator(data[i - 1]) + Accumulator(data[i + 1]) + (2 * Accumulator(data[i + 2]));
+			return Traits::Square(Traits::Saturate(difference));
+		};
+
+		// Only three squared differences are live at a time, so no
+		// intermediate buffer is needed.
+		Accumulator previous = differenceSquared(0);
+		Accumulator current = differenceSquared(1);
+		for (size_t i = 1; i < data.size() - 1; i++) {
+			Accumulator next = differenceSquared(i + 1);
+			out[i] = Traits::Saturate(previous + (2 * current) + next);
+			previous = current;
+			current = next;
 		}
 
 		return out;
 	}
 
-	template<typename T>
-	std::vector<T>& FindQrsPeaks(std::vector<T>& data, T threshold, std::vector<T>& peaks, T bufferTime) {
-		static_assert(std::is_floating_point<T>::value, "T must be a floating point type.");
-		uint32_t lastFrameRate = peaks.size();
+	// Streaming form of CalculateDoubleDifferenceSquared. Keeps its own
+	// history so each new sample costs one filter evaluation and nothing is
+	// allocated. The output for an input sample is available DELAY samples
+	// after it was pushed.
+	template<DspSample T>
+	class DoubleDifferenceSquaredFilter {
+		using Traits = SampleTraits<T>;
+		using Accumulator = typename Traits::Accumulator;
+
+	public:
+		static constexpr size_t DELAY = 3;
+
+	public:
+		DoubleDifferenceSquaredFilter() {
+			Reset();
+		}
+
+		void Reset() {
+			std::fill(std::begin(m_Input), std::end(m_Input), T(0));
+			std::fill(std::begin(m_Squared), std::end(m_Squared), Accumulator(0));
+		}
+
+		// Returns the output for the sample pushed DELAY calls ago.
+		T Process(T sample) {
+			m_Input[0] = m_Input[1];
+			m_Input[1] = m_Input[2];
+			m_Input[2] = m_Input[3];
+			m_Input[3] = m_Input[4];
+			m_Input[4] = sample;
+
+			Accumulator difference = (-2 * Accumulator(m_Input[0])) - Accumulator(m_Input[1]) + Accumulator(m_Input[3]) + (2 * Accumulator(m_Input[4]));
+			m_Squared[0] = m_Squared[1];
+			m_Squared[1] = m_Squared[2];
+			m_Squared[2] = Traits::Square(Traits::Saturate(difference));
+
+			return Traits::Saturate(m_Squared[0] + (2 * m_Squared[1]) + m_Squared[2]);
+		}
+
+		void Process(const T* in, size_t count, T* out) {
+			for (size_t i = 0; i < count; i++)
+				out[i] = Process(in[i]);
+		}
+
+	private:
+		T m_Input[5];
+		Accumulator m_Squared[3];
+	};
+
+	// Peak positions are written in display coordinates (-1 to 1) whatever
+	// the sample type.
+	template<DspSample T>
+	std::vector<float>& FindQrsPeaks(const std::vector<T>& data, T threshold, std::vector<float>& peaks, float bufferTime) {
 		peaks.clear();
-		T qrsMin = 0.f;
-		auto qrsMinIt = std::max_element(data.begin(), data.end());
-		while (*qrsMinIt > threshold) {
-			data.erase(qrsMinIt);
-			qrsMinIt = std::max_element(data.begin(), data.end());
+		if (data.size() < 3)
+			return peaks;
+
+		// Samples above threshold are treated as artifacts: they are left
+		// out of the peak level and can not be peaks themselves. One pass
+		// finds the level so the cost is linear however noisy the input is.
+		T qrsMax = T(0);
+		for (auto&& value : data) {
+			if (value <= threshold && value > qrsMax)
+				qrsMax = value;
 		}
-		qrsMin = *qrsMinIt * 0.75f;
+		T qrsMin = qrsMax - qrsMax / 4;
 		for (uint32_t i = 1; i < data.size() - 1; i++) {
-			if ((data[i] > qrsMin) && ((data[i] - data[i - 1]) > 0.f) && ((data[i + 1] - data[i]) < 0.f)) {
+			if ((data[i] > qrsMin) && (data[i] <= threshold) && (data[i] > data[i - 1]) && (data[i + 1] < data[i])) {
 				peaks.push_back( 2.0f * (static_cast<float>(i) / static_cast<float>(data.size())) - 1.0f);
 
 				// After each peak, no peak can be detected in the next 200 ms
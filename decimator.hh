@@ -0,0 +1,143 @@
+#ifndef CEE_DECIMATOR_H_
+#define CEE_DECIMATOR_H_
+
+#include <array>
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+namespace cee {
+	namespace detail {
+		constexpr double CONSTEXPR_PI = 3.14159265358979323846;
+
+		// std::sin is not constexpr in C++20, so filter design uses a Taylor
+		// series after reducing the argument to [-pi, pi].
+		constexpr double ConstexprSin(double x) {
+			while (x > CONSTEXPR_PI)
+				x -= 2.0 * CONSTEXPR_PI;
+			while (x < -CONSTEXPR_PI)
+				x += 2.0 * CONSTEXPR_PI;
+
+			double term = x;
+			double sum = x;
+			for (int32_t n = 1; n < 20; n++) {
+				term *= -x * x / ((2.0 * n) * (2.0 * n + 1.0));
+				sum += term;
+			}
+			return sum;
+		}
+
+		constexpr double ConstexprCos(double x) {
+			return ConstexprSin(x + CONSTEXPR_PI / 2.0);
+		}
+
+		// Blackman-windowed sinc lowpass with unity DC gain. `cutoff` is a
+		// fraction of the input sample rate.
+		template<size_t Taps>
+		constexpr std::array<float, Taps> DesignLowpass(double cutoff) {
+			std::array<double, Taps> taps {};
+			double sum = 0.0;
+			const double center = (Taps - 1) / 2.0;
+			for (size_t n = 0; n < Taps; n++) {
+				double x = static_cast<double>(n) - center;
+				double sinc = (x == 0.0) ? 2.0 * cutoff : ConstexprSin(2.0 * CONSTEXPR_PI * cutoff * x) / (CONSTEXPR_PI * x);
+				double phase = 2.0 * CONSTEXPR_PI * n / (Taps - 1);
+				double window = 0.42 - 0.5 * ConstexprCos(phase) + 0.08 * ConstexprCos(2.0 * phase);
+				taps[n] = sinc * window;
+				sum += taps[n];
+			}
+
+			std::array<float, Taps> coefficients {};
+			for (size_t n = 0; n < Taps; n++)
+				coefficients[n] = static_cast<float>(taps[n] / sum);
+			return coefficients;
+		}
+	}
+
+	// Streaming FIR decimator. Only every Factor-th output of the lowpass is
+	// evaluated, so each input sample costs TapsPerPhase multiply-adds.
+	// Coefficients are designed at compile time with the cutoff at 80% of
+	// the output Nyquist frequency.
+	//
+	// Decimating 8-bit samples keeps the fractional part of the average, so
+	// the output carries roughly log2(Factor) / 2 extra bits of resolution.
+	template<size_t Factor, size_t TapsPerPhase = 16>
+	class PolyphaseDecimator {
+		static_assert(Factor > 0, "Factor must be positive.");
+
+	public:
+		static constexpr size_t TAPS = Factor * TapsPerPhase;
+
+	public:
+		PolyphaseDecimator()
+		 : m_Position(0), m_Phase(0)
+		{
+			memset(m_History, 0, sizeof(m_History));
+		}
+
+		// Consumes `count` input samples and writes up to
+		// count / Factor + 1 outputs. Returns the number written.
+		template<typename T>
+		size_t Process(const T* in, size_t count, float* out) {
+			size_t produced = 0;
+			for (size_t i = 0; i < count; i++) {
+				// Each sample is stored twice so the newest TAPS samples are
+				// always contiguous, without wrapping inside the dot product.
+				float value = static_cast<float>(in[i]);
+				m_History[m_Position] = value;
+				m_History[m_Position + TAPS] = value;
+				m_Position = (m_Position + 1) % TAPS;
+
+				if (++m_Phase == Factor) {
+					m_Phase = 0;
+					out[produced++] = DotProduct(m_History + m_Position);
+				}
+			}
+			return produced;
+		}
+
+		void Reset() {
+			memset(m_History, 0, sizeof(m_History));
+			m_Position = 0;
+			m_Phase = 0;
+		}
+
+		// Group delay in input samples.
+		static constexpr float GetDelay() { return (TAPS - 1) / 2.f; }
+
+	private:
+		// Eight independent accumulators so the reduction vectorises
+		// without -ffast-math.
+		static float DotProduct(const float* window) {
+			constexpr size_t LANES = 8;
+			float accumulators[LANES] = { 0.f };
+			size_t n = 0;
+			for (; n + LANES <= TAPS; n += LANES) {
+				for (size_t lane = 0; lane < LANES; lane++)
+					accumulators[lane] += window[n + lane] * s_Coefficients[n + lane];
+			}
+			if constexpr (TAPS % LANES != 0) {
+				for (; n < TAPS; n++)
+					accumulators[0] += window[n] * s_Coefficients[n];
+			}
+
+			float sum = 0.f;
+			for (size_t lane = 0; lane < LANES; lane++)
+				sum += accumulators[lane];
+			return sum;
+		}
+
+	private:
+		// Windowed sinc is symmetric, so the oldest-first history lines up
+		// with the coefficients without reversing them.
+		static constexpr std::array<float, TAPS> s_Coefficients = detail::DesignLowpass<TAPS>(0.4 / Factor);
+
+		alignas(32) float m_History[TAPS * 2];
+		size_t m_Position;
+		size_t m_Phase;
+	};
+}
+
+#endif
+
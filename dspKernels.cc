@@ -0,0 +1,246 @@
+#include "dspKernels.hh"
+
+#include <algorithm>
+#include <atomic>
+
+namespace cee {
+	namespace detail {
+		void DerivativeScalar(const float* in, float* out, size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++) {
+				out[i] = (-2.f * in[i - 2]) - in[i - 1] + in[i + 1] + (2.f * in[i + 2]);
+			}
+		}
+
+		void SquareScalar(const float* in, float* out, size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++) {
+				out[i] = in[i] * in[i];
+			}
+		}
+
+		void Smooth3Scalar(const float* in, float* out, size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++) {
+				out[i] = in[i - 1] + (2.f * in[i]) + in[i + 1];
+			}
+		}
+
+		double MovingWindowIntegrateScalar(const float* in, float* out, size_t begin, size_t end, size_t window, double sum) {
+			const double scale = 1.0 / window;
+			for (size_t i = begin; i < end; i++) {
+				sum += in[i];
+				if (i >= window)
+					sum -= in[i - window];
+				out[i] = static_cast<float>(sum * scale);
+			}
+			return sum;
+		}
+
+		size_t FindThresholdCrossingsScalar(const float* in, size_t begin, size_t end, float threshold, uint32_t* crossings, size_t found, size_t maxCrossings) {
+			for (size_t i = begin; i < end && found < maxCrossings; i++) {
+				if (in[i - 1] < threshold && in[i] >= threshold)
+					crossings[found++] = static_cast<uint32_t>(i);
+			}
+			return found;
+		}
+
+		void DerivativeScalar(const int16_t* in, int16_t* out, size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++) {
+				int32_t value = (-2 * in[i - 2]) - in[i - 1] + in[i + 1] + (2 * in[i + 2]);
+				out[i] = static_cast<int16_t>(std::clamp<int32_t>(value, INT16_MIN, INT16_MAX));
+			}
+		}
+
+		void SquareScalar(const int16_t* in, int32_t* out, size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++) {
+				out[i] = in[i] * in[i];
+			}
+		}
+
+		void WeightedSumScalar(const int16_t* a, int16_t aWeight, const int16_t* b, int16_t bWeight, uint32_t shift, int16_t* out, size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++) {
+				int32_t value = (aWeight * a[i] + bWeight * b[i]) >> shift;
+				out[i] = static_cast<int16_t>(std::clamp<int32_t>(value, INT16_MIN, INT16_MAX));
+			}
+		}
+
+		void ZeroEdges(int16_t* out, size_t count, size_t edge) {
+			for (size_t i = 0; i < edge && i < count; i++) {
+				out[i] = 0;
+				out[count - 1 - i] = 0;
+			}
+		}
+
+		void ZeroEdges(float* out, size_t count, size_t edge) {
+			for (size_t i = 0; i < edge && i < count; i++) {
+				out[i] = 0.f;
+				out[count - 1 - i] = 0.f;
+			}
+		}
+
+		static void Derivative(const float* in, float* out, size_t count) {
+			ZeroEdges(out, count, 2);
+			if (count > 4)
+				DerivativeScalar(in, out, 2, count - 2);
+		}
+
+		static void Square(const float* in, float* out, size_t count) {
+			SquareScalar(in, out, 0, count);
+		}
+
+		static void Smooth3(const float* in, float* out, size_t count) {
+			ZeroEdges(out, count, 1);
+			if (count > 2)
+				Smooth3Scalar(in, out, 1, count - 1);
+		}
+
+		// Scalar reference keeps a double running sum, which is both O(1)
+		// per sample and accurate over long buffers.
+		static void MovingWindowIntegrate(const float* in, float* out, size_t count, size_t window) {
+			if (window == 0)
+				return;
+			MovingWindowIntegrateScalar(in, out, 0, count, window, 0.0);
+		}
+
+		static size_t FindThresholdCrossings(const float* in, size_t count, float threshold, uint32_t* crossings, size_t maxCrossings) {
+			return FindThresholdCrossingsScalar(in, 1, count, threshold, crossings, 0, maxCrossings);
+		}
+
+		static float DotProduct(const float* a, const float* b, size_t count) {
+			float sum = 0.f;
+			for (size_t i = 0; i < count; i++)
+				sum += a[i] * b[i];
+			return sum;
+		}
+
+		static void DerivativeI16(const int16_t* in, int16_t* out, size_t count) {
+			ZeroEdges(out, count, 2);
+			if (count > 4)
+				DerivativeScalar(in, out, 2, count - 2);
+		}
+
+		static void SquareI16(const int16_t* in, int32_t* out, size_t count) {
+			SquareScalar(in, out, 0, count);
+		}
+
+		static void WeightedSum(const int16_t* a, int16_t aWeight, const int16_t* b, int16_t bWeight, uint32_t shift, int16_t* out, size_t count) {
+			WeightedSumScalar(a, aWeight, b, bWeight, shift, out, 0, count);
+		}
+
+		static const DspKernelTable s_ScalarKernels = {
+			Derivative,
+			Square,
+			Smooth3,
+			MovingWindowIntegrate,
+			FindThresholdCrossings,
+			DerivativeI16,
+			SquareI16,
+			DotProduct,
+			WeightedSum
+		};
+
+#if !defined(__x86_64__) && !defined(__i386__)
+		const DspKernelTable* GetX86Kernels(SimdLevel) {
+			return nullptr;
+		}
+#endif
+
+#if !defined(__arm__) && !defined(__aarch64__)
+		const DspKernelTable* GetNeonKernels() {
+			return nullptr;
+		}
+#endif
+	}
+
+	static std::atomic<const detail::DspKernelTable*> s_ActiveKernels = nullptr;
+	static std::atomic<SimdLevel> s_ActiveLevel = SimdLevel::SCALAR;
+
+	static const detail::DspKernelTable* GetKernels(SimdLevel level) {
+		switch (level) {
+		case SimdLevel::SCALAR: return &detail::s_ScalarKernels;
+		case SimdLevel::SSE4:
+		case SimdLevel::AVX2: return detail::GetX86Kernels(level);
+		case SimdLevel::NEON: return detail::GetNeonKernels();
+		}
+		return nullptr;
+	}
+
+	SimdLevel GetSupportedSimdLevel() {
+		for (SimdLevel level : { SimdLevel::AVX2, SimdLevel::SSE4, SimdLevel::NEON }) {
+			if (GetKernels(level))
+				return level;
+		}
+		return SimdLevel::SCALAR;
+	}
+
+	static const detail::DspKernelTable* GetActiveKernels() {
+		const detail::DspKernelTable* kernels = s_ActiveKernels.load(std::memory_order_acquire);
+		if (!kernels) {
+			SimdLevel level = GetSupportedSimdLevel();
+			kernels = GetKernels(level);
+			s_ActiveLevel.store(level, std::memory_order_relaxed);
+			s_ActiveKernels.store(kernels, std::memory_order_release);
+		}
+		return kernels;
+	}
+
+	SimdLevel GetSimdLevel() {
+		GetActiveKernels();
+		return s_ActiveLevel.load(std::memory_order_relaxed);
+	}
+
+	const char* GetSimdLevelName(SimdLevel level) {
+		switch (level) {
+		case SimdLevel::SCALAR: return "scalar";
+		case SimdLevel::SSE4: return "sse4.1";
+		case SimdLevel::AVX2: return "avx2";
+		case SimdLevel::NEON: return "neon";
+		}
+		return "unknown";
+	}
+
+	bool SetSimdLevel(SimdLevel level) {
+		const detail::DspKernelTable* kernels = GetKernels(level);
+		if (!kernels)
+			return false;
+
+		s_ActiveLevel.store(level, std::memory_order_relaxed);
+		s_ActiveKernels.store(kernels, std::memory_order_release);
+		return true;
+	}
+
+	void Derivative(const float* in, float* out, size_t count) {
+		GetActiveKernels()->derivative(in, out, count);
+	}
+
+	void Square(const float* in, float* out, size_t count) {
+		GetActiveKernels()->square(in, out, count);
+	}
+
+	void Smooth3(const float* in, float* out, size_t count) {
+		GetActiveKernels()->smooth3(in, out, count);
+	}
+
+	void MovingWindowIntegrate(const float* in, float* out, size_t count, size_t window) {
+		GetActiveKernels()->movingWindowIntegrate(in, out, count, window);
+	}
+
+	size_t FindThresholdCrossings(const float* in, size_t count, float threshold, uint32_t* crossings, size_t maxCrossings) {
+		return GetActiveKernels()->findThresholdCrossings(in, count, threshold, crossings, maxCrossings);
+	}
+
+	float DotProduct(const float* a, const float* b, size_t count) {
+		return GetActiveKernels()->dotProduct(a, b, count);
+	}
+
+	void Derivative(const int16_t* in, int16_t* out, size_t count) {
+		GetActiveKernels()->derivativeI16(in, out, count);
+	}
+
+	void Square(const int16_t* in, int32_t* out, size_t count) {
+		GetActiveKernels()->squareI16(in, out, count);
+	}
+
+	void WeightedSum(const int16_t* a, int16_t aWeight, const int16_t* b, int16_t bWeight, uint32_t shift, int16_t* out, size_t count) {
+		GetActiveKernels()->weightedSum(a, aWeight, b, bWeight, shift, out, count);
+	}
+}
+
@@ -0,0 +1,93 @@
+#ifndef CEE_DSP_KERNELS_H_
+#define CEE_DSP_KERNELS_H_
+
+#include <cstdint>
+#include <cstddef>
+
+namespace cee {
+	enum class SimdLevel {
+		SCALAR = 0,
+		SSE4,
+		AVX2,
+		NEON
+	};
+
+	// Best level supported by this CPU, detected once on first use.
+	SimdLevel GetSupportedSimdLevel();
+	SimdLevel GetSimdLevel();
+	const char* GetSimdLevelName(SimdLevel level);
+	// Forces a level, e.g. to compare variants. Returns false if the CPU or
+	// build does not support it.
+	bool SetSimdLevel(SimdLevel level);
+
+	// Runtime-dispatched float kernels for the QRS pipeline. Derivative,
+	// Square, Smooth3 and FindThresholdCrossings are bit-exact across all
+	// levels. MovingWindowIntegrate keeps an O(1) double running sum at
+	// every level, associated differently by the vector scans, and agrees
+	// with the scalar path to float rounding. Benchmarks kernels checks both.
+	//
+	// Edge samples a stencil can not cover are written as zero, matching
+	// CalculateDoubleDifferenceSquared. `in` and `out` must not overlap,
+	// except for Square which may run in place.
+
+	// out[i] = -2 in[i-2] - in[i-1] + in[i+1] + 2 in[i+2]
+	void Derivative(const float* in, float* out, size_t count);
+	// out[i] = in[i] * in[i]
+	void Square(const float* in, float* out, size_t count);
+	// out[i] = in[i-1] + 2 in[i] + in[i+1]
+	void Smooth3(const float* in, float* out, size_t count);
+	// out[i] = (in[i-window+1] + ... + in[i]) / window, in[j < 0] = 0
+	void MovingWindowIntegrate(const float* in, float* out, size_t count, size_t window);
+	// Writes the indices i where in[i-1] < threshold <= in[i], up to
+	// maxCrossings of them. Returns the number written.
+	size_t FindThresholdCrossings(const float* in, size_t count, float threshold, uint32_t* crossings, size_t maxCrossings);
+	// Sum of a[i] * b[i]. Like MovingWindowIntegrate, the vector levels sum
+	// in a different order.
+	float DotProduct(const float* a, const float* b, size_t count);
+
+	// Fixed-point variants, bit-exact across all levels. Vector lanes hold
+	// twice as many int16 samples as floats.
+
+	// As above, computed exactly and saturated to int16.
+	void Derivative(const int16_t* in, int16_t* out, size_t count);
+	// Widens, so it can not overflow.
+	void Square(const int16_t* in, int32_t* out, size_t count);
+	// out[i] = (aWeight a[i] + bWeight b[i]) >> shift, saturated to int16.
+	// The shift is arithmetic, so it rounds towards negative infinity.
+	void WeightedSum(const int16_t* a, int16_t aWeight, const int16_t* b, int16_t bWeight, uint32_t shift, int16_t* out, size_t count);
+
+	namespace detail {
+		struct DspKernelTable {
+			void (*derivative)(const float* in, float* out, size_t count);
+			void (*square)(const float* in, float* out, size_t count);
+			void (*smooth3)(const float* in, float* out, size_t count);
+			void (*movingWindowIntegrate)(const float* in, float* out, size_t count, size_t window);
+			size_t (*findThresholdCrossings)(const float* in, size_t count, float threshold, uint32_t* crossings, size_t maxCrossings);
+			void (*derivativeI16)(const int16_t* in, int16_t* out, size_t count);
+			void (*squareI16)(const int16_t* in, int32_t* out, size_t count);
+			float (*dotProduct)(const float* a, const float* b, size_t count);
+			void (*weightedSum)(const int16_t* a, int16_t aWeight, const int16_t* b, int16_t bWeight, uint32_t shift, int16_t* out, size_t count);
+		};
+
+		// Defined per architecture; return nullptr when unavailable.
+		const DspKernelTable* GetX86Kernels(SimdLevel level);
+		const DspKernelTable* GetNeonKernels();
+
+		// Scalar tails shared by the vector variants.
+		void ZeroEdges(float* out, size_t count, size_t edge);
+		void DerivativeScalar(const float* in, float* out, size_t begin, size_t end);
+		void SquareScalar(const float* in, float* out, size_t begin, size_t end);
+		void Smooth3Scalar(const float* in, float* out, size_t begin, size_t end);
+		// Running sum over [begin, end) starting from the window sum `sum`
+		// ending at begin - 1; returns the sum ending at end - 1.
+		double MovingWindowIntegrateScalar(const float* in, float* out, size_t begin, size_t end, size_t window, double sum);
+		size_t FindThresholdCrossingsScalar(const float* in, size_t begin, size_t end, float threshold, uint32_t* crossings, size_t found, size_t maxCrossings);
+		void ZeroEdges(int16_t* out, size_t count, size_t edge);
+		void DerivativeScalar(const int16_t* in, int16_t* out, size_t begin, size_t end);
+		void SquareScalar(const int16_t* in, int32_t* out, size_t begin, size_t end);
+		void WeightedSumScalar(const int16_t* a, int16_t aWeight, const int16_t* b, int16_t bWeight, uint32_t shift, int16_t* out, size_t begin, size_t end);
+	}
+}
+
+#endif
+
@@ -0,0 +1,176 @@
+#include "dspKernels.hh"
+
+#if defined(__arm__) || defined(__aarch64__)
+
+#if defined(__ARM_NEON)
+#include <algorithm>
+
+#include <arm_neon.h>
+#if defined(__arm__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+#endif
+
+namespace cee {
+	namespace detail {
+#if defined(__ARM_NEON)
+		static void DerivativeNeon(const float* in, float* out, size_t count) {
+			ZeroEdges(out, count, 2);
+			if (count < 5)
+				return;
+
+			const float32x4_t minusTwo = vdupq_n_f32(-2.f);
+			const float32x4_t two = vdupq_n_f32(2.f);
+			size_t i = 2;
+			for (; i + 4 <= count - 2; i += 4) {
+				// vmulq/vaddq rather than vmlaq so no fused rounding differs
+				// from the scalar path.
+				float32x4_t value = vmulq_f32(minusTwo, vld1q_f32(in + i - 2));
+				value = vsubq_f32(value, vld1q_f32(in + i - 1));
+				value = vaddq_f32(value, vld1q_f32(in + i + 1));
+				value = vaddq_f32(value, vmulq_f32(two, vld1q_f32(in + i + 2)));
+				vst1q_f32(out + i, value);
+			}
+			DerivativeScalar(in, out, i, count - 2);
+		}
+
+		static void SquareNeon(const float* in, float* out, size_t count) {
+			size_t i = 0;
+			for (; i + 4 <= count; i += 4) {
+				float32x4_t value = vld1q_f32(in + i);
+				vst1q_f32(out + i, vmulq_f32(value, value));
+			}
+			SquareScalar(in, out, i, count);
+		}
+
+		static void Smooth3Neon(const float* in, float* out, size_t count) {
+			ZeroEdges(out, count, 1);
+			if (count < 3)
+				return;
+
+			const float32x4_t two = vdupq_n_f32(2.f);
+			size_t i = 1;
+			for (; i + 4 <= count - 1; i += 4) {
+				float32x4_t value = vaddq_f32(vld1q_f32(in + i - 1), vmulq_f32(two, vld1q_f32(in + i)));
+				vst1q_f32(out + i, vaddq_f32(value, vld1q_f32(in + i + 1)));
+			}
+			Smooth3Scalar(in, out, i, count - 1);
+		}
+
+		// The Pi's NEON has no double lanes, and a float scan loses the small
+		// window sums that follow a QRS, so this keeps the scalar double
+		// running sum.
+		static void MovingWindowIntegrateNeon(const float* in, float* out, size_t count, size_t window) {
+			if (window == 0)
+				return;
+			MovingWindowIntegrateScalar(in, out, 0, count, window, 0.0);
+		}
+
+		static size_t FindThresholdCrossingsNeon(const float* in, size_t count, float threshold, uint32_t* crossings, size_t maxCrossings) {
+			const float32x4_t limit = vdupq_n_f32(threshold);
+			const uint32_t laneBitsData[4] = { 1, 2, 4, 8 };
+			const uint32x4_t laneBits = vld1q_u32(laneBitsData);
+			size_t found = 0;
+			size_t i = 1;
+			for (; i + 4 <= count && found < maxCrossings; i += 4) {
+				uint32x4_t below = vcltq_f32(vld1q_f32(in + i - 1), limit);
+				uint32x4_t above = vcgeq_f32(vld1q_f32(in + i), limit);
+				// NEON has no movemask, so fold the lane bits with pairwise adds.
+				uint32x4_t bits = vandq_u32(vandq_u32(below, above), laneBits);
+				uint32x2_t folded = vpadd_u32(vget_low_u32(bits), vget_high_u32(bits));
+				folded = vpadd_u32(folded, folded);
+				uint32_t mask = vget_lane_u32(folded, 0);
+				while (mask && found < maxCrossings) {
+					crossings[found++] = static_cast<uint32_t>(i + __builtin_ctz(mask));
+					mask &= mask - 1;
+				}
+			}
+			return FindThresholdCrossingsScalar(in, i, count, threshold, crossings, found, maxCrossings);
+		}
+
+		static float DotProductNeon(const float* a, const float* b, size_t count) {
+			float32x4_t sum = vdupq_n_f32(0.f);
+			size_t i = 0;
+			for (; i + 4 <= count; i += 4)
+				sum = vaddq_f32(sum, vmulq_f32(vld1q_f32(a + i), vld1q_f32(b + i)));
+			float32x2_t folded = vadd_f32(vget_low_f32(sum), vget_high_f32(sum));
+			float total = vget_lane_f32(vpadd_f32(folded, folded), 0);
+			for (; i < count; i++)
+				total += a[i] * b[i];
+			return total;
+		}
+
+		static void DerivativeI16Neon(const int16_t* in, int16_t* out, size_t count) {
+			ZeroEdges(out, count, 2);
+			if (count < 5)
+				return;
+
+			size_t i = 2;
+			for (; i + 8 <= count - 2; i += 8) {
+				// Exact in int32 lanes, then a saturating narrow.
+				int16x8_t a = vld1q_s16(in + i - 2), b = vld1q_s16(in + i - 1);
+				int16x8_t d = vld1q_s16(in + i + 1), e = vld1q_s16(in + i + 2);
+				int32x4_t low = vshlq_n_s32(vsubl_s16(vget_low_s16(e), vget_low_s16(a)), 1);
+				low = vaddq_s32(low, vsubl_s16(vget_low_s16(d), vget_low_s16(b)));
+				int32x4_t high = vshlq_n_s32(vsubl_s16(vget_high_s16(e), vget_high_s16(a)), 1);
+				high = vaddq_s32(high, vsubl_s16(vget_high_s16(d), vget_high_s16(b)));
+				vst1q_s16(out + i, vcombine_s16(vqmovn_s32(low), vqmovn_s32(high)));
+			}
+			DerivativeScalar(in, out, i, count - 2);
+		}
+
+		static void SquareI16Neon(const int16_t* in, int32_t* out, size_t count) {
+			size_t i = 0;
+			for (; i + 8 <= count; i += 8) {
+				int16x8_t value = vld1q_s16(in + i);
+				vst1q_s32(out + i, vmull_s16(vget_low_s16(value), vget_low_s16(value)));
+				vst1q_s32(out + i + 4, vmull_s16(vget_high_s16(value), vget_high_s16(value)));
+			}
+			SquareScalar(in, out, i, count);
+		}
+
+		static void WeightedSumNeon(const int16_t* a, int16_t aWeight, const int16_t* b, int16_t bWeight, uint32_t shift, int16_t* out, size_t count) {
+			// vshlq with a negative count is an arithmetic right shift.
+			const int32x4_t shiftCount = vdupq_n_s32(-static_cast<int32_t>(shift));
+			size_t i = 0;
+			for (; i + 8 <= count; i += 8) {
+				int16x8_t first = vld1q_s16(a + i), second = vld1q_s16(b + i);
+				int32x4_t low = vmlal_n_s16(vmull_n_s16(vget_low_s16(first), aWeight), vget_low_s16(second), bWeight);
+				int32x4_t high = vmlal_n_s16(vmull_n_s16(vget_high_s16(first), aWeight), vget_high_s16(second), bWeight);
+				low = vshlq_s32(low, shiftCount);
+				high = vshlq_s32(high, shiftCount);
+				vst1q_s16(out + i, vcombine_s16(vqmovn_s32(low), vqmovn_s32(high)));
+			}
+			WeightedSumScalar(a, aWeight, b, bWeight, shift, out, i, count);
+		}
+
+		static const DspKernelTable s_NeonKernels = {
+			DerivativeNeon,
+			SquareNeon,
+			Smooth3Neon,
+			MovingWindowIntegrateNeon,
+			FindThresholdCrossingsNeon,
+			DerivativeI16Neon,
+			SquareI16Neon,
+			DotProductNeon,
+			WeightedSumNeon
+		};
+#endif
+
+		const DspKernelTable* GetNeonKernels() {
+#if defined(__ARM_NEON) && defined(__aarch64__)
+			return &s_NeonKernels;
+#elif defined(__ARM_NEON)
+			if (getauxval(AT_HWCAP) & HWCAP_NEON)
+				return &s_NeonKernels;
+			return nullptr;
+#else
+			return nullptr;
+#endif
+		}
+	}
+}
+
+#endif
+
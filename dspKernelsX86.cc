@@ -0,0 +1,367 @@
+#include "dspKernels.hh"
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#include <algorithm>
+
+#include <immintrin.h>
+
+namespace cee {
+	namespace detail {
+		__attribute__((target("sse4.1")))
+		static void DerivativeSse4(const float* in, float* out, size_t count) {
+			ZeroEdges(out, count, 2);
+			if (count < 5)
+				return;
+
+			const __m128 minusTwo = _mm_set1_ps(-2.f);
+			const __m128 two = _mm_set1_ps(2.f);
+			size_t i = 2;
+			for (; i + 4 <= count - 2; i += 4) {
+				__m128 value = _mm_mul_ps(minusTwo, _mm_loadu_ps(in + i - 2));
+				value = _mm_sub_ps(value, _mm_loadu_ps(in + i - 1));
+				value = _mm_add_ps(value, _mm_loadu_ps(in + i + 1));
+				value = _mm_add_ps(value, _mm_mul_ps(two, _mm_loadu_ps(in + i + 2)));
+				_mm_storeu_ps(out + i, value);
+			}
+			DerivativeScalar(in, out, i, count - 2);
+		}
+
+		__attribute__((target("sse4.1")))
+		static void SquareSse4(const float* in, float* out, size_t count) {
+			size_t i = 0;
+			for (; i + 4 <= count; i += 4) {
+				__m128 value = _mm_loadu_ps(in + i);
+				_mm_storeu_ps(out + i, _mm_mul_ps(value, value));
+			}
+			SquareScalar(in, out, i, count);
+		}
+
+		__attribute__((target("sse4.1")))
+		static void Smooth3Sse4(const float* in, float* out, size_t count) {
+			ZeroEdges(out, count, 1);
+			if (count < 3)
+				return;
+
+			const __m128 two = _mm_set1_ps(2.f);
+			size_t i = 1;
+			for (; i + 4 <= count - 1; i += 4) {
+				__m128 value = _mm_add_ps(_mm_loadu_ps(in + i - 1), _mm_mul_ps(two, _mm_loadu_ps(in + i)));
+				_mm_storeu_ps(out + i, _mm_add_ps(value, _mm_loadu_ps(in + i + 1)));
+			}
+			Smooth3Scalar(in, out, i, count - 1);
+		}
+
+		// Running sum as a prefix scan of in[i] - in[i - window] in double
+		// lanes, like the scalar path, so long buffers do not drift. Only the
+		// carry between vectors is loop-carried.
+		__attribute__((target("sse4.1")))
+		static void MovingWindowIntegrateSse4(const float* in, float* out, size_t count, size_t window) {
+			if (window == 0)
+				return;
+
+			size_t i = std::min(count, window);
+			double sum = MovingWindowIntegrateScalar(in, out, 0, i, window, 0.0);
+
+			const __m128d scale = _mm_set1_pd(1.0 / window);
+			__m128d carry = _mm_set1_pd(sum);
+			for (; i + 4 <= count; i += 4) {
+				__m128 added = _mm_loadu_ps(in + i);
+				__m128 removed = _mm_loadu_ps(in + i - window);
+				__m128d low = _mm_sub_pd(_mm_cvtps_pd(added), _mm_cvtps_pd(removed));
+				__m128d high = _mm_sub_pd(_mm_cvtps_pd(_mm_movehl_ps(added, added)), _mm_cvtps_pd(_mm_movehl_ps(removed, removed)));
+				low = _mm_add_pd(low, _mm_castsi128_pd(_mm_slli_si128(_mm_castpd_si128(low), 8)));
+				high = _mm_add_pd(high, _mm_castsi128_pd(_mm_slli_si128(_mm_castpd_si128(high), 8)));
+				low = _mm_add_pd(low, carry);
+				high = _mm_add_pd(high, _mm_unpackhi_pd(low, low));
+				carry = _mm_unpackhi_pd(high, high);
+				__m128 result = _mm_movelh_ps(_mm_cvtpd_ps(_mm_mul_pd(low, scale)), _mm_cvtpd_ps(_mm_mul_pd(high, scale)));
+				_mm_storeu_ps(out + i, result);
+			}
+			MovingWindowIntegrateScalar(in, out, i, count, window, _mm_cvtsd_f64(carry));
+		}
+
+		__attribute__((target("sse4.1")))
+		static size_t FindThresholdCrossingsSse4(const float* in, size_t count, float threshold, uint32_t* crossings, size_t maxCrossings) {
+			const __m128 limit = _mm_set1_ps(threshold);
+			size_t found = 0;
+			size_t i = 1;
+			for (; i + 4 <= count && found < maxCrossings; i += 4) {
+				__m128 below = _mm_cmplt_ps(_mm_loadu_ps(in + i - 1), limit);
+				__m128 above = _mm_cmpge_ps(_mm_loadu_ps(in + i), limit);
+				uint32_t mask = static_cast<uint32_t>(_mm_movemask_ps(_mm_and_ps(below, above)));
+				while (mask && found < maxCrossings) {
+					crossings[found++] = static_cast<uint32_t>(i + __builtin_ctz(mask));
+					mask &= mask - 1;
+				}
+			}
+			return FindThresholdCrossingsScalar(in, i, count, threshold, crossings, found, maxCrossings);
+		}
+
+		__attribute__((target("sse4.1")))
+		static float DotProductSse4(const float* a, const float* b, size_t count) {
+			__m128 sum = _mm_setzero_ps();
+			size_t i = 0;
+			for (; i + 4 <= count; i += 4)
+				sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+			sum = _mm_hadd_ps(sum, sum);
+			sum = _mm_hadd_ps(sum, sum);
+			float total = _mm_cvtss_f32(sum);
+			for (; i < count; i++)
+				total += a[i] * b[i];
+			return total;
+		}
+
+		// The int16 stencil is evaluated in int32 lanes and narrowed with a
+		// saturating pack, so it matches the scalar clamp exactly.
+		__attribute__((target("sse4.1")))
+		static __m128i LoadWidenSse4(const int16_t* in) {
+			return _mm_cvtepi16_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(in)));
+		}
+
+		__attribute__((target("sse4.1")))
+		static __m128i DerivativeI16Sse4(const int16_t* in, size_t i) {
+			__m128i outer = _mm_slli_epi32(_mm_sub_epi32(LoadWidenSse4(in + i + 2), LoadWidenSse4(in + i - 2)), 1);
+			return _mm_add_epi32(outer, _mm_sub_epi32(LoadWidenSse4(in + i + 1), LoadWidenSse4(in + i - 1)));
+		}
+
+		__attribute__((target("sse4.1")))
+		static void DerivativeI16Sse4(const int16_t* in, int16_t* out, size_t count) {
+			ZeroEdges(out, count, 2);
+			if (count < 5)
+				return;
+
+			size_t i = 2;
+			for (; i + 8 <= count - 2; i += 8) {
+				__m128i value = _mm_packs_epi32(DerivativeI16Sse4(in, i), DerivativeI16Sse4(in, i + 4));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), value);
+			}
+			DerivativeScalar(in, out, i, count - 2);
+		}
+
+		__attribute__((target("sse4.1")))
+		static void SquareI16Sse4(const int16_t* in, int32_t* out, size_t count) {
+			size_t i = 0;
+			for (; i + 8 <= count; i += 8) {
+				__m128i value = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+				__m128i low = _mm_mullo_epi16(value, value);
+				__m128i high = _mm_mulhi_epi16(value, value);
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_unpacklo_epi16(low, high));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + 4), _mm_unpackhi_epi16(low, high));
+			}
+			SquareScalar(in, out, i, count);
+		}
+
+		__attribute__((target("sse4.1")))
+		static void WeightedSumSse4(const int16_t* a, int16_t aWeight, const int16_t* b, int16_t bWeight, uint32_t shift, int16_t* out, size_t count) {
+			const __m128i aWeights = _mm_set1_epi32(aWeight);
+			const __m128i bWeights = _mm_set1_epi32(bWeight);
+			const __m128i shiftCount = _mm_cvtsi32_si128(static_cast<int>(shift));
+			size_t i = 0;
+			for (; i + 8 <= count; i += 8) {
+				__m128i low = _mm_add_epi32(_mm_mullo_epi32(LoadWidenSse4(a + i), aWeights), _mm_mullo_epi32(LoadWidenSse4(b + i), bWeights));
+				__m128i high = _mm_add_epi32(_mm_mullo_epi32(LoadWidenSse4(a + i + 4), aWeights), _mm_mullo_epi32(LoadWidenSse4(b + i + 4), bWeights));
+				__m128i value = _mm_packs_epi32(_mm_sra_epi32(low, shiftCount), _mm_sra_epi32(high, shiftCount));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), value);
+			}
+			WeightedSumScalar(a, aWeight, b, bWeight, shift, out, i, count);
+		}
+
+		__attribute__((target("avx2")))
+		static void DerivativeAvx2(const float* in, float* out, size_t count) {
+			ZeroEdges(out, count, 2);
+			if (count < 5)
+				return;
+
+			const __m256 minusTwo = _mm256_set1_ps(-2.f);
+			const __m256 two = _mm256_set1_ps(2.f);
+			size_t i = 2;
+			for (; i + 8 <= count - 2; i += 8) {
+				__m256 value = _mm256_mul_ps(minusTwo, _mm256_loadu_ps(in + i - 2));
+				value = _mm256_sub_ps(value, _mm256_loadu_ps(in + i - 1));
+				value = _mm256_add_ps(value, _mm256_loadu_ps(in + i + 1));
+				value = _mm256_add_ps(value, _mm256_mul_ps(two, _mm256_loadu_ps(in + i + 2)));
+				_mm256_storeu_ps(out + i, value);
+			}
+			DerivativeScalar(in, out, i, count - 2);
+		}
+
+		__attribute__((target("avx2")))
+		static void SquareAvx2(const float* in, float* out, size_t count) {
+			size_t i = 0;
+			for (; i + 8 <= count; i += 8) {
+				__m256 value = _mm256_loadu_ps(in + i);
+				_mm256_storeu_ps(out + i, _mm256_mul_ps(value, value));
+			}
+			SquareScalar(in, out, i, count);
+		}
+
+		__attribute__((target("avx2")))
+		static void Smooth3Avx2(const float* in, float* out, size_t count) {
+			ZeroEdges(out, count, 1);
+			if (count < 3)
+				return;
+
+			const __m256 two = _mm256_set1_ps(2.f);
+			size_t i = 1;
+			for (; i + 8 <= count - 1; i += 8) {
+				__m256 value = _mm256_add_ps(_mm256_loadu_ps(in + i - 1), _mm256_mul_ps(two, _mm256_loadu_ps(in + i)));
+				_mm256_storeu_ps(out + i, _mm256_add_ps(value, _mm256_loadu_ps(in + i + 1)));
+			}
+			Smooth3Scalar(in, out, i, count - 1);
+		}
+
+		// Inclusive prefix sum of four double lanes.
+		__attribute__((target("avx2")))
+		static __m256d PrefixSumAvx2(__m256d value) {
+			__m256d shifted = _mm256_blend_pd(_mm256_permute4x64_pd(value, _MM_SHUFFLE(2, 1, 0, 0)), _mm256_setzero_pd(), 0b0001);
+			value = _mm256_add_pd(value, shifted);
+			return _mm256_add_pd(value, _mm256_permute2f128_pd(value, value, 0x08));
+		}
+
+		__attribute__((target("avx2")))
+		static void MovingWindowIntegrateAvx2(const float* in, float* out, size_t count, size_t window) {
+			if (window == 0)
+				return;
+
+			size_t i = std::min(count, window);
+			double sum = MovingWindowIntegrateScalar(in, out, 0, i, window, 0.0);
+
+			const __m256d scale = _mm256_set1_pd(1.0 / window);
+			__m256d carry = _mm256_set1_pd(sum);
+			for (; i + 8 <= count; i += 8) {
+				__m256 added = _mm256_loadu_ps(in + i);
+				__m256 removed = _mm256_loadu_ps(in + i - window);
+				__m256d low = _mm256_sub_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(added)), _mm256_cvtps_pd(_mm256_castps256_ps128(removed)));
+				__m256d high = _mm256_sub_pd(_mm256_cvtps_pd(_mm256_extractf128_ps(added, 1)), _mm256_cvtps_pd(_mm256_extractf128_ps(removed, 1)));
+				low = _mm256_add_pd(PrefixSumAvx2(low), carry);
+				high = _mm256_add_pd(PrefixSumAvx2(high), _mm256_permute4x64_pd(low, _MM_SHUFFLE(3, 3, 3, 3)));
+				carry = _mm256_permute4x64_pd(high, _MM_SHUFFLE(3, 3, 3, 3));
+				__m256 result = _mm256_set_m128(_mm256_cvtpd_ps(_mm256_mul_pd(high, scale)), _mm256_cvtpd_ps(_mm256_mul_pd(low, scale)));
+				_mm256_storeu_ps(out + i, result);
+			}
+			MovingWindowIntegrateScalar(in, out, i, count, window, _mm256_cvtsd_f64(carry));
+		}
+
+		__attribute__((target("avx2")))
+		static size_t FindThresholdCrossingsAvx2(const float* in, size_t count, float threshold, uint32_t* crossings, size_t maxCrossings) {
+			const __m256 limit = _mm256_set1_ps(threshold);
+			size_t found = 0;
+			size_t i = 1;
+			for (; i + 8 <= count && found < maxCrossings; i += 8) {
+				__m256 below = _mm256_cmp_ps(_mm256_loadu_ps(in + i - 1), limit, _CMP_LT_OQ);
+				__m256 above = _mm256_cmp_ps(_mm256_loadu_ps(in + i), limit, _CMP_GE_OQ);
+				uint32_t mask = static_cast<uint32_t>(_mm256_movemask_ps(_mm256_and_ps(below, above)));
+				while (mask && found < maxCrossings) {
+					crossings[found++] = static_cast<uint32_t>(i + __builtin_ctz(mask));
+					mask &= mask - 1;
+				}
+			}
+			return FindThresholdCrossingsScalar(in, i, count, threshold, crossings, found, maxCrossings);
+		}
+
+		__attribute__((target("avx2")))
+		static float DotProductAvx2(const float* a, const float* b, size_t count) {
+			__m256 sum = _mm256_setzero_ps();
+			size_t i = 0;
+			for (; i + 8 <= count; i += 8)
+				sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+			__m128 half = _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1));
+			half = _mm_hadd_ps(half, half);
+			half = _mm_hadd_ps(half, half);
+			float total = _mm_cvtss_f32(half);
+			for (; i < count; i++)
+				total += a[i] * b[i];
+			return total;
+		}
+
+		__attribute__((target("avx2")))
+		static __m256i LoadWidenAvx2(const int16_t* in) {
+			return _mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in)));
+		}
+
+		__attribute__((target("avx2")))
+		static __m256i DerivativeI16Avx2(const int16_t* in, size_t i) {
+			__m256i outer = _mm256_slli_epi32(_mm256_sub_epi32(LoadWidenAvx2(in + i + 2), LoadWidenAvx2(in + i - 2)), 1);
+			return _mm256_add_epi32(outer, _mm256_sub_epi32(LoadWidenAvx2(in + i + 1), LoadWidenAvx2(in + i - 1)));
+		}
+
+		__attribute__((target("avx2")))
+		static void DerivativeI16Avx2(const int16_t* in, int16_t* out, size_t count) {
+			ZeroEdges(out, count, 2);
+			if (count < 5)
+				return;
+
+			size_t i = 2;
+			for (; i + 16 <= count - 2; i += 16) {
+				// packs works within 128-bit lanes, so restore the order after.
+				__m256i value = _mm256_packs_epi32(DerivativeI16Avx2(in, i), DerivativeI16Avx2(in, i + 8));
+				value = _mm256_permute4x64_epi64(value, _MM_SHUFFLE(3, 1, 2, 0));
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), value);
+			}
+			DerivativeScalar(in, out, i, count - 2);
+		}
+
+		__attribute__((target("avx2")))
+		static void SquareI16Avx2(const int16_t* in, int32_t* out, size_t count) {
+			size_t i = 0;
+			for (; i + 8 <= count; i += 8) {
+				__m256i value = LoadWidenAvx2(in + i);
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_mullo_epi32(value, value));
+			}
+			SquareScalar(in, out, i, count);
+		}
+
+		__attribute__((target("avx2")))
+		static void WeightedSumAvx2(const int16_t* a, int16_t aWeight, const int16_t* b, int16_t bWeight, uint32_t shift, int16_t* out, size_t count) {
+			const __m256i aWeights = _mm256_set1_epi32(aWeight);
+			const __m256i bWeights = _mm256_set1_epi32(bWeight);
+			const __m128i shiftCount = _mm_cvtsi32_si128(static_cast<int>(shift));
+			size_t i = 0;
+			for (; i + 16 <= count; i += 16) {
+				__m256i low = _mm256_add_epi32(_mm256_mullo_epi32(LoadWidenAvx2(a + i), aWeights), _mm256_mullo_epi32(LoadWidenAvx2(b + i), bWeights));
+				__m256i high = _mm256_add_epi32(_mm256_mullo_epi32(LoadWidenAvx2(a + i + 8), aWeights), _mm256_mullo_epi32(LoadWidenAvx2(b + i + 8), bWeights));
+				__m256i value = _mm256_packs_epi32(_mm256_sra_epi32(low, shiftCount), _mm256_sra_epi32(high, shiftCount));
+				value = _mm256_permute4x64_epi64(value, _MM_SHUFFLE(3, 1, 2, 0));
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), value);
+			}
+			WeightedSumScalar(a, aWeight, b, bWeight, shift, out, i, count);
+		}
+
+		static const DspKernelTable s_Sse4Kernels = {
+			DerivativeSse4,
+			SquareSse4,
+			Smooth3Sse4,
+			MovingWindowIntegrateSse4,
+			FindThresholdCrossingsSse4,
+			DerivativeI16Sse4,
+			SquareI16Sse4,
+			DotProductSse4,
+			WeightedSumSse4
+		};
+
+		static const DspKernelTable s_Avx2Kernels = {
+			DerivativeAvx2,
+			SquareAvx2,
+			Smooth3Avx2,
+			MovingWindowIntegrateAvx2,
+			FindThresholdCrossingsAvx2,
+			DerivativeI16Avx2,
+			SquareI16Avx2,
+			DotProductAvx2,
+			WeightedSumAvx2
+		};
+
+		const DspKernelTable* GetX86Kernels(SimdLevel level) {
+			__builtin_cpu_init();
+			if (level == SimdLevel::AVX2 && __builtin_cpu_supports("avx2"))
+				return &s_Avx2Kernels;
+			if (level == SimdLevel::SSE4 && __builtin_cpu_supports("sse4.1"))
+				return &s_Sse4Kernels;
+			return nullptr;
+		}
+	}
+}
+
+#endif
+
@@ -0,0 +1,27 @@
+#ifndef CEE_ECG_SAMPLE_H_
+#define CEE_ECG_SAMPLE_H_
+
+#include <cstdint>
+
+#include "fixedPoint.hh"
+
+namespace cee {
+	enum EcgChannel : uint32_t {
+		ECG_LEAD_I = 0,
+		ECG_LEAD_II,
+		ECG_LEAD_III,
+		ECG_RESP,
+		ECG_CHANNEL_COUNT
+	};
+
+	struct EcgSample {
+		int64_t timestamp; // CLOCK_MONOTONIC acquisition time in nanoseconds
+		EcgFixed channels[ECG_CHANNEL_COUNT]; // see AdcCodeToFixed/FixedToVolts
+		EcgFixed raw[ECG_CHANNEL_COUNT];      // the same before baseline removal, for recording
+		bool leadsConnected;
+		uint8_t quality;      // 0-100, worst measured lead (SignalQualityMonitor)
+	};
+}
+
+#endif
+
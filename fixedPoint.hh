@@ -0,0 +1,97 @@
+#ifndef CEE_FIXED_POINT_H_
+#define CEE_FIXED_POINT_H_
+
+#include <algorithm>
+#include <limits>
+#include <type_traits>
+
+#include <cstdint>
+#include <cstddef>
+
+namespace cee {
+	// Arithmetic used by the DSP templates for each supported sample type.
+	// Integer types accumulate in a wider type and saturate when narrowed
+	// back. Squares are shifted right by SQUARE_SHIFT, which leaves room to
+	// sum four of them in the accumulator and keeps an int16 squared
+	// derivative from pinning at the limit.
+	template<typename T>
+	struct SampleTraits;
+
+	template<>
+	struct SampleTraits<float> {
+		using Accumulator = float;
+		static constexpr int SQUARE_SHIFT = 0;
+
+		static float Saturate(float value) { return value; }
+		static float Square(float value) { return value * value; }
+	};
+
+	template<>
+	struct SampleTraits<double> {
+		using Accumulator = double;
+		static constexpr int SQUARE_SHIFT = 0;
+
+		static double Saturate(double value) { return value; }
+		static double Square(double value) { return value * value; }
+	};
+
+	template<typename T, typename Wide, int Shift>
+	struct IntegerSampleTraits {
+		using Accumulator = Wide;
+		static constexpr int SQUARE_SHIFT = Shift;
+
+		static T Saturate(Wide value) {
+			return static_cast<T>(std::clamp<Wide>(value, std::numeric_limits<T>::min(), std::numeric_limits<T>::max()));
+		}
+
+		// `value` must already be saturated to T.
+		static Wide Square(Wide value) {
+			return (value * value) >> Shift;
+		}
+	};
+
+	template<>
+	struct SampleTraits<int16_t> : IntegerSampleTraits<int16_t, int32_t, 8> {};
+
+	template<>
+	struct SampleTraits<int32_t> : IntegerSampleTraits<int32_t, int64_t, 2> {};
+
+	template<typename T>
+	concept DspSample = requires { typename SampleTraits<T>::Accumulator; };
+
+	// ECG samples are carried as int16 from the ADC to the display: the
+	// 8-bit code, centred on mid-scale, with ECG_FIXED_FRACTION_BITS of
+	// fraction for what filtering and decimation add. Volts only appear at
+	// the display boundary.
+	using EcgFixed = int16_t;
+	constexpr int ECG_FIXED_FRACTION_BITS = 6;
+	constexpr float ECG_FIXED_ONE = 1 << ECG_FIXED_FRACTION_BITS;
+	// The PCF8591 front end spans +/-0.4 V over 255 codes.
+	constexpr float ECG_VOLTS_PER_CODE = 0.8f / 255.f;
+
+	constexpr EcgFixed AdcCodeToFixed(uint8_t code) {
+		return static_cast<EcgFixed>((static_cast<int32_t>(code) - 128) * (1 << ECG_FIXED_FRACTION_BITS));
+	}
+
+	// For codes that went through float filtering, e.g. the decimator.
+	inline EcgFixed AdcCodeToFixed(float code) {
+		float value = (code - 128.f) * ECG_FIXED_ONE;
+		value = std::clamp<float>(value, INT16_MIN, INT16_MAX);
+		return static_cast<EcgFixed>(value + (value < 0.f ? -0.5f : 0.5f));
+	}
+
+	constexpr float FixedToVolts(EcgFixed value) {
+		return value * (ECG_VOLTS_PER_CODE / ECG_FIXED_ONE);
+	}
+
+	// Gain of the ECG amplifier ahead of the ADC, for levels referred back
+	// to the electrodes (the synthetic source assumes the same).
+	constexpr float ECG_FRONT_END_GAIN = 200.f;
+
+	constexpr float FixedToMillivolts(float value) {
+		return value * (ECG_VOLTS_PER_CODE / ECG_FIXED_ONE * 1000.f / ECG_FRONT_END_GAIN);
+	}
+}
+
+#endif
+
@@ -0,0 +1,100 @@
+#include "heartRate.hh"
+
+#include <algorithm>
+#include <cstring>
+
+#include "util.h"
+
+namespace cee {
+	HeartRateMonitor::HeartRateMonitor(size_t window, int64_t asystoleTimeoutNs)
+	 : m_Window(std::clamp<size_t>(window, 1, MAX_WINDOW)), m_AsystoleTimeout(asystoleTimeoutNs),
+	   m_IntervalCount(0), m_IntervalPosition(0), m_IntervalSum(0), m_PvcCount(0), m_PvcPosition(0), m_HaveBeat(false)
+	{
+		memset(&m_Snapshot, 0, sizeof(m_Snapshot));
+	}
+
+	void HeartRateMonitor::AddBeat(const BeatEvent& beat) {
+		if (m_HaveBeat) {
+			int64_t interval = beat.timestamp - m_Snapshot.lastBeatTimestamp;
+			if (m_IntervalCount == m_Window) {
+				m_IntervalSum -= m_Intervals[m_IntervalPosition];
+			} else {
+				m_IntervalCount++;
+			}
+			m_Intervals[m_IntervalPosition] = interval;
+			m_IntervalSum += interval;
+			m_IntervalPosition = (m_IntervalPosition + 1) % m_Window;
+		}
+		m_HaveBeat = true;
+		m_Snapshot.lastBeatTimestamp = beat.timestamp;
+
+		if (m_Snapshot.beatCount == HEART_RATE_MAX_BEATS) {
+			std::copy(m_Snapshot.beatSequences + 1, m_Snapshot.beatSequences + HEART_RATE_MAX_BEATS, m_Snapshot.beatSequences);
+			std::copy(m_Snapshot.beatTimestamps + 1, m_Snapshot.beatTimestamps + HEART_RATE_MAX_BEATS, m_Snapshot.beatTimestamps);
+			std::copy(m_Snapshot.beatClasses + 1, m_Snapshot.beatClasses + HEART_RATE_MAX_BEATS, m_Snapshot.beatClasses);
+			m_Snapshot.beatCount--;
+		}
+		m_Snapshot.beatSequences[m_Snapshot.beatCount] = beat.sequence;
+		m_Snapshot.beatTimestamps[m_Snapshot.beatCount] = beat.timestamp;
+		m_Snapshot.beatClasses[m_Snapshot.beatCount] = BeatClass::UNCLASSIFIED;
+		m_Snapshot.beatCount++;
+
+		UpdateRate();
+	}
+
+	void HeartRateMonitor::ClassifyBeat(const BeatClassification& classification) {
+		for (uint32_t beat = m_Snapshot.beatCount; beat-- > 0;) {
+			if (m_Snapshot.beatSequences[beat] == classification.sequence) {
+				m_Snapshot.beatClasses[beat] = classification.beatClass;
+				break;
+			}
+		}
+
+		if (classification.beatClass == BeatClass::PVC) {
+			m_PvcTimestamps[m_PvcPosition] = classification.timestamp;
+			m_PvcPosition = (m_PvcPosition + 1) % HEART_RATE_MAX_BEATS;
+			m_PvcCount = std::min(m_PvcCount + 1, HEART_RATE_MAX_BEATS);
+		}
+		UpdatePvcRate(std::max(m_Snapshot.lastBeatTimestamp, classification.timestamp));
+	}
+
+	bool HeartRateMonitor::UpdatePvcRate(int64_t now) {
+		uint32_t recent = 0;
+		for (size_t n = 0; n < m_PvcCount; n++) {
+			if (now - m_PvcTimestamps[n] < int64_t(60) * NSEC_PER_SEC)
+				recent++;
+		}
+		bool changed = recent != m_Snapshot.pvcPerMinute;
+		m_Snapshot.pvcPerMinute = recent;
+		return changed;
+	}
+
+	bool HeartRateMonitor::Update(int64_t now) {
+		// PVCs age out of the minute even when no beats arrive to recount
+		// them, e.g. across asystole or lead off.
+		bool changed = UpdatePvcRate(now);
+		if (m_IntervalCount == 0 || now - m_Snapshot.lastBeatTimestamp <= m_AsystoleTimeout)
+			return changed;
+
+		// Rhythm lost: forget the old intervals so the rate only comes back
+		// once a new pair of beats has been seen.
+		m_IntervalCount = 0;
+		m_IntervalPosition = 0;
+		m_IntervalSum = 0;
+		UpdateRate();
+		return true;
+	}
+
+	void HeartRateMonitor::UpdateRate() {
+		if (m_IntervalCount == 0 || m_IntervalSum <= 0) {
+			m_Snapshot.rate = 0;
+			m_Snapshot.rrAverageMs = 0.f;
+			return;
+		}
+
+		double average = static_cast<double>(m_IntervalSum) / m_IntervalCount;
+		m_Snapshot.rrAverageMs = static_cast<float>(average / 1e6);
+		m_Snapshot.rate = static_cast<uint32_t>(60.0 * NSEC_PER_SEC / average + 0.5);
+	}
+}
+
@@ -0,0 +1,69 @@
+#ifndef CEE_HEART_RATE_H_
+#define CEE_HEART_RATE_H_
+
+#include <cstdint>
+#include <cstddef>
+
+#include "qrsDetector.hh"
+#include "beatClassifier.hh"
+
+namespace cee {
+	constexpr size_t HEART_RATE_MAX_BEATS = 64;
+
+	struct HeartRateSnapshot {
+		uint32_t rate;                 // bpm, 0 when there is no rhythm
+		float rrAverageMs;
+		int64_t lastBeatTimestamp;
+		uint32_t pvcPerMinute;         // PVCs in the last minute
+		uint32_t beatCount;            // valid entries below, oldest first
+		uint64_t beatSequences[HEART_RATE_MAX_BEATS];
+		int64_t beatTimestamps[HEART_RATE_MAX_BEATS];
+		BeatClass beatClasses[HEART_RATE_MAX_BEATS];
+	};
+
+	// Rolling RR-interval average over the last `window` beats, updated in
+	// O(1) per beat from detector events.
+	class HeartRateMonitor {
+	public:
+		static constexpr size_t MAX_WINDOW = 32;
+
+	public:
+		HeartRateMonitor(size_t window = 8, int64_t asystoleTimeoutNs = 4000000000ll);
+		~HeartRateMonitor() = default;
+
+		void AddBeat(const BeatEvent& beat);
+		// Called across a gap in analysis; the next beat opens no interval.
+		void Interrupt() { m_HaveBeat = false; }
+		// Classification arrives a few samples after the beat itself.
+		void ClassifyBeat(const BeatClassification& classification);
+		// Drops the rate to zero once no beat has been seen for the asystole
+		// timeout and ages out old PVCs. Returns true if the snapshot
+		// changed.
+		bool Update(int64_t now);
+
+		const HeartRateSnapshot& GetSnapshot() const { return m_Snapshot; }
+
+	private:
+		void UpdateRate();
+		bool UpdatePvcRate(int64_t now);
+
+	private:
+		size_t m_Window;
+		int64_t m_AsystoleTimeout;
+
+		int64_t m_Intervals[MAX_WINDOW];
+		size_t m_IntervalCount;
+		size_t m_IntervalPosition;
+		int64_t m_IntervalSum;
+
+		int64_t m_PvcTimestamps[HEART_RATE_MAX_BEATS];
+		size_t m_PvcCount;
+		size_t m_PvcPosition;
+
+		bool m_HaveBeat;
+		HeartRateSnapshot m_Snapshot;
+	};
+}
+
+#endif
+
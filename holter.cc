@@ -0,0 +1,321 @@
+#include "holter.hh"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "util.h"
+#include "dataProcessing.hh"
+#include "qrsDetector.hh"
+#include "runningMedian.hh"
+#include "signalQuality.hh"
+#include "alarms.hh"
+
+namespace cee {
+	// The annotation header is written as laid out in memory.
+	static_assert(__BYTE_ORDER == __LITTLE_ENDIAN, "Beat annotations are little endian.");
+
+	constexpr char ANNOTATION_MAGIC[4] = { 'C', 'E', 'E', 'B' };
+	constexpr uint32_t ANNOTATION_VERSION = 1;
+
+	struct AnnotationHeader {
+		char magic[4];
+		uint32_t version;
+		float sampleRate;
+		uint32_t reserved;
+		uint64_t frameCount;
+		uint64_t beatCount;
+	};
+	static_assert(sizeof(AnnotationHeader) == 32);
+
+	// Matches the detector's refractory period: two beats closer than this
+	// from neighbouring chunks are the same QRS.
+	constexpr float DUPLICATE_SECONDS = 0.2f;
+	// Chunks report beats this far outside their own range, so both sides
+	// of a boundary see a QRS that straddles it.
+	constexpr float BOUNDARY_SECONDS = 0.5f;
+
+	MappedRecording::MappedRecording()
+	 : m_Frames(nullptr), m_MappedSize(0), m_FrameCount(0)
+	{
+	}
+
+	MappedRecording::~MappedRecording() {
+		Close();
+	}
+
+	bool MappedRecording::Open(const std::string& filename) {
+		Close();
+
+		int fd = open(filename.c_str(), O_RDONLY);
+		if (fd < 0) {
+			printf("Failed to open recording \"%s\": %s.\n", filename.c_str(), strerror(errno));
+			return false;
+		}
+
+		struct stat info;
+		if (fstat(fd, &info) != 0 || info.st_size < static_cast<off_t>(FRAME_SIZE)) {
+			printf("Recording \"%s\" is empty or unreadable.\n", filename.c_str());
+			close(fd);
+			return false;
+		}
+
+		size_t size = static_cast<size_t>(info.st_size);
+		void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd);
+		if (mapping == MAP_FAILED) {
+			printf("Failed to map recording \"%s\": %s.\n", filename.c_str(), strerror(errno));
+			return false;
+		}
+		// Every chunk is read front to back exactly once.
+		madvise(mapping, size, MADV_SEQUENTIAL);
+
+		m_Frames = static_cast<const uint8_t*>(mapping);
+		m_MappedSize = size;
+		m_FrameCount = size / FRAME_SIZE;
+		return true;
+	}
+
+	void MappedRecording::Close() {
+		if (m_Frames)
+			munmap(const_cast<uint8_t*>(m_Frames), m_MappedSize);
+		m_Frames = nullptr;
+		m_MappedSize = 0;
+		m_FrameCount = 0;
+	}
+
+	namespace {
+		struct ChunkBeat {
+			uint64_t sample;
+			uint32_t chunk;
+			bool searchback;
+		};
+
+		struct ChunkResult {
+			std::vector<ChunkBeat> beats;
+			uint64_t unusableFrames;
+		};
+
+		// One chunk through the same per-lead chain as the bedside monitor,
+		// with frame indices standing in for sequence numbers and times.
+		// Like the bedside monitor, a frame is usable only if every measured
+		// lead is connected and clean, not just the analysed one.
+		void AnalyseChunk(const MappedRecording& recording, const HolterOptions& options, uint32_t chunk,
+				uint64_t begin, uint64_t end, uint64_t keepBegin, uint64_t keepEnd,
+				uint64_t ownBegin, uint64_t ownEnd, ChunkResult& result) {
+			const uint8_t* frames = recording.GetFrames();
+			std::array<BaselineFilter<EcgFixed>, ECG_RESP> baselines{ BaselineFilter<EcgFixed>(options.sampleRate),
+					BaselineFilter<EcgFixed>(options.sampleRate), BaselineFilter<EcgFixed>(options.sampleRate) };
+			std::array<SignalQualityMonitor, ECG_RESP> qualities{ SignalQualityMonitor(options.sampleRate),
+					SignalQualityMonitor(options.sampleRate), SignalQualityMonitor(options.sampleRate) };
+			DoubleDifferenceSquaredFilter<int32_t> qrsFilter;
+			QrsDetector detector(options.sampleRate);
+			const uint64_t delay = baselines[0].GetDelay();
+			const uint64_t firstFrame = begin + delay;
+			bool analysing = true;
+
+			result.beats.clear();
+			result.unusableFrames = 0;
+			for (uint64_t i = begin; i < end; i++) {
+				EcgFixed leads[ECG_RESP];
+				for (uint32_t channel = 0; channel < ECG_RESP; channel++)
+					leads[channel] = baselines[channel].Process(AdcCodeToFixed(frames[i * MappedRecording::FRAME_SIZE + channel]));
+				if (i < firstFrame)
+					continue;
+
+				// The baseline filters' output is for this frame; its raw
+				// samples are still in the mapping.
+				const uint64_t frame = i - delay;
+				bool usable = true;
+				for (uint32_t channel = 0; channel < ECG_RESP; channel++) {
+					EcgFixed raw = AdcCodeToFixed(frames[frame * MappedRecording::FRAME_SIZE + channel]);
+					const SignalQuality& quality = qualities[channel].Process(raw, leads[channel]);
+					usable &= !quality.leadOff && quality.score >= MIN_ANALYSIS_QUALITY;
+				}
+				int32_t filtered = qrsFilter.Process(leads[options.lead]);
+				if (!usable && frame >= ownBegin && frame < ownEnd)
+					result.unusableFrames++;
+				if (frame < begin + qrsFilter.DELAY)
+					continue;
+				const uint64_t filteredFrame = frame - qrsFilter.DELAY;
+
+				if (!usable) {
+					analysing = false;
+					continue;
+				}
+				if (!analysing) {
+					detector.Reset();
+					analysing = true;
+				}
+
+				BeatEvent beat;
+				if (detector.Process(filtered, filteredFrame, static_cast<int64_t>(filteredFrame), beat)
+						&& beat.sequence >= keepBegin && beat.sequence < keepEnd) {
+					result.beats.push_back(ChunkBeat{ beat.sequence, chunk, beat.searchback });
+				}
+			}
+		}
+	}
+
+	std::vector<HolterBeat> AnalyseRecording(const MappedRecording& recording, const HolterOptions& options,
+			WorkStealingPool& pool, HolterStats* stats) {
+		const uint64_t frames = recording.GetFrameCount();
+		const uint64_t chunkFrames = std::max<uint64_t>(1, static_cast<uint64_t>(options.chunkSeconds * options.sampleRate));
+		const uint64_t overlapFrames = static_cast<uint64_t>(options.overlapSeconds * options.sampleRate);
+		const uint64_t boundaryFrames = static_cast<uint64_t>(BOUNDARY_SECONDS * options.sampleRate);
+		const uint64_t duplicateFrames = static_cast<uint64_t>(DUPLICATE_SECONDS * options.sampleRate);
+		const size_t chunks = static_cast<size_t>((frames + chunkFrames - 1) / chunkFrames);
+
+		std::vector<ChunkResult> results(chunks);
+		pool.ParallelFor(chunks, options.grain, [&](size_t first, size_t last) {
+			for (size_t chunk = first; chunk < last; chunk++) {
+				uint64_t ownBegin = chunk * chunkFrames;
+				uint64_t ownEnd = std::min(frames, ownBegin + chunkFrames);
+				AnalyseChunk(recording, options, static_cast<uint32_t>(chunk),
+						ownBegin - std::min(ownBegin, overlapFrames), std::min(frames, ownEnd + overlapFrames),
+						ownBegin - std::min(ownBegin, boundaryFrames), ownEnd + boundaryFrames,
+						ownBegin, ownEnd, results[chunk]);
+			}
+		});
+
+		// Only neighbouring chunks' beats interleave, near their boundary.
+		std::vector<ChunkBeat> merged;
+		uint64_t unusableFrames = 0;
+		for (const ChunkResult& result : results) {
+			merged.insert(merged.end(), result.beats.begin(), result.beats.end());
+			unusableFrames += result.unusableFrames;
+		}
+		std::sort(merged.begin(), merged.end(), [](const ChunkBeat& a, const ChunkBeat& b) {
+			return a.sample < b.sample || (a.sample == b.sample && a.chunk < b.chunk);
+		});
+
+		// A QRS seen from both sides of a boundary keeps the copy from the
+		// chunk that owns its sample; one seen by a single chunk is kept only
+		// if that chunk owns it, as its neighbour had the better view.
+		auto owned = [chunkFrames](const ChunkBeat& beat) { return beat.sample / chunkFrames == beat.chunk; };
+		std::vector<HolterBeat> beats;
+		beats.reserve(merged.size());
+		uint64_t duplicates = 0;
+		for (size_t i = 0; i < merged.size(); i++) {
+			const ChunkBeat& beat = merged[i];
+			if (i + 1 < merged.size() && merged[i + 1].chunk != beat.chunk && merged[i + 1].sample - beat.sample < duplicateFrames) {
+				const ChunkBeat& other = merged[i + 1];
+				const ChunkBeat& kept = owned(beat) || !owned(other) ? beat : other;
+				beats.push_back(HolterBeat{ kept.sample, kept.searchback });
+				duplicates++;
+				i++;
+			} else if (owned(beat)) {
+				beats.push_back(HolterBeat{ beat.sample, beat.searchback });
+			}
+		}
+
+		if (stats) {
+			stats->frames = frames;
+			stats->chunks = chunks;
+			stats->duplicates = duplicates;
+			stats->unusableFrames = unusableFrames;
+		}
+		return beats;
+	}
+
+	bool WriteBeatAnnotations(const std::string& filename, const std::vector<HolterBeat>& beats, float sampleRate, uint64_t frameCount) {
+		AnnotationHeader header;
+		memcpy(header.magic, ANNOTATION_MAGIC, sizeof(header.magic));
+		header.version = ANNOTATION_VERSION;
+		header.sampleRate = sampleRate;
+		header.reserved = 0;
+		header.frameCount = frameCount;
+		header.beatCount = beats.size();
+
+		std::vector<uint8_t> data;
+		data.reserve(beats.size() * 3);
+		uint64_t previous = 0;
+		for (const HolterBeat& beat : beats) {
+			uint64_t value = ((beat.sample - previous) << 1) | (beat.searchback ? 1 : 0);
+			previous = beat.sample;
+			do {
+				uint8_t byte = value & 0x7f;
+				value >>= 7;
+				data.push_back(byte | (value ? 0x80 : 0));
+			} while (value);
+		}
+
+		FILE* file = fopen(filename.c_str(), "wb");
+		if (!file) {
+			printf("Failed to create \"%s\": %s.\n", filename.c_str(), strerror(errno));
+			return false;
+		}
+		bool written = fwrite(&header, sizeof(header), 1, file) == 1
+				&& fwrite(data.data(), 1, data.size(), file) == data.size();
+		written &= fclose(file) == 0;
+		if (!written)
+			printf("Failed to write \"%s\".\n", filename.c_str());
+		return written;
+	}
+
+	bool ReadBeatAnnotations(const std::string& filename, std::vector<HolterBeat>& beats, float* sampleRate, uint64_t* frameCount) {
+		FILE* file = fopen(filename.c_str(), "rb");
+		if (!file) {
+			printf("Failed to open \"%s\": %s.\n", filename.c_str(), strerror(errno));
+			return false;
+		}
+
+		AnnotationHeader header;
+		if (fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, ANNOTATION_MAGIC, sizeof(header.magic)) != 0
+				|| header.version != ANNOTATION_VERSION) {
+			printf("\"%s\" is not a beat annotation file.\n", filename.c_str());
+			fclose(file);
+			return false;
+		}
+
+		// Every beat takes at least a byte, so a count the file cannot hold
+		// is corrupt rather than something to allocate for.
+		struct stat fileStat;
+		if (fstat(fileno(file), &fileStat) != 0 || header.beatCount > static_cast<uint64_t>(fileStat.st_size) - sizeof(header)) {
+			printf("\"%s\" is truncated or has a corrupt beat count.\n", filename.c_str());
+			fclose(file);
+			return false;
+		}
+
+		beats.clear();
+		beats.reserve(header.beatCount);
+		uint64_t previous = 0;
+		for (uint64_t n = 0; n < header.beatCount; n++) {
+			uint64_t value = 0;
+			int byte = EOF;
+			bool complete = false;
+			for (uint32_t shift = 0; shift < 64 && !complete; shift += 7) {
+				if ((byte = fgetc(file)) == EOF)
+					break;
+				value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+				complete = !(byte & 0x80);
+			}
+			if (byte == EOF) {
+				printf("\"%s\" is truncated after %llu beats.\n", filename.c_str(), static_cast<unsigned long long>(n));
+				fclose(file);
+				return false;
+			}
+			if (!complete) {
+				printf("\"%s\" has an overlong interval at beat %llu.\n", filename.c_str(), static_cast<unsigned long long>(n));
+				fclose(file);
+				return false;
+			}
+			previous += value >> 1;
+			beats.push_back(HolterBeat{ previous, (value & 1) != 0 });
+		}
+		fclose(file);
+
+		if (sampleRate)
+			*sampleRate = header.sampleRate;
+		if (frameCount)
+			*frameCount = header.frameCount;
+		return true;
+	}
+}
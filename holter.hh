@@ -0,0 +1,84 @@
+#ifndef CEE_HOLTER_H_
+#define CEE_HOLTER_H_
+
+#include <string>
+#include <vector>
+
+#include <cstdint>
+#include <cstddef>
+
+#include "ecgSample.hh"
+#include "workStealingPool.hh"
+
+namespace cee {
+	// A recording in the replay format (interleaved 4-byte frames of ADC
+	// codes, cee::EcgChannel order) mapped read-only, so a day-long file is
+	// paged in by the workers reading it rather than loaded up front.
+	class MappedRecording {
+	public:
+		static constexpr size_t FRAME_SIZE = ECG_CHANNEL_COUNT;
+
+	public:
+		MappedRecording();
+		~MappedRecording();
+
+		MappedRecording(const MappedRecording&) = delete;
+		MappedRecording& operator=(const MappedRecording&) = delete;
+
+		bool Open(const std::string& filename);
+		void Close();
+
+		bool IsOpen() const { return m_Frames != nullptr; }
+		const uint8_t* GetFrames() const { return m_Frames; }
+		uint64_t GetFrameCount() const { return m_FrameCount; }
+
+	private:
+		const uint8_t* m_Frames;
+		size_t m_MappedSize;
+		uint64_t m_FrameCount;
+	};
+
+	struct HolterBeat {
+		uint64_t sample;      // frame index of the R peak
+		bool searchback;
+	};
+
+	struct HolterOptions {
+		float sampleRate = 500.f;
+		EcgChannel lead = ECG_LEAD_II;
+		float chunkSeconds = 300.f;
+		// Each chunk also runs this far into its neighbours: before, so the
+		// filters and detector have settled by the chunk's own first
+		// sample; after, so beats near its end are confirmed.
+		float overlapSeconds = 10.f;
+		size_t grain = 1;             // chunks per task
+	};
+
+	struct HolterStats {
+		uint64_t frames;
+		uint64_t chunks;
+		uint64_t duplicates;    // beats seen by both chunks at a boundary
+		uint64_t unusableFrames; // lead off or too noisy to analyse
+	};
+
+	// Runs the bedside monitor's lead chain (baseline removal, signal
+	// quality gating on every measured lead, QRS filter and detector on
+	// `lead`) over the whole recording,
+	// one chunk per task on `pool`, and stitches the chunks' beats into one
+	// ordered list. Beats a chunk finds within the refractory period of a
+	// boundary are kept from both sides and then matched, keeping the copy
+	// from the chunk that owns the sample.
+	std::vector<HolterBeat> AnalyseRecording(const MappedRecording& recording, const HolterOptions& options,
+			WorkStealingPool& pool, HolterStats* stats = nullptr);
+
+	// Beat annotation file: a 32-byte header (magic "CEEB", version, sample
+	// rate, frame and beat counts, all little endian) followed by one
+	// LEB128 varint per beat holding (samples since previous beat) << 1 |
+	// searchback. A day of sinus rhythm is about 2 bytes a beat. Reading
+	// rejects a beat count the file is too short to hold and varints
+	// longer than ten bytes.
+	bool WriteBeatAnnotations(const std::string& filename, const std::vector<HolterBeat>& beats, float sampleRate, uint64_t frameCount);
+	bool ReadBeatAnnotations(const std::string& filename, std::vector<HolterBeat>& beats, float* sampleRate = nullptr, uint64_t* frameCount = nullptr);
+}
+
+#endif
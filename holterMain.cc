@@ -0,0 +1,153 @@
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+#include "util.h"
+#include "dspKernels.hh"
+#include "holter.hh"
+#include "sampleSource.hh"
+#include "workStealingPool.hh"
+
+#define GENERATE_BLOCK_FRAMES    65536
+
+static float g_SampleRate = 500.f;
+static size_t g_Threads = 0;
+static std::string g_Output;
+static cee::HolterOptions g_Options;
+static float g_GenerateHours = 0.f;
+static std::string g_GenerateRhythm = "sinus";
+
+static int64_t GetMonotonicNs() {
+	timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return static_cast<int64_t>(now.tv_sec) * NSEC_PER_SEC + now.tv_nsec;
+}
+
+// Writes a synthetic recording in the replay format, for trying the
+// analysis without a real Holter file.
+static int Generate(const std::string& filename) {
+	FILE* file = fopen(filename.c_str(), "wb");
+	if (!file) {
+		printf("Failed to create \"%s\": %s.\n", filename.c_str(), strerror(errno));
+		return EXIT_FAILURE;
+	}
+
+	std::unique_ptr<cee::SampleSource> source = cee::CreateSampleSource("synthetic:" + g_GenerateRhythm, g_SampleRate);
+	const uint64_t frames = static_cast<uint64_t>(g_GenerateHours * 3600.f * g_SampleRate);
+	const int64_t period = static_cast<int64_t>(NSEC_PER_SEC / g_SampleRate);
+	std::vector<uint8_t> block(GENERATE_BLOCK_FRAMES * cee::MappedRecording::FRAME_SIZE);
+	for (uint64_t frame = 0; frame < frames; ) {
+		size_t count = static_cast<size_t>(std::min<uint64_t>(GENERATE_BLOCK_FRAMES, frames - frame));
+		for (size_t n = 0; n < count; n++, frame++) {
+			source->Acquire(static_cast<int64_t>(frame) * period, std::span<uint8_t, 4>(&block[n * cee::MappedRecording::FRAME_SIZE], 4));
+		}
+		if (fwrite(block.data(), cee::MappedRecording::FRAME_SIZE, count, file) != count) {
+			printf("Failed to write \"%s\".\n", filename.c_str());
+			fclose(file);
+			return EXIT_FAILURE;
+		}
+	}
+	fclose(file);
+	printf("Wrote %.1f h of %s rhythm at %.0f Hz to \"%s\".\n", g_GenerateHours, g_GenerateRhythm.c_str(), g_SampleRate, filename.c_str());
+	return EXIT_SUCCESS;
+}
+
+static int Analyse(const std::string& filename) {
+	cee::MappedRecording recording;
+	if (!recording.Open(filename)) {
+		return EXIT_FAILURE;
+	}
+
+	cee::WorkStealingPool pool(g_Threads);
+	g_Options.sampleRate = g_SampleRate;
+	cee::HolterStats stats;
+	int64_t start = GetMonotonicNs();
+	std::vector<cee::HolterBeat> beats = cee::AnalyseRecording(recording, g_Options, pool, &stats);
+	double elapsed = (GetMonotonicNs() - start) / 1e9;
+
+	double hours = stats.frames / g_SampleRate / 3600.0;
+	size_t searchback = std::count_if(beats.begin(), beats.end(), [](const cee::HolterBeat& beat) { return beat.searchback; });
+	double meanRate = beats.size() > 1 ? 60.0 * (beats.size() - 1) / ((beats.back().sample - beats.front().sample) / g_SampleRate) : 0.0;
+	printf("%.2f h at %.0f Hz in %llu chunks on %zu threads (%s): %.2f s, %.0fx real time.\n", hours, g_SampleRate,
+			static_cast<unsigned long long>(stats.chunks), pool.GetThreadCount(), cee::GetSimdLevelName(cee::GetSimdLevel()),
+			elapsed, hours * 3600.0 / elapsed);
+	printf("%zu beats, mean %.0f bpm, %zu by searchback, %llu merged at chunk boundaries, %.2f%% of the recording unusable.\n",
+			beats.size(), meanRate, searchback, static_cast<unsigned long long>(stats.duplicates),
+			100.0 * stats.unusableFrames / std::max<uint64_t>(1, stats.frames));
+
+	if (!g_Output.empty()) {
+		if (!cee::WriteBeatAnnotations(g_Output, beats, g_SampleRate, stats.frames)) {
+			return EXIT_FAILURE;
+		}
+		printf("Annotations written to \"%s\".\n", g_Output.c_str());
+	}
+	return EXIT_SUCCESS;
+}
+
+// Summarises an annotation file written by --output.
+static int Read(const std::string& filename) {
+	std::vector<cee::HolterBeat> beats;
+	float sampleRate;
+	uint64_t frames;
+	if (!cee::ReadBeatAnnotations(filename, beats, &sampleRate, &frames)) {
+		return EXIT_FAILURE;
+	}
+
+	double hours = frames / sampleRate / 3600.0;
+	size_t searchback = std::count_if(beats.begin(), beats.end(), [](const cee::HolterBeat& beat) { return beat.searchback; });
+	double meanRate = beats.size() > 1 ? 60.0 * (beats.size() - 1) / ((beats.back().sample - beats.front().sample) / sampleRate) : 0.0;
+	printf("%.2f h at %.0f Hz: %zu beats, mean %.0f bpm, %zu by searchback.\n", hours, sampleRate, beats.size(), meanRate, searchback);
+	return EXIT_SUCCESS;
+}
+
+int main(int argc, char** arg) {
+	std::string recording;
+	std::string annotations;
+	for (int i = 1; i < argc; i++) {
+		if (strncmp(arg[i], "--rate=", 7) == 0) {
+			g_SampleRate = std::max(50.f, strtof(arg[i] + 7, nullptr));
+		} else if (strncmp(arg[i], "--threads=", 10) == 0) {
+			g_Threads = std::max(0l, strtol(arg[i] + 10, nullptr, 10));
+		} else if (strncmp(arg[i], "--output=", 9) == 0) {
+			g_Output = arg[i] + 9;
+		} else if (strncmp(arg[i], "--chunk=", 8) == 0) {
+			g_Options.chunkSeconds = std::max(1.f, strtof(arg[i] + 8, nullptr));
+		} else if (strncmp(arg[i], "--overlap=", 10) == 0) {
+			g_Options.overlapSeconds = std::max(0.f, strtof(arg[i] + 10, nullptr));
+		} else if (strncmp(arg[i], "--lead=", 7) == 0) {
+			// Only the measured leads are in the file.
+			if (strcasecmp(arg[i] + 7, "I") == 0) {
+				g_Options.lead = cee::ECG_LEAD_I;
+			} else if (strcasecmp(arg[i] + 7, "II") == 0) {
+				g_Options.lead = cee::ECG_LEAD_II;
+			} else if (strcasecmp(arg[i] + 7, "III") == 0) {
+				g_Options.lead = cee::ECG_LEAD_III;
+			}
+		} else if (strncmp(arg[i], "--generate=", 11) == 0) {
+			g_GenerateHours = std::max(0.f, strtof(arg[i] + 11, nullptr));
+		} else if (strncmp(arg[i], "--rhythm=", 9) == 0) {
+			g_GenerateRhythm = arg[i] + 9;
+		} else if (strncmp(arg[i], "--read=", 7) == 0) {
+			annotations = arg[i] + 7;
+		} else if (arg[i][0] != '-') {
+			recording = arg[i];
+		}
+	}
+
+	if (!annotations.empty()) {
+		return Read(annotations);
+	}
+	if (recording.empty()) {
+		printf("Usage: %s [--rate=Hz] [--threads=N] [--output=file] [--chunk=s] [--overlap=s] [--lead=I|II|III] recording\n"
+				"       %s --generate=hours [--rhythm=sinus|tachy|brady|pvc|asystole] [--rate=Hz] recording\n"
+				"       %s --read=annotations\n", arg[0], arg[0], arg[0]);
+		return EXIT_FAILURE;
+	}
+	return g_GenerateHours > 0.f ? Generate(recording) : Analyse(recording);
+}
@@ -0,0 +1,195 @@
+#include "hrv.hh"
+
+#include <cmath>
+#include <cstdlib>
+
+namespace cee {
+	constexpr int64_t HRV_MIN_RR_US = 300000;
+	constexpr int64_t HRV_MAX_RR_US = 2000000;
+	constexpr int64_t HRV_NN50_US = 50000;
+
+	constexpr double HRV_LF_LOW = 0.04;
+	constexpr double HRV_LF_HIGH = 0.15;
+	constexpr double HRV_HF_HIGH = 0.40;
+	constexpr double HRV_FREQUENCY_STEP = 0.001;
+	// A spectrum needs at least a minute or so of beats to resolve LF.
+	constexpr size_t HRV_MIN_SPECTRUM_INTERVALS = 64;
+
+	HrvAnalyzer::HrvAnalyzer(size_t window)
+	 : m_Intervals(window > 1 ? window : 2)
+	{
+		m_Phases.reserve(m_Intervals.size());
+		Reset();
+	}
+
+	void HrvAnalyzer::Reset() {
+		m_Count = 0;
+		m_Oldest = 0;
+		m_LastBeat = 0;
+		m_HaveBeat = false;
+		m_ChainValid = false;
+		m_LastRr = 0;
+		m_RrSum = 0;
+		m_RrSquareSum = 0;
+		m_DifferenceSquareSum = 0;
+		m_DifferenceCount = 0;
+		m_Nn50Count = 0;
+		m_LfPower = 0.f;
+		m_HfPower = 0.f;
+	}
+
+	void HrvAnalyzer::Interrupt() {
+		m_HaveBeat = false;
+		m_ChainValid = false;
+	}
+
+	void HrvAnalyzer::AddBeat(int64_t timestamp) {
+		int64_t rr = (timestamp - m_LastBeat) / 1000;
+		bool haveBeat = m_HaveBeat;
+		m_LastBeat = timestamp;
+		m_HaveBeat = true;
+		if (!haveBeat)
+			return;
+
+		if (rr < HRV_MIN_RR_US || rr > HRV_MAX_RR_US) {
+			m_ChainValid = false;
+			return;
+		}
+
+		if (m_Count == m_Intervals.size())
+			RemoveOldest();
+
+		Interval& interval = m_Intervals[(m_Oldest + m_Count) % m_Intervals.size()];
+		interval.timestamp = timestamp;
+		interval.rr = rr;
+		interval.hasDifference = m_ChainValid;
+		interval.difference = m_ChainValid ? rr - m_LastRr : 0;
+		m_Count++;
+
+		m_RrSum += rr;
+		m_RrSquareSum += rr * rr;
+		if (interval.hasDifference) {
+			m_DifferenceSquareSum += interval.difference * interval.difference;
+			m_DifferenceCount++;
+			if (std::abs(interval.difference) > HRV_NN50_US)
+				m_Nn50Count++;
+		}
+
+		m_LastRr = rr;
+		m_ChainValid = true;
+	}
+
+	void HrvAnalyzer::RemoveOldest() {
+		const Interval& interval = m_Intervals[m_Oldest];
+		m_RrSum -= interval.rr;
+		m_RrSquareSum -= interval.rr * interval.rr;
+		if (interval.hasDifference) {
+			m_DifferenceSquareSum -= interval.difference * interval.difference;
+			m_DifferenceCount--;
+			if (std::abs(interval.difference) > HRV_NN50_US)
+				m_Nn50Count--;
+		}
+		m_Oldest = (m_Oldest + 1) % m_Intervals.size();
+		m_Count--;
+
+		// The new oldest interval's difference refers to one that has left
+		// the window.
+		if (m_Count > 0) {
+			Interval& next = m_Intervals[m_Oldest];
+			if (next.hasDifference) {
+				m_DifferenceSquareSum -= next.difference * next.difference;
+				m_DifferenceCount--;
+				if (std::abs(next.difference) > HRV_NN50_US)
+					m_Nn50Count--;
+				next.hasDifference = false;
+			}
+		}
+	}
+
+	void HrvAnalyzer::UpdateSpectrum() {
+		if (m_Count < HRV_MIN_SPECTRUM_INTERVALS) {
+			m_LfPower = 0.f;
+			m_HfPower = 0.f;
+			return;
+		}
+
+		double mean = static_cast<double>(m_RrSum) / m_Count;
+		int64_t start = m_Intervals[m_Oldest].timestamp;
+		double duration = (m_Intervals[(m_Oldest + m_Count - 1) % m_Intervals.size()].timestamp - start) * 1e-9;
+		const double omegaStep = 2.0 * M_PI * HRV_FREQUENCY_STEP;
+
+		// Per interval the phase w*t is advanced from one frequency to the
+		// next by a rotation, so the scan needs no trig in the inner loop.
+		m_Phases.clear();
+		for (size_t n = 0; n < m_Count; n++) {
+			const Interval& interval = m_Intervals[(m_Oldest + n) % m_Intervals.size()];
+			double t = (interval.timestamp - start) * 1e-9;
+			Phase phase;
+			phase.value = (interval.rr - mean) * 1e-3;
+			phase.cos = std::cos(2.0 * M_PI * HRV_LF_LOW * t);
+			phase.sin = std::sin(2.0 * M_PI * HRV_LF_LOW * t);
+			phase.stepCos = std::cos(omegaStep * t);
+			phase.stepSin = std::sin(omegaStep * t);
+			m_Phases.push_back(phase);
+		}
+
+		// Lomb-Scargle periodogram, scaled to a density (2T/N) so that
+		// integrating it over a band gives the band power in ms^2. The
+		// time offset tau is folded in with the angle addition identities
+		// so each frequency is a single pass.
+		double lf = 0.0, hf = 0.0;
+		const double scale = 2.0 * duration / m_Count * HRV_FREQUENCY_STEP;
+		for (double frequency = HRV_LF_LOW; frequency < HRV_HF_HIGH; frequency += HRV_FREQUENCY_STEP) {
+			double yc = 0.0, ys = 0.0, cc = 0.0, ss = 0.0, cs = 0.0;
+			for (Phase& phase : m_Phases) {
+				double c = phase.cos, s = phase.sin;
+				yc += phase.value * c;
+				ys += phase.value * s;
+				cc += c * c;
+				ss += s * s;
+				cs += c * s;
+
+				phase.cos = c * phase.stepCos - s * phase.stepSin;
+				phase.sin = s * phase.stepCos + c * phase.stepSin;
+			}
+
+			double omegaTau = 0.5 * std::atan2(2.0 * cs, cc - ss);
+			double cosTau = std::cos(omegaTau), sinTau = std::sin(omegaTau);
+			double yC = cosTau * yc + sinTau * ys;
+			double yS = cosTau * ys - sinTau * yc;
+			double CC = cosTau * cosTau * cc + 2.0 * cosTau * sinTau * cs + sinTau * sinTau * ss;
+			double SS = sinTau * sinTau * cc - 2.0 * cosTau * sinTau * cs + cosTau * cosTau * ss;
+			double power = 0.5 * ((CC > 0.0 ? yC * yC / CC : 0.0) + (SS > 0.0 ? yS * yS / SS : 0.0));
+			power *= scale;
+
+			if (frequency < HRV_LF_HIGH) {
+				lf += power;
+			} else {
+				hf += power;
+			}
+		}
+
+		m_LfPower = static_cast<float>(lf);
+		m_HfPower = static_cast<float>(hf);
+	}
+
+	HrvMetrics HrvAnalyzer::GetMetrics() const {
+		HrvMetrics metrics = {};
+		metrics.intervals = static_cast<uint32_t>(m_Count);
+		if (m_Count > 0) {
+			double mean = static_cast<double>(m_RrSum) / m_Count;
+			double variance = static_cast<double>(m_RrSquareSum) / m_Count - mean * mean;
+			metrics.meanRrMs = static_cast<float>(mean / 1000.0);
+			metrics.sdnnMs = static_cast<float>(std::sqrt(variance > 0.0 ? variance : 0.0) / 1000.0);
+		}
+		if (m_DifferenceCount > 0) {
+			metrics.rmssdMs = static_cast<float>(std::sqrt(static_cast<double>(m_DifferenceSquareSum) / m_DifferenceCount) / 1000.0);
+			metrics.pnn50 = 100.f * m_Nn50Count / m_DifferenceCount;
+		}
+		metrics.lfPower = m_LfPower;
+		metrics.hfPower = m_HfPower;
+		metrics.lfHfRatio = m_HfPower > 0.f ? m_LfPower / m_HfPower : 0.f;
+		return metrics;
+	}
+}
+
@@ -0,0 +1,85 @@
+#ifndef CEE_HRV_H_
+#define CEE_HRV_H_
+
+#include <vector>
+
+#include <cstdint>
+#include <cstddef>
+
+namespace cee {
+	struct HrvMetrics {
+		uint32_t intervals;   // RR intervals currently in the window
+		float meanRrMs;
+		float sdnnMs;
+		float rmssdMs;
+		float pnn50;          // percent of successive differences over 50 ms
+		float lfPower;        // ms^2, 0.04-0.15 Hz
+		float hfPower;        // ms^2, 0.15-0.4 Hz
+		float lfHfRatio;      // 0 until a spectrum has been computed
+	};
+
+	// Heart rate variability over a rolling window of RR intervals. Time
+	// domain metrics are kept as integer running sums (microseconds) and
+	// update in O(1) per beat; the LF/HF spectrum is a Lomb-Scargle
+	// periodogram of the unevenly sampled window, which is O(window *
+	// frequencies) and meant to be run on a slow cadence with
+	// UpdateSpectrum.
+	// Intervals outside 300-2000 ms are treated as artifacts: they are not
+	// added and break the chain of successive differences. Only normal
+	// beats should be added, so the window holds normal-to-normal (NN)
+	// intervals.
+	class HrvAnalyzer {
+	public:
+		HrvAnalyzer(size_t window = 300);
+		~HrvAnalyzer() = default;
+
+		void Reset();
+
+		void AddBeat(int64_t timestamp);
+		// Called across a gap in analysis (lead off, artifact) or at an
+		// ectopic beat: the next beat starts a new interval chain.
+		void Interrupt();
+		void UpdateSpectrum();
+
+		HrvMetrics GetMetrics() const;
+
+	private:
+		struct Interval {
+			int64_t timestamp;  // end of the interval
+			int64_t rr;         // us
+			int64_t difference; // us, from the previous interval
+			bool hasDifference;
+		};
+
+		void RemoveOldest();
+
+	private:
+		std::vector<Interval> m_Intervals;
+		size_t m_Count;
+		size_t m_Oldest;
+
+		int64_t m_LastBeat;
+		bool m_HaveBeat;
+		bool m_ChainValid;
+		int64_t m_LastRr;
+
+		int64_t m_RrSum;
+		int64_t m_RrSquareSum;
+		int64_t m_DifferenceSquareSum;
+		uint32_t m_DifferenceCount;
+		uint32_t m_Nn50Count;
+
+		float m_LfPower;
+		float m_HfPower;
+
+		struct Phase {
+			double value;
+			double cos, sin;
+			double stepCos, stepSin;
+		};
+		std::vector<Phase> m_Phases;
+	};
+}
+
+#endif
+
@@ -5,11 +5,12 @@
 #include <fcntl.h>
 #include <sys/ioctl.h>
 #include <assert.h>
+#include <linux/i2c.h>
 #include <linux/i2c-dev.h>
 
 namespace cee {
 	I2C::I2C(const std::string& filename)
-	 : m_Fd(0)
+	 : m_Fd(0), m_SelectedAddress(-1)
 	{
 		// Open I2C device
 		m_Fd = open(filename.c_str(), O_RDWR);
@@ -19,15 +20,22 @@ namespace cee {
 		}
 	}
 
+	I2C::I2C(int32_t fd)
+	 : m_Fd(fd), m_SelectedAddress(-1)
+	{
+	}
+
 	I2C::~I2C() {
-		if (m_Fd)
+		if (m_Fd > 0)
 			close(m_Fd);
 	}
 
 	bool I2C::CheckForDevice(uint32_t address) {
+		m_SelectedAddress = -1;
 		if(ioctl(m_Fd, I2C_SLAVE, address) < 0) {
 			return false;
 		}
+		m_SelectedAddress = static_cast<int32_t>(address);
 
 		if (write(m_Fd, NULL, 0) == 0) {
 			return true;
@@ -38,6 +46,7 @@ namespace cee {
 	std::vector<uint32_t> I2C::ScanForDevices() {
 		std::vector<uint32_t> addresses;
 
+		m_SelectedAddress = -1;
 		for (uint32_t i = 0; i < 128; i++) {
 			if (ioctl(m_Fd, I2C_SLAVE, i) < 0) {
 				continue;
@@ -50,18 +59,63 @@ namespace cee {
 		return addresses;
 	}
 
+	bool I2C::SelectDevice(uint32_t address) {
+		if (m_SelectedAddress == static_cast<int32_t>(address))
+			return true;
+
+		if (ioctl(m_Fd, I2C_SLAVE, address) < 0) {
+			m_SelectedAddress = -1;
+			return false;
+		}
+		m_SelectedAddress = static_cast<int32_t>(address);
+		return true;
+	}
+
 	ssize_t I2C::WriteToDevice(uint32_t address, void* data, size_t size) {
-		if (!this->CheckForDevice(address))
+		if (!this->SelectDevice(address))
 			return -1;
 
-		return write(m_Fd, data, size);
+		ssize_t written = write(m_Fd, data, size);
+		if (written < 0 && !this->CheckForDevice(address))
+			return -1;
+
+		return written;
 	}
 
 	ssize_t I2C::ReadFromDevice(uint32_t address, void* data, size_t size) {
-		if (!this->CheckForDevice(address))
+		if (!this->SelectDevice(address))
+			return -1;
+
+		ssize_t bytesRead = read(m_Fd, data, size);
+		if (bytesRead < 0 && !this->CheckForDevice(address))
 			return -1;
 
-		return read(m_Fd, data, size);
+		return bytesRead;
+	}
+
+	ssize_t I2C::WriteReadDevice(uint32_t address, const void* writeData, size_t writeSize, void* readData, size_t readSize) {
+		i2c_msg messages[2];
+		messages[0].addr = static_cast<uint16_t>(address);
+		messages[0].flags = 0;
+		messages[0].len = static_cast<uint16_t>(writeSize);
+		messages[0].buf = reinterpret_cast<uint8_t*>(const_cast<void*>(writeData));
+		messages[1].addr = static_cast<uint16_t>(address);
+		messages[1].flags = I2C_M_RD;
+		messages[1].len = static_cast<uint16_t>(readSize);
+		messages[1].buf = reinterpret_cast<uint8_t*>(readData);
+
+		i2c_rdwr_ioctl_data transfer;
+		transfer.msgs = messages;
+		transfer.nmsgs = 2;
+
+		// I2C_RDWR addresses each message directly, so no I2C_SLAVE
+		// selection is needed. Only probe the device once a transfer fails.
+		if (ioctl(m_Fd, I2C_RDWR, &transfer) < 0) {
+			if (!this->CheckForDevice(address))
+				printf("I2C device 0x%.2X not responding\n", address);
+			return -1;
+		}
+		return static_cast<ssize_t>(readSize);
 	}
 }
 
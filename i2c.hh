@@ -12,14 +12,28 @@ namespace cee {
 		I2C(const std::string& filename = "/dev/i2c-1");
 		virtual ~I2C();
 
-		bool CheckForDevice(uint32_t address);
-		std::vector<uint32_t> ScanForDevices();
+		virtual bool CheckForDevice(uint32_t address);
+		virtual std::vector<uint32_t> ScanForDevices();
 
-		ssize_t WriteToDevice(uint32_t address, void* data, size_t size);
-		ssize_t ReadFromDevice(uint32_t address, void* data, size_t size);
+		virtual ssize_t WriteToDevice(uint32_t address, void* data, size_t size);
+		virtual ssize_t ReadFromDevice(uint32_t address, void* data, size_t size);
+
+		// Writes writeData then reads into readData as one combined
+		// transaction (repeated START, single STOP). Returns the number of
+		// bytes read, or -1 on failure.
+		virtual ssize_t WriteReadDevice(uint32_t address, const void* writeData, size_t writeSize, void* readData, size_t readSize);
+
+	protected:
+		// For buses that are not backed by an i2c-dev device node.
+		explicit I2C(int32_t fd);
+
+	private:
+		bool SelectDevice(uint32_t address);
 
 	private:
 		int32_t m_Fd;
+		// Slave address currently latched with I2C_SLAVE, -1 if unknown.
+		int32_t m_SelectedAddress;
 	};
 }
 
@@ -0,0 +1,90 @@
+#include "leads.hh"
+
+#include <algorithm>
+
+#include <cassert>
+#include <strings.h>
+
+#include "dspKernels.hh"
+
+namespace cee {
+	static const char* s_LeadNames[LEAD_COUNT] = { "I", "II", "III", "aVR", "aVL", "aVF" };
+
+	uint32_t GetMeasuredChannels(MeasuredLeads measured) {
+		switch (measured) {
+		case MeasuredLeads::I_II: return (1u << ECG_LEAD_I) | (1u << ECG_LEAD_II);
+		case MeasuredLeads::I_III: return (1u << ECG_LEAD_I) | (1u << ECG_LEAD_III);
+		case MeasuredLeads::II_III: return (1u << ECG_LEAD_II) | (1u << ECG_LEAD_III);
+		case MeasuredLeads::ALL: break;
+		}
+		return (1u << ECG_LEAD_I) | (1u << ECG_LEAD_II) | (1u << ECG_LEAD_III);
+	}
+
+	const char* GetLeadName(EcgLead lead) {
+		return lead < LEAD_COUNT ? s_LeadNames[lead] : "unknown";
+	}
+
+	EcgLead ParseLeadName(const char* name) {
+		for (uint32_t lead = 0; lead < LEAD_COUNT; lead++) {
+			if (strcasecmp(name, s_LeadNames[lead]) == 0)
+				return static_cast<EcgLead>(lead);
+		}
+		return LEAD_COUNT;
+	}
+
+	LeadBuffer::LeadBuffer(size_t capacity, MeasuredLeads measured)
+	 : m_Capacity(capacity), m_Measured(measured), m_Data(capacity * LEAD_COUNT, 0)
+	{
+		assert((capacity & (capacity - 1)) == 0 && "capacity must be a power of two");
+	}
+
+	void LeadBuffer::Update(const EcgSample* samples, size_t count, uint64_t firstSequence) {
+		if (count > m_Capacity) {
+			samples += count - m_Capacity;
+			firstSequence += count - m_Capacity;
+			count = m_Capacity;
+		}
+
+		EcgFixed* leadI = GetLeadData(LEAD_I);
+		EcgFixed* leadII = GetLeadData(LEAD_II);
+		EcgFixed* leadIII = GetLeadData(LEAD_III);
+		for (size_t n = 0; n < count; n++) {
+			size_t index = GetIndex(firstSequence + n);
+			leadI[index] = samples[n].channels[ECG_LEAD_I];
+			leadII[index] = samples[n].channels[ECG_LEAD_II];
+			leadIII[index] = samples[n].channels[ECG_LEAD_III];
+		}
+
+		// At most two contiguous runs when the update wraps.
+		size_t begin = GetIndex(firstSequence);
+		size_t first = std::min(count, m_Capacity - begin);
+		DeriveRun(begin, first);
+		if (first < count)
+			DeriveRun(0, count - first);
+	}
+
+	void LeadBuffer::DeriveRun(size_t begin, size_t count) {
+		EcgFixed* leadI = GetLeadData(LEAD_I) + begin;
+		EcgFixed* leadII = GetLeadData(LEAD_II) + begin;
+		EcgFixed* leadIII = GetLeadData(LEAD_III) + begin;
+
+		switch (m_Measured) {
+		case MeasuredLeads::I_II:
+			WeightedSum(leadII, 1, leadI, -1, 0, leadIII, count);
+			break;
+		case MeasuredLeads::I_III:
+			WeightedSum(leadI, 1, leadIII, 1, 0, leadII, count);
+			break;
+		case MeasuredLeads::II_III:
+			WeightedSum(leadII, 1, leadIII, -1, 0, leadI, count);
+			break;
+		case MeasuredLeads::ALL:
+			break;
+		}
+
+		WeightedSum(leadI, -1, leadII, -1, 1, GetLeadData(LEAD_AVR) + begin, count);
+		WeightedSum(leadI, 2, leadII, -1, 1, GetLeadData(LEAD_AVL) + begin, count);
+		WeightedSum(leadII, 2, leadI, -1, 1, GetLeadData(LEAD_AVF) + begin, count);
+	}
+}
+
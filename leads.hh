@@ -0,0 +1,77 @@
+#ifndef CEE_LEADS_H_
+#define CEE_LEADS_H_
+
+#include <span>
+#include <vector>
+
+#include <cstdint>
+#include <cstddef>
+
+#include "ecgSample.hh"
+#include "fixedPoint.hh"
+
+namespace cee {
+	enum EcgLead : uint32_t {
+		LEAD_I = 0,
+		LEAD_II,
+		LEAD_III,
+		LEAD_AVR,
+		LEAD_AVL,
+		LEAD_AVF,
+		LEAD_COUNT
+	};
+
+	// Which limb leads the front end measures; the rest are derived.
+	enum class MeasuredLeads {
+		I_II,
+		I_III,
+		II_III,
+		ALL           // I, II and III measured, only the augmented leads derived
+	};
+
+	// Bit mask of the EcgChannels that carry a measured lead.
+	uint32_t GetMeasuredChannels(MeasuredLeads measured);
+
+	const char* GetLeadName(EcgLead lead);
+	// Accepts e.g. "II" or "aVF", case-insensitively. Returns LEAD_COUNT if
+	// the name is unknown.
+	EcgLead ParseLeadName(const char* name);
+
+	// Per-lead history of the last Capacity samples in structure-of-arrays
+	// form. New samples are split out of the ring's EcgSample frames once,
+	// then each derived lead is one vector pass over a contiguous run:
+	//
+	//   III = II - I        aVR = -(I + II) / 2
+	//   aVL = I - II / 2    aVF = II - I / 2
+	//
+	// Lead arrays are indexed by sample sequence (GetIndex) and handed out
+	// as spans, so DSP and display code read them in place.
+	class LeadBuffer {
+	public:
+		LeadBuffer(size_t capacity, MeasuredLeads measured = MeasuredLeads::ALL);
+		~LeadBuffer() = default;
+
+		// `samples` holds consecutive sequences starting at firstSequence,
+		// as returned by SampleRing::ReadNew.
+		void Update(const EcgSample* samples, size_t count, uint64_t firstSequence);
+
+		std::span<const EcgFixed> GetLead(EcgLead lead) const {
+			return std::span<const EcgFixed>(m_Data.data() + lead * m_Capacity, m_Capacity);
+		}
+		size_t GetIndex(uint64_t sequence) const { return sequence & (m_Capacity - 1); }
+		size_t GetCapacity() const { return m_Capacity; }
+		MeasuredLeads GetMeasuredLeads() const { return m_Measured; }
+
+	private:
+		EcgFixed* GetLeadData(EcgLead lead) { return m_Data.data() + lead * m_Capacity; }
+		void DeriveRun(size_t begin, size_t count);
+
+	private:
+		size_t m_Capacity;
+		MeasuredLeads m_Measured;
+		std::vector<EcgFixed> m_Data;
+	};
+}
+
+#endif
+
@@ -1,4 +1,5 @@
 #include <GLES2/gl2.h>
+#include <array>
 #include <atomic>
 #include <chrono>
 #include <cstdlib>
@@ -12,6 +13,7 @@
 #include <cmath>
 #include <cstring>
 #include <fcntl.h>
+#include <strings.h>
 #include <unistd.h>
 
 #include <signal.h>
@@ -25,30 +27,59 @@
 #include "adc.hh"
 #include "util.h"
 #include "dataProcessing.hh"
+#include "ecgSample.hh"
+#include "sampleRing.hh"
+#include "sampler.hh"
+#include "sampleSource.hh"
+#include "decimator.hh"
+#include "notchFilter.hh"
+#include "runningMedian.hh"
+#include "leads.hh"
+#include "signalQuality.hh"
+#include "beatClassifier.hh"
+#include "qrsDetector.hh"
+#include "heartRate.hh"
+#include "hrv.hh"
+#include "alarms.hh"
+#include "respiration.hh"
+#include "morphology.hh"
+#include "waveformRecorder.hh"
+#include "snapshot.hh"
 #include "fontRenderer.h"
 
 #define ECG_DATA_POINTS          1024
 #define ECG_DATA_TIME_MS         15000.f
 #define ECG_DATA_MS_PER_POINT    ECG_DATA_TIME_MS / ECG_DATA_POINTS
 #define SAMPLE_RATE              ECG_DATA_POINTS/(ECG_DATA_TIME_MS/1000)
-
-struct EcgData {
-	float leadI[ECG_DATA_POINTS];
-	float leadII[ECG_DATA_POINTS];
-	float leadIII[ECG_DATA_POINTS];
-	float resp[ECG_DATA_POINTS];
-	bool leadsConnected;
-};
-
-static EcgData g_Data;
-std::mutex g_DataMutex;
-
-int g_Idx;
+#define ECG_RING_SIZE            4096
+#define OVERSAMPLE_FACTOR        8
+#define HRV_SPECTRUM_PERIOD_NS   10000000000l
+// The int32 squared slope is scaled by 1/4; this takes it back to volts^2.
+#define PROCESSED_TRACE_SCALE    (4.f * cee::FixedToVolts(1) * cee::FixedToVolts(1))
+#define HRV_LOG_PERIOD_NS        60000000000l
+#define RECORDER_POLL_MS         250
+
+static cee::SampleRing<cee::EcgSample, ECG_RING_SIZE> g_SampleRing;
+static cee::Snapshot<cee::HeartRateSnapshot> g_HeartRate;
+static cee::Snapshot<cee::HrvMetrics> g_Hrv;
+static cee::Snapshot<cee::RespirationSnapshot> g_Respiration;
+static cee::Snapshot<cee::MorphologySnapshot> g_Morphology;
 
 std::atomic<bool> g_Terminate = false;
+std::atomic<bool> g_DumpSamplerStats = false;
+
+static bool g_RealtimeSampler = false;
+static bool g_Oversample = false;
+static std::string g_SampleSourceSpec = "pcf8591";
+static std::string g_RecordFile;
+static float g_NotchMainsHz = 0.f;
+static uint32_t g_NotchChannels = (1u << cee::ECG_CHANNEL_COUNT) - 1;
+static bool g_RemoveBaseline = true;
+static cee::MeasuredLeads g_MeasuredLeads = cee::MeasuredLeads::ALL;
+static cee::EcgLead g_DisplayLead = cee::LEAD_II;
 
 extern "C" {
-	void signalHandler(int signum) {
+	void signalHandler(int) {
 		static int inAborting = false;
 		if (inAborting)
 			return;
@@ -60,6 +91,10 @@ extern "C" {
 
 		g_Terminate = true;
 	}
+
+	void statsSignalHandler(int) {
+		g_DumpSamplerStats = true;
+	}
 }
 
 enum class AlarmSounds : int8_t {
@@ -135,40 +170,352 @@ void doAlarms() {
 	ceeAudioFreePlayer(player);
 }
 
-void doSensors() {
+void doSensors(cee::SampleSource* source) {
 	using namespace std::chrono_literals;
 
-	std::shared_ptr<cee::I2C> i2cBus = std::make_shared<cee::I2C>();
-	cee::ADC adc = cee::ADC(i2cBus, cee::ADCType::PCF8591, 0x48);
-	
-	timespec startTime, currentTime, diffTime;
-	clock_gettime(CLOCK_MONOTONIC, &startTime);
-	
+	// When oversampling, the ADC runs OVERSAMPLE_FACTOR times faster and
+	// each channel is lowpassed and decimated back to SAMPLE_RATE.
+	const uint32_t oversample = g_Oversample ? OVERSAMPLE_FACTOR : 1;
+	cee::Sampler sampler(std::chrono::duration<float, std::milli>(ECG_DATA_MS_PER_POINT / oversample),
+			g_RealtimeSampler, 80, g_RealtimeSampler);
+	std::array<cee::PolyphaseDecimator<OVERSAMPLE_FACTOR>, cee::ECG_CHANNEL_COUNT> decimators;
+
+	// Mains hum is cancelled at the acquisition rate, before decimation
+	// folds it down into the ECG band.
+	const float acquisitionRate = SAMPLE_RATE * oversample;
+	std::array<cee::AdaptiveNotch<3>, cee::ECG_CHANNEL_COUNT> notches = {
+		cee::AdaptiveNotch<3>(acquisitionRate, g_NotchMainsHz),
+		cee::AdaptiveNotch<3>(acquisitionRate, g_NotchMainsHz),
+		cee::AdaptiveNotch<3>(acquisitionRate, g_NotchMainsHz),
+		cee::AdaptiveNotch<3>(acquisitionRate, g_NotchMainsHz)
+	};
+	uint32_t notchChannels = 0;
+	if (g_NotchMainsHz > 0.f) {
+		if (notches[0].IsActive()) {
+			notchChannels = g_NotchChannels;
+		} else {
+			fprintf(stderr, "\e[33mWarning: %.0f Hz sampling cannot represent %.0f Hz mains, notch disabled (use --oversample).\e[0m\n",
+					acquisitionRate, g_NotchMainsHz);
+		}
+	}
+
+	// Baseline wander is removed from the limb leads only; the respiration
+	// channel's slow swing is its signal. The medians delay the leads, so
+	// the timestamp and respiration are held back to match.
+	std::array<cee::BaselineFilter<cee::EcgFixed>, cee::ECG_RESP> baselines = {
+		cee::BaselineFilter<cee::EcgFixed>(SAMPLE_RATE),
+		cee::BaselineFilter<cee::EcgFixed>(SAMPLE_RATE),
+		cee::BaselineFilter<cee::EcgFixed>(SAMPLE_RATE)
+	};
+	std::vector<cee::EcgSample> baselineHistory(baselines[0].GetDelay() + 1);
+	size_t baselinePosition = 0;
+	uint64_t baselineWarmup = baselines[0].GetDelay();
+
+	// Only the wired leads are judged; an unused input would read as off.
+	const uint32_t measuredChannels = cee::GetMeasuredChannels(g_MeasuredLeads);
+	std::array<cee::SignalQualityMonitor, cee::ECG_RESP> qualities = {
+		cee::SignalQualityMonitor(SAMPLE_RATE),
+		cee::SignalQualityMonitor(SAMPLE_RATE),
+		cee::SignalQualityMonitor(SAMPLE_RATE)
+	};
+
+	uint8_t samples[4] = { 0 };
+	sampler.Run(g_Terminate, [&](int64_t timestampNs) {
+		// One burst per sample period fills every lead instead of four
+		// separate round trips.
+		if (!source->Acquire(timestampNs, samples)) {
+			return;
+		}
+
+		cee::EcgSample sample;
+		sample.timestamp = timestampNs;
+		if (g_Oversample || notchChannels) {
+			// Filtering needs fractional codes, so this path runs in float
+			// and rounds into fixed point once per output sample.
+			float codes[cee::ECG_CHANNEL_COUNT];
+			float input[cee::ECG_CHANNEL_COUNT];
+			for (uint32_t channel = 0; channel < cee::ECG_CHANNEL_COUNT; channel++) {
+				input[channel] = samples[channel];
+				if (notchChannels & (1u << channel)) {
+					input[channel] = notches[channel].Process(input[channel]);
+				}
+			}
+
+			if (g_Oversample) {
+				size_t produced = 0;
+				for (uint32_t channel = 0; channel < cee::ECG_CHANNEL_COUNT; channel++) {
+					produced = decimators[channel].Process(&input[channel], 1, &codes[channel]);
+				}
+				if (produced == 0) {
+					return;
+				}
+			} else {
+				std::copy(input, input + cee::ECG_CHANNEL_COUNT, codes);
+			}
+
+			for (uint32_t channel = 0; channel < cee::ECG_CHANNEL_COUNT; channel++) {
+				sample.channels[channel] = cee::AdcCodeToFixed(codes[channel]);
+			}
+		} else {
+			for (uint32_t channel = 0; channel < cee::ECG_CHANNEL_COUNT; channel++) {
+				sample.channels[channel] = cee::AdcCodeToFixed(samples[channel]);
+			}
+		}
+
+		cee::EcgFixed leads[cee::ECG_RESP];
+		std::copy(sample.channels, sample.channels + cee::ECG_RESP, leads);
+		if (g_RemoveBaseline) {
+			for (uint32_t channel = 0; channel < cee::ECG_RESP; channel++) {
+				leads[channel] = baselines[channel].Process(sample.channels[channel]);
+			}
+			baselineHistory[baselinePosition] = sample;
+			baselinePosition = (baselinePosition + 1) % baselineHistory.size();
+			if (baselineWarmup > 0) {
+				baselineWarmup--;
+				return;
+			}
+			sample = baselineHistory[baselinePosition];
+		}
+
+		// The delayed unfiltered sample still shows an input pinned at a
+		// rail, which baseline removal would hide.
+		sample.leadsConnected = true;
+		sample.quality = 100;
+		for (uint32_t channel = 0; channel < cee::ECG_RESP; channel++) {
+			if (!(measuredChannels & (1u << channel))) {
+				continue;
+			}
+			const cee::SignalQuality& quality = qualities[channel].Process(sample.channels[channel], leads[channel]);
+			sample.leadsConnected &= !quality.leadOff;
+			sample.quality = std::min(sample.quality, quality.score);
+		}
+		std::copy(sample.channels, sample.channels + cee::ECG_CHANNEL_COUNT, sample.raw);
+		std::copy(leads, leads + cee::ECG_RESP, sample.channels);
+		g_SampleRing.Push(sample);
+
+		if (g_DumpSamplerStats.exchange(false)) {
+			sampler.PrintStats(stdout);
+			source->PrintStats(stdout);
+		}
+	});
+
+	sampler.PrintStats(stdout);
+}
+
+void doAnalysis() {
+	// Follows the sample ring with its own cursor so beat detection never
+	// waits on the render loop, and publishes the heart rate on every beat.
+	cee::DoubleDifferenceSquaredFilter<int32_t> qrsFilter;
+	cee::QrsDetector qrsDetector(SAMPLE_RATE);
+	cee::HeartRateMonitor heartRate;
+	cee::HrvAnalyzer hrv;
+	cee::RespirationMonitor respiration(SAMPLE_RATE);
+	cee::BeatClassifier beatClassifier(SAMPLE_RATE);
+	std::array<cee::BeatClassification, cee::BeatClassifier::MAX_PENDING> classifications;
+	cee::MorphologyAnalyzer morphology(SAMPLE_RATE);
+	std::array<cee::BeatMorphology, cee::MorphologyAnalyzer::MAX_PENDING> measurements;
+	int64_t nextSpectrum = 0, nextLog = 0;
+	std::vector<cee::EcgSample> newSamples(ECG_DATA_POINTS);
+	cee::LeadBuffer leads(ECG_DATA_POINTS, g_MeasuredLeads);
+	std::span<const cee::EcgFixed> leadII = leads.GetLead(cee::LEAD_II);
+	std::array<int64_t, cee::DoubleDifferenceSquaredFilter<int32_t>::DELAY + 1> timestamps = { 0 };
+	uint64_t cursor = 0;
+	bool analysing = true;
+	// Beats reach HRV only once classified, after the detector has moved
+	// on, so a gap breaks the interval chain at the first beat after it.
+	uint64_t hrvResumeSequence = 0;
+	bool hrvResume = false;
+
 	while (!g_Terminate) {
-		float sinFreq = (int)((map8BitToFloat(adc.ReadChannel(3)) + 0.3f) * 17.f) / 2.f;
-//		float sinFreq = 7;
-		clock_gettime(CLOCK_MONOTONIC, &currentTime);
-		TimespecSub(&diffTime, &startTime, &currentTime);
-		 float sinVal = (static_cast<float>(diffTime.tv_sec) + (static_cast<float>(diffTime.tv_nsec) / NSEC_PER_SEC));
-		{
-			std::scoped_lock lock(g_DataMutex);
-			g_Data.leadII[g_Idx] = 0.1f * ((2.0f * pow(std::sin(sinVal*sinFreq), 50.f)) + (0.3f * std::pow(std::sin(sinVal*sinFreq - 1.f), 1.f)) + (0.2f * std::pow(std::sin(sinVal*sinFreq + 1.f), 50.f)) - (0.5f * std::pow(std::sin(sinVal*sinFreq - 0.2f), 50.f)) - (0.2f * std::pow(std::sin(sinVal*sinFreq + 0.4f), 50.f)));
-//			g_Data.leadII[g_Idx] = (map8BitToFloat(adc.ReadChannel(3)) * 2 - 1.f) * 0.4;
+		uint64_t firstSequence;
+		size_t newCount = g_SampleRing.ReadSince(cursor, newSamples.data(), newSamples.size(), &firstSequence);
+		leads.Update(newSamples.data(), newCount, firstSequence);
+		bool changed = false;
+		for (size_t n = 0; n < newCount; n++) {
+			uint64_t sequence = firstSequence + n;
+			timestamps[sequence % timestamps.size()] = newSamples[n].timestamp;
+			respiration.AddSample(newSamples[n].timestamp, newSamples[n].channels[cee::ECG_RESP]);
+
+			// Filtered in fixed point; the detector's levels are relative so
+			// it takes the squared slope as is.
+			int32_t filtered = qrsFilter.Process(leadII[leads.GetIndex(sequence)]);
+			if (sequence < qrsFilter.DELAY) {
+				continue;
+			}
+			uint64_t filteredSequence = sequence - qrsFilter.DELAY;
+
+			// Lead-off and artifact segments are skipped rather than letting
+			// them pull the detector's thresholds around. Afterwards the
+			// detector relearns the signal and no RR interval spans the gap.
+			bool usable = newSamples[n].leadsConnected && newSamples[n].quality >= cee::MIN_ANALYSIS_QUALITY;
+			if (!usable) {
+				analysing = false;
+				continue;
+			}
+			if (!analysing) {
+				qrsDetector.Reset();
+				heartRate.Interrupt();
+				hrvResumeSequence = filteredSequence;
+				hrvResume = true;
+				morphology.Interrupt();
+				analysing = true;
+			}
+
+			cee::BeatEvent beat;
+			if (qrsDetector.Process(filtered, filteredSequence, timestamps[filteredSequence % timestamps.size()], beat)) {
+				heartRate.AddBeat(beat);
+				beatClassifier.AddBeat(beat);
+				changed = true;
+			}
+		}
+		if (newCount > 0) {
+			size_t classified = beatClassifier.Process(leadII, firstSequence + newCount, classifications.data(), classifications.size());
+			for (size_t n = 0; n < classified; n++) {
+				heartRate.ClassifyBeat(classifications[n]);
+				if (hrvResume && classifications[n].sequence >= hrvResumeSequence) {
+					hrv.Interrupt();
+					hrvResume = false;
+				}
+				// Only beats matching the template are measured for
+				// respiration; an ectopic beat's amplitude would read as a
+				// breath. HRV takes normal-to-normal intervals only, so an
+				// ectopic or unclassified beat breaks its chain and neither
+				// the short nor the long interval around it is used.
+				if (classifications[n].beatClass == cee::BeatClass::NORMAL) {
+					respiration.AddBeat(classifications[n].timestamp, classifications[n].rAmplitude);
+					hrv.AddBeat(classifications[n].timestamp);
+				} else {
+					hrv.Interrupt();
+				}
+				morphology.AddBeat(classifications[n]);
+			}
+			changed |= classified > 0;
+
+			// Intervals are measured once the T wave is in the buffer, a
+			// few hundred milliseconds after the beat is classified.
+			if (morphology.Process(leads, firstSequence + newCount, measurements.data(), measurements.size()) > 0) {
+				g_Morphology.Publish(morphology.GetSnapshot());
+			}
+		}
+		if (newCount > 0) {
+			changed |= heartRate.Update(newSamples[newCount - 1].timestamp);
+			if (respiration.Update(newSamples[newCount - 1].timestamp)) {
+				g_Respiration.Publish(respiration.GetSnapshot());
+			}
+		}
+		if (changed) {
+			g_HeartRate.Publish(heartRate.GetSnapshot());
+			g_Hrv.Publish(hrv.GetMetrics());
+		}
 
-			g_Data.leadsConnected = true;
+		// The LF/HF spectrum is much more expensive than the per-beat
+		// metrics and changes slowly, so it only runs every few seconds.
+		if (newCount > 0) {
+			int64_t now = newSamples[newCount - 1].timestamp;
+			if (now >= nextSpectrum) {
+				hrv.UpdateSpectrum();
+				g_Hrv.Publish(hrv.GetMetrics());
+				nextSpectrum = now + HRV_SPECTRUM_PERIOD_NS;
+			}
+			if (now >= nextLog) {
+				cee::HrvMetrics metrics = hrv.GetMetrics();
+				if (metrics.intervals > 0) {
+					printf("HRV: %u intervals, mean RR %.0f ms, SDNN %.1f ms, RMSSD %.1f ms, pNN50 %.1f%%, LF %.0f ms^2, HF %.0f ms^2, LF/HF %.2f\n",
+							metrics.intervals, metrics.meanRrMs, metrics.sdnnMs, metrics.rmssdMs, metrics.pnn50,
+							metrics.lfPower, metrics.hfPower, metrics.lfHfRatio);
+				}
+				const cee::MorphologySnapshot& intervals = morphology.GetSnapshot();
+				const cee::LeadMorphology& lead = intervals.leads[g_DisplayLead];
+				if (intervals.beatCount > 0) {
+					printf("Morphology (%s): QRS %.0f ms, QT %.0f ms, QTc %.0f ms, ST %+.2f mV\n",
+							cee::GetLeadName(g_DisplayLead), lead.qrsMs, lead.qtMs, lead.qtcMs, lead.stMv);
+				}
+				nextLog = now + HRV_LOG_PERIOD_NS;
+			}
 		}
 
-		g_Idx++;
-		g_Idx %= ECG_DATA_POINTS;
 		std::this_thread::sleep_for(std::chrono::duration<float, std::milli>(ECG_DATA_MS_PER_POINT));
 	}
 }
 
+void doRecording(cee::WaveformRecorder* recorder) {
+	// Follows the ring with its own cursor and does all of the file I/O, so
+	// a slow card only makes this thread fall behind, never the sampler.
+	// The ring holds about a minute, and anything older is counted as
+	// dropped.
+	std::vector<cee::EcgSample> newSamples(ECG_RING_SIZE);
+	uint64_t cursor = 0;
+	while (!g_Terminate) {
+		uint64_t firstSequence;
+		size_t newCount = g_SampleRing.ReadSince(cursor, newSamples.data(), newSamples.size(), &firstSequence);
+		recorder->AddSamples(newSamples.data(), newCount, firstSequence);
+		std::this_thread::sleep_for(std::chrono::milliseconds(RECORDER_POLL_MS));
+	}
+
+	recorder->Flush();
+	recorder->PrintStats(stdout);
+}
+
 int main(int argc, char** arg) {
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(arg[i], "--realtime") == 0) {
+			g_RealtimeSampler = true;
+		} else if (strcmp(arg[i], "--oversample") == 0) {
+			g_Oversample = true;
+		} else if (strncmp(arg[i], "--source=", 9) == 0) {
+			g_SampleSourceSpec = arg[i] + 9;
+		} else if (strncmp(arg[i], "--record=", 9) == 0) {
+			g_RecordFile = arg[i] + 9;
+		} else if (strcmp(arg[i], "--no-baseline") == 0) {
+			g_RemoveBaseline = false;
+		} else if (strncmp(arg[i], "--leads=", 8) == 0) {
+			// The limb leads wired to the ADC; the third is derived.
+			const char* leads = arg[i] + 8;
+			if (strcasecmp(leads, "I,II") == 0) {
+				g_MeasuredLeads = cee::MeasuredLeads::I_II;
+			} else if (strcasecmp(leads, "I,III") == 0) {
+				g_MeasuredLeads = cee::MeasuredLeads::I_III;
+			} else if (strcasecmp(leads, "II,III") == 0) {
+				g_MeasuredLeads = cee::MeasuredLeads::II_III;
+			}
+		} else if (strncmp(arg[i], "--display-lead=", 15) == 0) {
+			cee::EcgLead lead = cee::ParseLeadName(arg[i] + 15);
+			if (lead != cee::LEAD_COUNT) {
+				g_DisplayLead = lead;
+			}
+		} else if (strncmp(arg[i], "--notch=", 8) == 0) {
+			g_NotchMainsHz = strtof(arg[i] + 8, nullptr);
+		} else if (strncmp(arg[i], "--notch-channels=", 17) == 0) {
+			// Comma separated channel indices, e.g. 0,1,2 to leave resp alone.
+			g_NotchChannels = 0;
+			for (const char* c = arg[i] + 17; *c; c++) {
+				if (*c >= '0' && *c < '0' + static_cast<int>(cee::ECG_CHANNEL_COUNT)) {
+					g_NotchChannels |= 1u << (*c - '0');
+				}
+			}
+		}
+	}
+
+	std::unique_ptr<cee::SampleSource> sampleSource = cee::CreateSampleSource(g_SampleSourceSpec, SAMPLE_RATE * (g_Oversample ? OVERSAMPLE_FACTOR : 1));
+	if (!sampleSource) {
+		return EXIT_FAILURE;
+	}
+	printf("Using sample source \"%s\".\n", sampleSource->GetName());
+
+	std::unique_ptr<cee::WaveformRecorder> recorder;
+	if (!g_RecordFile.empty()) {
+		recorder = std::make_unique<cee::WaveformRecorder>(g_RecordFile, SAMPLE_RATE);
+		if (!recorder->IsOpen()) {
+			return EXIT_FAILURE;
+		}
+		printf("Recording to \"%s\".\n", g_RecordFile.c_str());
+	}
 
 	signal(SIGINT, signalHandler);
 	signal(SIGABRT, signalHandler);
 	signal(SIGTERM, signalHandler);
+	// SIGUSR1 prints the sampler's overrun counters and jitter histogram.
+	signal(SIGUSR1, statsSignalHandler);
 
 	ceeGraphicsState* graphicsState = ceeGraphicsMallocState();
 	assert(graphicsState != 0);
@@ -178,7 +525,12 @@ int main(int argc, char** arg) {
 	g_AlarmSound = AlarmSounds::NONE;
 
 	std::thread alarmThread(doAlarms);
-	std::thread sensorsThread(doSensors);
+	std::thread sensorsThread(doSensors, sampleSource.get());
+	std::thread analysisThread(doAnalysis);
+	std::thread recordingThread;
+	if (recorder) {
+		recordingThread = std::thread(doRecording, recorder.get());
+	}
 
 	const char* basicVertexShaderSource =
 		"attribute vec4 aPosition;\n"
@@ -255,28 +607,63 @@ int main(int argc, char** arg) {
 	ceeGraphicsSetVertices(peakMarkersVertices, 1024 * sizeof(float));
 
 	std::vector<float> qrsPeakLocations;
-	std::vector<float> rrIntevals;
-	rrIntevals.reserve(128);
-	std::vector<float> doubleDifferenceSquared;
-
-	std::vector<float> leadIICopy(ECG_DATA_POINTS, 0.f);
-	bool leadsConnected;
+	qrsPeakLocations.reserve(cee::HEART_RATE_MAX_BEATS);
+	// Only feeds the processed trace; beat detection runs on the analysis
+	// thread.
+	std::vector<float> doubleDifferenceSquared(ECG_DATA_POINTS, 0.f);
+	cee::DoubleDifferenceSquaredFilter<int32_t> qrsFilter;
+	uint64_t headSequence = 0;
+
+	std::vector<float> displayLead(ECG_DATA_POINTS, 0.f);
+	cee::LeadBuffer leads(ECG_DATA_POINTS, g_MeasuredLeads);
+	std::vector<cee::EcgSample> newSamples(ECG_DATA_POINTS);
+	bool leadsConnected = false;
+	uint8_t signalQuality = 0;
+	uint32_t i = 0;
 
 	g_Terminate.store(false);
 	while (!g_Terminate) {
-		{
-			std::scoped_lock lock(g_DataMutex);
-			std::copy(g_Data.leadII, g_Data.leadII + ECG_DATA_POINTS, leadIICopy.begin());
-
-			leadsConnected = g_Data.leadsConnected;
+		// Only samples pushed since the last frame are copied, and the
+		// sampler is never blocked by the render loop.
+		uint64_t firstSequence;
+		size_t newCount = g_SampleRing.ReadNew(newSamples.data(), ECG_DATA_POINTS, &firstSequence);
+		leads.Update(newSamples.data(), newCount, firstSequence);
+		// The QRS filter only sees new samples, and its output ring mirrors
+		// the display ring offset by the filter delay.
+		for (size_t n = 0; n < newCount; n++) {
+			uint64_t sequence = firstSequence + n;
+			size_t index = leads.GetIndex(sequence);
+			displayLead[index] = cee::FixedToVolts(leads.GetLead(g_DisplayLead)[index]);
+
+			int32_t filtered = qrsFilter.Process(leads.GetLead(cee::LEAD_II)[index]);
+			if (sequence >= qrsFilter.DELAY) {
+				doubleDifferenceSquared[(sequence - qrsFilter.DELAY) % ECG_DATA_POINTS] = filtered * PROCESSED_TRACE_SCALE;
+			}
+		}
+		if (newCount > 0) {
+			headSequence = firstSequence + newCount;
 		}
 
-		uint32_t i = g_Idx;
-		cee::CalculateDoubleDifferenceSquared(leadIICopy, doubleDifferenceSquared);
+		// Beats still on screen are marked in display order.
+		cee::HeartRateSnapshot heartRate = g_HeartRate.Read();
+		qrsPeakLocations.clear();
+		for (uint32_t beat = 0; beat < heartRate.beatCount; beat++) {
+			uint64_t sequence = heartRate.beatSequences[beat];
+			if (sequence + ECG_DATA_POINTS <= headSequence) {
+				continue;
+			}
+			qrsPeakLocations.push_back(2.0f * (static_cast<float>(sequence % ECG_DATA_POINTS) / ECG_DATA_POINTS) - 1.0f);
+		}
+		std::sort(qrsPeakLocations.begin(), qrsPeakLocations.end());
+		if (newCount > 0) {
+			leadsConnected = newSamples[newCount - 1].leadsConnected;
+			signalQuality = newSamples[newCount - 1].quality;
+			i = (firstSequence + newCount) % ECG_DATA_POINTS;
+		}
 
 		createGraphBuffer(
-				leadIICopy.data(),
-				leadIICopy.size() * sizeof(float),
+				displayLead.data(),
+				displayLead.size() * sizeof(float),
 				0.25f,
 				1.0f,
 				-0.2f,
@@ -300,7 +687,6 @@ int main(int argc, char** arg) {
 				1.0f,
 				processedVertices);
 
-		cee::FindQrsPeaks(doubleDifferenceSquared, 1.1f, qrsPeakLocations, ECG_DATA_TIME_MS);
 		createPeakChevrons(
 				qrsPeakLocations.data(),
 				qrsPeakLocations.size() * sizeof(float),
@@ -322,14 +708,14 @@ int main(int argc, char** arg) {
 		ceeGraphicsBindVertexBuffer(graphVbo);
 		ceeGraphicsSetVertexBufferLayout(basicVertexlayout, 2, 8 * sizeof(float));
 		ceeGraphicsSetSubVertices(graphVertices, ECG_DATA_POINTS * sizeof(float) * 8);
-		ceeGraphicsFlushLineStrip(g_Idx + 1, 0);
-		ceeGraphicsFlushLineStrip(ECG_DATA_POINTS - g_Idx - 1, g_Idx + 1);
+		ceeGraphicsFlushLineStrip(i + 1, 0);
+		ceeGraphicsFlushLineStrip(ECG_DATA_POINTS - i - 1, i + 1);
 
 //		ceeGraphicsBindVertexBuffer(processedGraphVbo);
 //		ceeGraphicsSetVertexBufferLayout(basicVertexlayout, 2, 8 * sizeof(float));
 //		ceeGraphicsSetSubVertices(processedVertices, ECG_DATA_POINTS * sizeof(float) * 8);
-//		ceeGraphicsFlushLineStrip(g_Idx + 1, 0);
-//		ceeGraphicsFlushLineStrip(ECG_DATA_POINTS - g_Idx - 1, g_Idx + 1);
+//		ceeGraphicsFlushLineStrip(i + 1, 0);
+//		ceeGraphicsFlushLineStrip(ECG_DATA_POINTS - i - 1, i + 1);
 
 		if (qrsPeakLocations.size() > 0) {
 			ceeGraphicsBindVertexBuffer(peakMarkersVbo);
@@ -338,35 +724,8 @@ int main(int argc, char** arg) {
 			ceeGraphicsFlushTriangles(qrsPeakLocations.size() * 3);
 		}
 
-		uint32_t rate;
-		if (qrsPeakLocations.size() > 3) {
-			float idxLoc = static_cast<float>(i)/static_cast<float>(ECG_DATA_POINTS);
-			for (auto&& peakLoc : qrsPeakLocations) {
-				peakLoc += 1.f;
-				peakLoc /= 2.f;
-			}
-			for (auto it = qrsPeakLocations.begin(); it != qrsPeakLocations.end(); it++) {
-				if (idxLoc > *it) {
-					for (auto itMinusOne = it; itMinusOne != qrsPeakLocations.end(); itMinusOne++) {
-						*itMinusOne -= 1.f;
-					}
-					std::rotate(qrsPeakLocations.begin(), it, qrsPeakLocations.end());
-					break;
-				}
-			}
-			rrIntevals.clear();
-			float rrAvg = 0.0;
-			for (auto it = qrsPeakLocations.begin(); it != (qrsPeakLocations.end() - 1); it++) {
-				rrIntevals.push_back(*(it + 1) - *(it));
-				rrAvg += (*(it + 1) - *(it)) * ECG_DATA_TIME_MS;
-			}
-			rrAvg /= (rrIntevals.size() - 1);
-			rate = static_cast<uint32_t>(60000.f / rrAvg);
-		} else {
-			rate = 0;
-		}
-
-		char rateStr[3];
+		uint32_t rate = heartRate.rate;
+		char rateStr[4];
 		if (rate > 999) {
 			rate = 999;
 		}
@@ -375,34 +734,51 @@ int main(int argc, char** arg) {
 		float rateTextX = 1600.f, rateTextY = 750.f;
 		ceeFontRendererDraw(numberFont, rateStr, &rateTextX, &rateTextY);
 
+		if (heartRate.pvcPerMinute > 0) {
+			char pvcStr[32];
+			snprintf(pvcStr, sizeof(pvcStr), "PVC %u/min", heartRate.pvcPerMinute);
+			float pvcTextX = 1600.f, pvcTextY = 650.f;
+			ceeFontRendererDraw(warningFont, pvcStr, &pvcTextX, &pvcTextY);
+		}
+
+		cee::RespirationSnapshot respiration = g_Respiration.Read();
+		if (respiration.source != cee::RespirationSource::NONE) {
+			char respStr[32];
+			snprintf(respStr, sizeof(respStr), "RESP %u%s", std::min(respiration.rate, 999u),
+					respiration.source == cee::RespirationSource::EDR ? " (ECG)" : "");
+			float respTextX = 1600.f, respTextY = 580.f;
+			ceeFontRendererDraw(warningFont, respStr, &respTextX, &respTextY);
+		}
+
+		cee::HrvMetrics hrv = g_Hrv.Read();
+		if (hrv.intervals > 1) {
+			char hrvStr[96];
+			snprintf(hrvStr, sizeof(hrvStr), "SDNN %.0f  RMSSD %.0f  LF/HF %.1f", hrv.sdnnMs, hrv.rmssdMs, hrv.lfHfRatio);
+			float hrvTextX = 1200.f, hrvTextY = 1040.f;
+			ceeFontRendererDraw(warningFont, hrvStr, &hrvTextX, &hrvTextY);
+		}
+
+		cee::MorphologySnapshot morphology = g_Morphology.Read();
+		const cee::LeadMorphology& intervals = morphology.leads[g_DisplayLead];
+		if (morphology.beatCount > 0 && !std::isnan(intervals.qrsMs)) {
+			char intervalStr[96];
+			if (std::isnan(intervals.qtcMs)) {
+				snprintf(intervalStr, sizeof(intervalStr), "QRS %.0f  ST %+.1f", intervals.qrsMs, intervals.stMv);
+			} else {
+				snprintf(intervalStr, sizeof(intervalStr), "QRS %.0f  QTc %.0f  ST %+.1f", intervals.qrsMs, intervals.qtcMs, intervals.stMv);
+			}
+			float intervalTextX = 1200.f, intervalTextY = 980.f;
+			ceeFontRendererDraw(warningFont, intervalStr, &intervalTextX, &intervalTextY);
+		}
+
 		float warningX = 0.f, warningY = 1040.f;
-		if (rate > 150) {
-			std::scoped_lock lock(g_AlarmSoundMutex);
-			g_AlarmSound = AlarmSounds::RED;
-			ceeFontRendererDraw(warningFont, "**XTREME TACHY", &warningX, &warningY);
-		} else if (rate > 120) {
-			std::scoped_lock lock(g_AlarmSoundMutex);
-			ceeFontRendererDraw(warningFont, "*TACHY", &warningX, &warningY);
-			g_AlarmSound = AlarmSounds::YELLOW;
-		} else if (rate == 0) {
-			std::scoped_lock lock(g_AlarmSoundMutex);
-			g_AlarmSound = AlarmSounds::RED;
-			ceeFontRendererDraw(warningFont, "***ASYSTOLE", &warningX, &warningY);
-		} else if (rate < 40) {
-			std::scoped_lock lock(g_AlarmSoundMutex);
-			g_AlarmSound = AlarmSounds::RED;
-			ceeFontRendererDraw(warningFont, "**XTREME BRADY", &warningX, &warningY);
-		} else if (rate < 50) {
-			std::scoped_lock lock(g_AlarmSoundMutex);
-			ceeFontRendererDraw(warningFont, "*BRADY", &warningX, &warningY);
-			g_AlarmSound = AlarmSounds::YELLOW;
-		} else if (!leadsConnected) {
-			std::scoped_lock lock(g_AlarmSoundMutex);
-			g_AlarmSound = AlarmSounds::CYAN;
-			ceeFontRendererDraw(warningFont, "ECG LEADS OFF", &warningX, &warningY);
-		} else {
+		cee::Alarm alarm = cee::EvaluateAlarm(rate, leadsConnected, signalQuality);
+		if (alarm.message) {
+			ceeFontRendererDraw(warningFont, alarm.message, &warningX, &warningY);
+		}
+		{
 			std::scoped_lock lock(g_AlarmSoundMutex);
-			g_AlarmSound = AlarmSounds::NONE;
+			g_AlarmSound = static_cast<AlarmSounds>(alarm.level);
 		}
 
 		ceeGraphicsEndFrame(graphicsState);
@@ -414,6 +790,10 @@ int main(int argc, char** arg) {
 	}
 
 	sensorsThread.join();
+	analysisThread.join();
+	if (recordingThread.joinable()) {
+		recordingThread.join();
+	}
 	alarmThread.join();
 
 	ceeFontRendererDeleteFont(numberFont);
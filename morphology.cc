@@ -0,0 +1,277 @@
+#include "morphology.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "dspKernels.hh"
+
+namespace cee {
+	constexpr float NOT_FOUND = std::numeric_limits<float>::quiet_NaN();
+	// QRS edges are where the slope falls to this fraction of its QRS peak;
+	// squared, as the search runs on slope energy.
+	constexpr int32_t QRS_EDGE_DIVISOR = 5 * 5;
+	// The 5-point derivative reads ten times the per-sample slope.
+	constexpr float DERIVATIVE_GAIN = 10.f;
+	constexpr float PR_BEGIN_MS = 40.f;
+	constexpr float PR_END_MS = 10.f;
+	constexpr float ST_OFFSET_MS = 60.f;
+	constexpr float FAST_ST_OFFSET_MS = 40.f;
+	constexpr int64_t FAST_RR_NS = 500000000ll;
+	constexpr float T_SEARCH_MS = 600.f;
+	// Of the RR interval, so the T search stops short of the next beat.
+	constexpr float T_SEARCH_RR_FRACTION = 0.8f;
+	// T waves smaller than this are too flat to place the tangent on.
+	constexpr float MIN_T_AMPLITUDE_MV = 0.05f;
+	// Leads with a QRS smaller than this (e.g. one nearly perpendicular to
+	// the heart's axis) have edges lost in the noise and aren't measured.
+	constexpr float MIN_QRS_AMPLITUDE_MV = 0.25f;
+	// Windows are resampled to about this rate: box-car averaged down from
+	// faster input, which keeps the slope search out of wideband noise and
+	// bounds the cost per beat, and linearly interpolated up from slower
+	// input, so the 5-point derivative doesn't smear a QRS edge over two
+	// input samples either side.
+	constexpr float ANALYSIS_RATE = 250.f;
+
+	MorphologyAnalyzer::MorphologyAnalyzer(float sampleRate)
+	 : m_Decimation(std::max<size_t>(1, static_cast<size_t>(sampleRate / ANALYSIS_RATE))),
+	   m_Interpolation(std::max<size_t>(1, static_cast<size_t>(std::ceil(ANALYSIS_RATE / sampleRate - 0.01f)))),
+	   m_SampleRate(sampleRate / m_Decimation * m_Interpolation)
+	{
+		// Room for the R refinement, a full QRS onset search and the PR
+		// segment before the detected R, and the longest T search after, at
+		// the analysis rate.
+		m_PeakSearchSamples = std::max<size_t>(1, static_cast<size_t>(std::lround(0.06f * m_SampleRate)));
+		m_QrsSearchSamples = std::max<size_t>(2, static_cast<size_t>(std::lround(0.15f * m_SampleRate)));
+		m_PreSamples = m_PeakSearchSamples + m_QrsSearchSamples + static_cast<size_t>(std::ceil(PR_BEGIN_MS / 1000.f * m_SampleRate)) + 2;
+		m_PostSamples = m_PeakSearchSamples + static_cast<size_t>(std::ceil(T_SEARCH_MS / 1000.f * m_SampleRate)) + 2;
+		m_WindowLength = m_PreSamples + 1 + m_PostSamples;
+
+		m_Window.resize(m_WindowLength);
+		m_Slope.resize(m_WindowLength);
+		m_Energy.resize(m_WindowLength);
+		m_Medians.reserve(LEAD_COUNT);
+		for (size_t lead = 0; lead < LEAD_COUNT; lead++) {
+			m_Medians.push_back(LeadMedians{ RunningMedian<float>(MEDIAN_BEATS), RunningMedian<float>(MEDIAN_BEATS),
+					RunningMedian<float>(MEDIAN_BEATS), RunningMedian<float>(MEDIAN_BEATS) });
+		}
+		Reset();
+	}
+
+	void MorphologyAnalyzer::Reset() {
+		m_PendingCount = 0;
+		m_LastTimestamp = 0;
+		m_HaveBeat = false;
+		for (LeadMedians& medians : m_Medians) {
+			medians.qrs.Reset();
+			medians.qt.Reset();
+			medians.qtc.Reset();
+			medians.st.Reset();
+		}
+		m_Snapshot.beatCount = 0;
+		for (LeadMorphology& lead : m_Snapshot.leads)
+			lead = { NOT_FOUND, NOT_FOUND, NOT_FOUND, NOT_FOUND };
+	}
+
+	void MorphologyAnalyzer::AddBeat(const BeatClassification& beat) {
+		int64_t rr = m_HaveBeat ? beat.timestamp - m_LastTimestamp : 0;
+		m_LastTimestamp = beat.timestamp;
+		m_HaveBeat = true;
+		if (beat.beatClass != BeatClass::NORMAL)
+			return;
+
+		if (m_PendingCount == MAX_PENDING) {
+			std::copy(m_Pending + 1, m_Pending + MAX_PENDING, m_Pending);
+			m_PendingCount--;
+		}
+		m_Pending[m_PendingCount++] = { beat.sequence, beat.timestamp, rr };
+	}
+
+	size_t MorphologyAnalyzer::Process(const LeadBuffer& leads, uint64_t headSequence, BeatMorphology* out, size_t maxCount) {
+		size_t done = 0;
+		size_t consumed = 0;
+		for (; consumed < m_PendingCount && done < maxCount; consumed++) {
+			const PendingBeat& beat = m_Pending[consumed];
+			// Input samples the window reaches either side of the R.
+			const uint64_t pre = m_PreSamples * m_Decimation / m_Interpolation + 2;
+			const uint64_t post = (m_PostSamples * m_Decimation + m_Interpolation - 1) / m_Interpolation + 2;
+			if (beat.sequence + post >= headSequence)
+				break;
+			// Beats whose window has already left the buffer are dropped.
+			if (beat.sequence < pre || beat.sequence + leads.GetCapacity() < headSequence + pre)
+				continue;
+
+			out[done] = Measure(beat, leads);
+			UpdateMedians(out[done]);
+			done++;
+		}
+
+		std::copy(m_Pending + consumed, m_Pending + m_PendingCount, m_Pending);
+		m_PendingCount -= consumed;
+		return done;
+	}
+
+	BeatMorphology MorphologyAnalyzer::Measure(const PendingBeat& beat, const LeadBuffer& leads) {
+		BeatMorphology result;
+		result.sequence = beat.sequence;
+		result.timestamp = beat.timestamp;
+		result.rrMs = beat.rr / 1e6f;
+		for (uint32_t lead = 0; lead < LEAD_COUNT; lead++)
+			result.leads[lead] = MeasureLead(leads.GetLead(static_cast<EcgLead>(lead)), beat.sequence, beat.rr);
+		return result;
+	}
+
+	LeadMorphology MorphologyAnalyzer::MeasureLead(std::span<const EcgFixed> lead, uint64_t rSequence, int64_t rr) {
+		LeadMorphology result = { NOT_FOUND, NOT_FOUND, NOT_FOUND, NOT_FOUND };
+
+		// Copy the window out of the ring so the kernels see contiguous
+		// samples, then take the slope and its energy in two vector passes.
+		const size_t mask = lead.size() - 1;
+		if (m_Interpolation > 1) {
+			// Window sample n sits n / m_Interpolation input samples from the
+			// first; the R lands on a whole input sample.
+			const uint64_t first = rSequence - m_PreSamples / m_Interpolation - 1;
+			const size_t phase = m_Interpolation - m_PreSamples % m_Interpolation;
+			for (size_t n = 0; n < m_WindowLength; n++) {
+				size_t position = n + phase;
+				int32_t a = lead[(first + position / m_Interpolation) & mask];
+				int32_t b = lead[(first + position / m_Interpolation + 1) & mask];
+				int32_t fraction = static_cast<int32_t>(position % m_Interpolation);
+				m_Window[n] = static_cast<EcgFixed>(a + (b - a) * fraction / static_cast<int32_t>(m_Interpolation));
+			}
+		} else if (m_Decimation == 1) {
+			const uint64_t first = rSequence - m_PreSamples;
+			for (size_t n = 0; n < m_WindowLength; n++)
+				m_Window[n] = lead[(first + n) & mask];
+		} else {
+			const uint64_t first = rSequence - m_PreSamples * m_Decimation;
+			for (size_t n = 0; n < m_WindowLength; n++) {
+				int32_t sum = 0;
+				for (size_t k = 0; k < m_Decimation; k++)
+					sum += lead[(first + n * m_Decimation + k) & mask];
+				m_Window[n] = static_cast<EcgFixed>(sum / static_cast<int32_t>(m_Decimation));
+			}
+		}
+		Derivative(m_Window.data(), m_Slope.data(), m_WindowLength);
+		Square(m_Slope.data(), m_Energy.data(), m_WindowLength);
+		const EcgFixed* x = m_Window.data();
+		const int16_t* slope = m_Slope.data();
+		const int32_t* energy = m_Energy.data();
+		const float msPerSample = 1000.f / m_SampleRate;
+
+		// The detector's R can be a sample or two off; take the largest
+		// deflection nearby.
+		size_t r = m_PreSamples;
+		int32_t peakValue = -1;
+		for (size_t n = m_PreSamples - m_PeakSearchSamples; n <= m_PreSamples + m_PeakSearchSamples; n++) {
+			int32_t value = std::abs(static_cast<int32_t>(x[n]));
+			if (value > peakValue) {
+				peakValue = value;
+				r = n;
+			}
+		}
+
+		const size_t qrsBegin = r - m_QrsSearchSamples;
+		const size_t qrsEnd = r + m_QrsSearchSamples;
+		const auto [qrsMin, qrsMax] = std::minmax_element(x + qrsBegin, x + qrsEnd + 1);
+		if (FixedToMillivolts(*qrsMax - *qrsMin) < MIN_QRS_AMPLITUDE_MV)
+			return result;
+		const int32_t maxEnergy = *std::max_element(energy + qrsBegin, energy + qrsEnd + 1);
+		if (maxEnergy <= 0)
+			return result;
+
+		// The outermost samples still above the edge, rather than walking out
+		// from R, so a notch or a Q wave inside the QRS doesn't end it early.
+		// Edges are interpolated between samples.
+		const int32_t edge = maxEnergy / QRS_EDGE_DIVISOR;
+		size_t onsetIndex = qrsBegin;
+		while (onsetIndex < r && energy[onsetIndex] <= edge)
+			onsetIndex++;
+		size_t offsetIndex = qrsEnd;
+		while (offsetIndex > r && energy[offsetIndex] <= edge)
+			offsetIndex--;
+		auto crossing = [energy, edge](size_t below, size_t above) {
+			float span = static_cast<float>(energy[above] - energy[below]);
+			return span > 0.f ? (edge - energy[below]) / span : 0.5f;
+		};
+		const float onset = onsetIndex > qrsBegin ? onsetIndex - 1 + crossing(onsetIndex - 1, onsetIndex) : onsetIndex;
+		const float offset = offsetIndex < qrsEnd ? offsetIndex + 1 - crossing(offsetIndex + 1, offsetIndex) : offsetIndex;
+		result.qrsMs = (offset - onset) * msPerSample;
+
+		// Isoelectric level from the PR segment just before the QRS.
+		const size_t prBegin = static_cast<size_t>(std::max(0.f, onset - PR_BEGIN_MS / msPerSample));
+		const size_t prEnd = std::max(prBegin, static_cast<size_t>(std::max(0.f, onset - PR_END_MS / msPerSample)));
+		float isoelectric = 0.f;
+		for (size_t n = prBegin; n <= prEnd; n++)
+			isoelectric += x[n];
+		isoelectric /= prEnd - prBegin + 1;
+
+		auto sampleAt = [x](float position) {
+			size_t index = static_cast<size_t>(position);
+			float fraction = position - index;
+			return x[index] + fraction * (x[index + 1] - x[index]);
+		};
+
+		const float stOffset = (rr > 0 && rr < FAST_RR_NS ? FAST_ST_OFFSET_MS : ST_OFFSET_MS) / msPerSample;
+		const float stPoint = offset + stOffset;
+		const float searchMs = rr > 0 ? std::min(T_SEARCH_MS, T_SEARCH_RR_FRACTION * rr / 1e6f) : T_SEARCH_MS;
+		const size_t tEnd = std::min(m_WindowLength - 3, r + static_cast<size_t>(searchMs / msPerSample));
+		if (stPoint + 1.f >= tEnd)
+			return result;
+		result.stMv = FixedToMillivolts(sampleAt(stPoint) - isoelectric);
+
+		// T peak is the largest excursion from the isoelectric level after
+		// the ST point.
+		size_t tPeak = static_cast<size_t>(std::ceil(stPoint));
+		float tAmplitude = 0.f;
+		for (size_t n = tPeak; n <= tEnd; n++) {
+			float amplitude = x[n] - isoelectric;
+			if (std::fabs(amplitude) > std::fabs(tAmplitude)) {
+				tAmplitude = amplitude;
+				tPeak = n;
+			}
+		}
+		if (std::fabs(FixedToMillivolts(tAmplitude)) < MIN_T_AMPLITUDE_MV)
+			return result;
+
+		// T end is where the tangent at the steepest slope back towards the
+		// isoelectric level meets it.
+		size_t steepest = 0;
+		int32_t steepestSlope = 0;
+		for (size_t n = tPeak + 1; n <= tEnd; n++) {
+			int32_t towards = tAmplitude > 0.f ? -slope[n] : slope[n];
+			if (towards > steepestSlope) {
+				steepestSlope = towards;
+				steepest = n;
+			}
+		}
+		if (steepestSlope <= 0)
+			return result;
+		const float perSample = slope[steepest] / DERIVATIVE_GAIN;
+		const float tangentEnd = steepest + (isoelectric - x[steepest]) / perSample;
+		if (tangentEnd <= tPeak || tangentEnd > m_WindowLength - 1)
+			return result;
+
+		result.qtMs = (tangentEnd - onset) * msPerSample;
+		if (rr > 0)
+			result.qtcMs = result.qtMs / std::sqrt(rr / 1e9f);
+		return result;
+	}
+
+	void MorphologyAnalyzer::UpdateMedians(const BeatMorphology& beat) {
+		m_Snapshot.beatCount++;
+		for (size_t lead = 0; lead < LEAD_COUNT; lead++) {
+			const LeadMorphology& measured = beat.leads[lead];
+			LeadMedians& medians = m_Medians[lead];
+			LeadMorphology& snapshot = m_Snapshot.leads[lead];
+			if (!std::isnan(measured.qrsMs))
+				snapshot.qrsMs = medians.qrs.Process(measured.qrsMs);
+			if (!std::isnan(measured.stMv))
+				snapshot.stMv = medians.st.Process(measured.stMv);
+			if (!std::isnan(measured.qtcMs)) {
+				snapshot.qtMs = medians.qt.Process(measured.qtMs);
+				snapshot.qtcMs = medians.qtc.Process(measured.qtcMs);
+			}
+		}
+	}
+}
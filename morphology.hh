@@ -0,0 +1,112 @@
+#ifndef CEE_MORPHOLOGY_H_
+#define CEE_MORPHOLOGY_H_
+
+#include <span>
+#include <vector>
+
+#include <cstdint>
+#include <cstddef>
+
+#include "beatClassifier.hh"
+#include "fixedPoint.hh"
+#include "leads.hh"
+#include "runningMedian.hh"
+
+namespace cee {
+	// Intervals and levels of one beat on one lead; NaN where a fiducial
+	// point could not be found.
+	struct LeadMorphology {
+		float qrsMs;
+		float qtMs;
+		float qtcMs;          // Bazett, QT / sqrt(RR in seconds)
+		float stMv;           // at J+60 ms (J+40 ms above 120 bpm), from the PR level
+	};
+
+	struct BeatMorphology {
+		uint64_t sequence;
+		int64_t timestamp;
+		float rrMs;
+		LeadMorphology leads[LEAD_COUNT];
+	};
+
+	// Rolling medians of the per-beat measurements, per lead.
+	struct MorphologySnapshot {
+		uint32_t beatCount;   // beats measured so far
+		LeadMorphology leads[LEAD_COUNT];
+	};
+
+	// Fiducial points around each normal beat, on every lead: QRS onset and
+	// offset (J point) where the slope energy falls to a fraction of its QRS
+	// peak, the isoelectric level over the PR segment, and T-wave end by the
+	// tangent to the steepest T downslope. Each beat and lead is a
+	// fixed-size window copied out of the LeadBuffer, run through the int16
+	// Derivative and Square kernels, then searched; so the cost per beat is
+	// independent of rate, and the work happens on the analysis thread.
+	class MorphologyAnalyzer {
+	public:
+		static constexpr size_t MAX_PENDING = 8;
+		static constexpr size_t MEDIAN_BEATS = 9;
+
+	public:
+		MorphologyAnalyzer(float sampleRate);
+		~MorphologyAnalyzer() = default;
+
+		void Reset();
+		// The next beat opens no RR interval, after a gap in analysis.
+		void Interrupt() { m_HaveBeat = false; }
+
+		// Takes beats as they are classified; only normal beats are
+		// measured, but every beat counts for the RR interval.
+		void AddBeat(const BeatClassification& beat);
+		// Measures every queued beat whose window the buffer now holds,
+		// where headSequence - 1 is its newest sample. Returns the number
+		// written to `out`.
+		size_t Process(const LeadBuffer& leads, uint64_t headSequence, BeatMorphology* out, size_t maxCount);
+
+		const MorphologySnapshot& GetSnapshot() const { return m_Snapshot; }
+		size_t GetWindowLength() const { return m_WindowLength; }
+
+	private:
+		struct PendingBeat {
+			uint64_t sequence;
+			int64_t timestamp;
+			int64_t rr;
+		};
+
+		struct LeadMedians {
+			RunningMedian<float> qrs;
+			RunningMedian<float> qt;
+			RunningMedian<float> qtc;
+			RunningMedian<float> st;
+		};
+
+		BeatMorphology Measure(const PendingBeat& beat, const LeadBuffer& leads);
+		LeadMorphology MeasureLead(std::span<const EcgFixed> lead, uint64_t rSequence, int64_t rr);
+		void UpdateMedians(const BeatMorphology& beat);
+
+	private:
+		size_t m_Decimation;
+		size_t m_Interpolation;
+		float m_SampleRate;     // of the analysis windows
+		size_t m_PreSamples;
+		size_t m_PostSamples;
+		size_t m_WindowLength;
+		size_t m_PeakSearchSamples;
+		size_t m_QrsSearchSamples;
+
+		PendingBeat m_Pending[MAX_PENDING];
+		size_t m_PendingCount;
+		int64_t m_LastTimestamp;
+		bool m_HaveBeat;
+
+		// Scratch for one lead's window; sized once in the constructor.
+		std::vector<EcgFixed> m_Window;
+		std::vector<int16_t> m_Slope;
+		std::vector<int32_t> m_Energy;
+
+		std::vector<LeadMedians> m_Medians;
+		MorphologySnapshot m_Snapshot;
+	};
+}
+
+#endif
@@ -0,0 +1,122 @@
+#ifndef CEE_NOTCH_FILTER_H_
+#define CEE_NOTCH_FILTER_H_
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+#include <cstdint>
+#include <cstddef>
+
+namespace cee {
+	// Adaptive mains interference canceller. An internal oscillator at the
+	// mains frequency supplies sine/cosine references for the fundamental
+	// and Harmonics-1 harmonics; LMS weights fit their amplitude and phase
+	// and the fit is subtracted from the input. The rotation of the
+	// fundamental's weight vector measures the frequency error, which
+	// steers the oscillator (a PLL) within +/-2 Hz of nominal. Harmonics at
+	// or above 0.45 of the sample rate are skipped.
+	// Fixed cost per sample and no allocation; the sample rate must be well
+	// above twice the mains frequency, so use it ahead of decimation.
+	template<size_t Harmonics = 3>
+	class AdaptiveNotch {
+		static_assert(Harmonics > 0, "Harmonics must be positive.");
+
+	public:
+		static constexpr float DELAY = 0.f;
+
+	public:
+		AdaptiveNotch(float sampleRate, float mainsHz = 50.f, float bandwidthHz = 1.f)
+		 : m_SampleRate(sampleRate), m_NominalOmega(2.0 * M_PI * mainsHz / sampleRate)
+		{
+			m_Step = 2.f * static_cast<float>(M_PI) * bandwidthHz / sampleRate;
+			m_MaxOmegaError = 2.0 * M_PI * 2.0 / sampleRate;
+			m_ActiveHarmonics = 0;
+			while (m_ActiveHarmonics < Harmonics && (m_ActiveHarmonics + 1) * mainsHz < 0.45f * sampleRate)
+				m_ActiveHarmonics++;
+			Reset();
+		}
+
+		void Reset() {
+			m_Omega = m_NominalOmega;
+			m_Phase = 0.0;
+			m_CosWeights.fill(0.f);
+			m_SinWeights.fill(0.f);
+			m_ErrorPower = 0.f;
+		}
+
+		bool IsActive() const { return m_ActiveHarmonics > 0; }
+		float GetFrequency() const { return static_cast<float>(m_Omega * m_SampleRate / (2.0 * M_PI)); }
+
+		float Process(float in) {
+			if (m_ActiveHarmonics == 0)
+				return in;
+
+			const float cos1 = static_cast<float>(std::cos(m_Phase));
+			const float sin1 = static_cast<float>(std::sin(m_Phase));
+
+			// Harmonic references by repeated rotation of the fundamental.
+			std::array<float, Harmonics> cosRef, sinRef;
+			float c = cos1, s = sin1;
+			float estimate = 0.f;
+			for (size_t k = 0; k < m_ActiveHarmonics; k++) {
+				cosRef[k] = c;
+				sinRef[k] = s;
+				estimate += m_CosWeights[k] * c + m_SinWeights[k] * s;
+				float next = c * cos1 - s * sin1;
+				s = s * cos1 + c * sin1;
+				c = next;
+			}
+
+			const float error = in - estimate;
+			const float previousCos = m_CosWeights[0], previousSin = m_SinWeights[0];
+			for (size_t k = 0; k < m_ActiveHarmonics; k++) {
+				m_CosWeights[k] += m_Step * error * cosRef[k];
+				m_SinWeights[k] += m_Step * error * sinRef[k];
+			}
+
+			// A constant frequency error makes the fundamental's weights turn
+			// by that error every sample. The correction is scaled down, and
+			// stopped entirely, when the hum is small against everything else
+			// so noise alone doesn't walk the oscillator.
+			const float magnitude = m_CosWeights[0] * m_CosWeights[0] + m_SinWeights[0] * m_SinWeights[0];
+			m_ErrorPower += 0.001f * (error * error - m_ErrorPower);
+			const float confidence = magnitude / (magnitude + m_ErrorPower + 1e-12f);
+			if (confidence > MIN_CONFIDENCE) {
+				float rotation = (previousCos * m_SinWeights[0] - previousSin * m_CosWeights[0]) / magnitude;
+				m_Omega -= FREQUENCY_GAIN * confidence * rotation;
+				m_Omega = std::clamp(m_Omega, m_NominalOmega - m_MaxOmegaError, m_NominalOmega + m_MaxOmegaError);
+			}
+
+			m_Phase += m_Omega;
+			if (m_Phase > 2.0 * M_PI)
+				m_Phase -= 2.0 * M_PI;
+
+			return error;
+		}
+
+		bool Process(float in, float& out) {
+			out = Process(in);
+			return true;
+		}
+
+	private:
+		static constexpr double FREQUENCY_GAIN = 0.02;
+		static constexpr float MIN_CONFIDENCE = 0.05f;
+
+		float m_SampleRate;
+		double m_NominalOmega;
+		double m_MaxOmegaError;
+		double m_Omega;
+		double m_Phase;
+		float m_Step;
+		size_t m_ActiveHarmonics;
+
+		std::array<float, Harmonics> m_CosWeights;
+		std::array<float, Harmonics> m_SinWeights;
+		float m_ErrorPower;
+	};
+}
+
+#endif
+
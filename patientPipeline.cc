@@ -0,0 +1,100 @@
+#include "patientPipeline.hh"
+
+#include <algorithm>
+
+#include "util.h"
+
+namespace cee {
+	PatientPipeline::PatientPipeline(std::unique_ptr<SampleSource> source, float sampleRate)
+	 : m_Source(std::move(source)), m_Period(static_cast<int64_t>(NSEC_PER_SEC / sampleRate)),
+	   m_NextTimestamp(0), m_Sequence(0), m_Analysing(true), m_LeadsConnected(false), m_Quality(0),
+	   m_Timestamps{}, m_QrsDetector(sampleRate), m_BeatCount(0), m_SampleCount(0),
+	   m_Baselines{ BaselineFilter<EcgFixed>(sampleRate), BaselineFilter<EcgFixed>(sampleRate), BaselineFilter<EcgFixed>(sampleRate) },
+	   m_BaselineHistory(m_Baselines[0].GetDelay() + 1), m_BaselinePosition(0), m_BaselineWarmup(m_Baselines[0].GetDelay()),
+	   m_Qualities{ SignalQualityMonitor(sampleRate), SignalQualityMonitor(sampleRate), SignalQualityMonitor(sampleRate) }
+	{
+	}
+
+	size_t PatientPipeline::Advance(int64_t until) {
+		size_t processed = 0;
+		uint8_t codes[ECG_CHANNEL_COUNT];
+		while (m_NextTimestamp < until) {
+			int64_t timestamp = m_NextTimestamp;
+			m_NextTimestamp += m_Period;
+			if (!m_Source->Acquire(timestamp, codes))
+				continue;
+			ProcessSample(timestamp, codes);
+			processed++;
+		}
+		// Nothing is analysed until the baseline filters have filled.
+		if (processed == 0 || m_Sequence == 0)
+			return processed;
+
+		const int64_t now = m_Timestamps[(m_Sequence - 1) % m_Timestamps.size()];
+		m_HeartRate.Update(now);
+		const HeartRateSnapshot& heartRate = m_HeartRate.GetSnapshot();
+		PatientStatus status;
+		status.rate = heartRate.rate;
+		status.rrAverageMs = heartRate.rrAverageMs;
+		status.leadsConnected = m_LeadsConnected;
+		status.quality = m_Quality;
+		status.alarm = EvaluateAlarm(status.rate, status.leadsConnected, status.quality);
+		status.beatCount = m_BeatCount;
+		status.sampleCount = m_SampleCount;
+		status.timestamp = now;
+		m_Status.Publish(status);
+		return processed;
+	}
+
+	void PatientPipeline::ProcessSample(int64_t timestamp, const uint8_t codes[ECG_CHANNEL_COUNT]) {
+		EcgSample sample;
+		sample.timestamp = timestamp;
+		for (uint32_t channel = 0; channel < ECG_CHANNEL_COUNT; channel++)
+			sample.channels[channel] = AdcCodeToFixed(codes[channel]);
+
+		EcgFixed leads[ECG_RESP];
+		for (uint32_t channel = 0; channel < ECG_RESP; channel++)
+			leads[channel] = m_Baselines[channel].Process(sample.channels[channel]);
+		m_BaselineHistory[m_BaselinePosition] = sample;
+		m_BaselinePosition = (m_BaselinePosition + 1) % m_BaselineHistory.size();
+		if (m_BaselineWarmup > 0) {
+			m_BaselineWarmup--;
+			return;
+		}
+		const EcgSample& raw = m_BaselineHistory[m_BaselinePosition];
+
+		m_LeadsConnected = true;
+		m_Quality = 100;
+		for (uint32_t channel = 0; channel < ECG_RESP; channel++) {
+			const SignalQuality& quality = m_Qualities[channel].Process(raw.channels[channel], leads[channel]);
+			m_LeadsConnected &= !quality.leadOff;
+			m_Quality = std::min(m_Quality, quality.score);
+		}
+		m_SampleCount++;
+
+		const uint64_t sequence = m_Sequence++;
+		m_Timestamps[sequence % m_Timestamps.size()] = raw.timestamp;
+		int32_t filtered = m_QrsFilter.Process(leads[ECG_LEAD_II]);
+		if (sequence < m_QrsFilter.DELAY)
+			return;
+		const uint64_t filteredSequence = sequence - m_QrsFilter.DELAY;
+
+		// As on the bedside monitor, unusable stretches are skipped and the
+		// detector relearns the signal afterwards.
+		if (!m_LeadsConnected || m_Quality < MIN_ANALYSIS_QUALITY) {
+			m_Analysing = false;
+			return;
+		}
+		if (!m_Analysing) {
+			m_QrsDetector.Reset();
+			m_HeartRate.Interrupt();
+			m_Analysing = true;
+		}
+
+		BeatEvent beat;
+		if (m_QrsDetector.Process(filtered, filteredSequence, m_Timestamps[filteredSequence % m_Timestamps.size()], beat)) {
+			m_HeartRate.AddBeat(beat);
+			m_BeatCount++;
+		}
+	}
+}
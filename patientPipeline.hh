@@ -0,0 +1,85 @@
+#ifndef CEE_PATIENT_PIPELINE_H_
+#define CEE_PATIENT_PIPELINE_H_
+
+#include <array>
+#include <memory>
+#include <vector>
+
+#include <cstdint>
+#include <cstddef>
+
+#include "alarms.hh"
+#include "dataProcessing.hh"
+#include "ecgSample.hh"
+#include "heartRate.hh"
+#include "qrsDetector.hh"
+#include "runningMedian.hh"
+#include "sampleSource.hh"
+#include "signalQuality.hh"
+#include "snapshot.hh"
+
+namespace cee {
+	struct PatientStatus {
+		uint32_t rate;            // bpm, 0 when there is no rhythm
+		float rrAverageMs;
+		bool leadsConnected;
+		uint8_t quality;          // worst limb lead, as in EcgSample
+		Alarm alarm;
+		uint64_t beatCount;
+		uint64_t sampleCount;
+		int64_t timestamp;        // of the newest sample analysed
+	};
+
+	// One bed's analysis, the same chain the bedside monitor runs across
+	// its sensor and analysis threads: baseline removal and signal quality
+	// on the limb leads, QRS detection on lead II, heart rate and the alarm.
+	// All state is per instance, so pipelines for different beds can run on
+	// any threads, and a pipeline on its own cache lines never shares one
+	// with a neighbour that another worker is advancing.
+	class alignas(64) PatientPipeline {
+	public:
+		PatientPipeline(std::unique_ptr<SampleSource> source, float sampleRate);
+		~PatientPipeline() = default;
+
+		// Acquires and analyses every sample period up to `until` on the
+		// pipeline's own clock, which starts at 0. Only one thread may
+		// advance a pipeline at a time. Returns the samples processed.
+		size_t Advance(int64_t until);
+
+		// Any thread; updated at the end of every Advance.
+		PatientStatus GetStatus() const { return m_Status.Read(); }
+		const char* GetSourceName() const { return m_Source->GetName(); }
+
+	private:
+		void ProcessSample(int64_t timestamp, const uint8_t codes[ECG_CHANNEL_COUNT]);
+
+	private:
+		std::unique_ptr<SampleSource> m_Source;
+		int64_t m_Period;
+		int64_t m_NextTimestamp;
+		uint64_t m_Sequence;
+		bool m_Analysing;
+
+		// Per-sample state first; the larger histories live on the heap.
+		bool m_LeadsConnected;
+		uint8_t m_Quality;
+		DoubleDifferenceSquaredFilter<int32_t> m_QrsFilter;
+		std::array<int64_t, DoubleDifferenceSquaredFilter<int32_t>::DELAY + 1> m_Timestamps;
+		QrsDetector m_QrsDetector;
+		HeartRateMonitor m_HeartRate;
+		uint64_t m_BeatCount;
+		uint64_t m_SampleCount;
+
+		// Baseline removal delays the leads, so the raw samples are held
+		// back to match for rail detection.
+		std::array<BaselineFilter<EcgFixed>, ECG_RESP> m_Baselines;
+		std::vector<EcgSample> m_BaselineHistory;
+		size_t m_BaselinePosition;
+		uint64_t m_BaselineWarmup;
+		std::array<SignalQualityMonitor, ECG_RESP> m_Qualities;
+
+		Snapshot<PatientStatus> m_Status;
+	};
+}
+
+#endif
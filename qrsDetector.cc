@@ -0,0 +1,174 @@
+#include "qrsDetector.hh"
+
+#include <algorithm>
+#include <cmath>
+
+namespace cee {
+	QrsDetector::QrsDetector(float sampleRate, float minimumPeak)
+	 : m_SampleRate(sampleRate), m_MinimumPeak(minimumPeak)
+	{
+		m_WindowLength = std::max<uint32_t>(1, static_cast<uint32_t>(std::lround(0.150f * sampleRate)));
+		m_RefractorySamples = static_cast<uint32_t>(std::lround(0.200f * sampleRate));
+		m_TWaveSamples = static_cast<uint32_t>(std::lround(0.360f * sampleRate));
+		m_LearningSamples = static_cast<uint32_t>(std::lround(2.f * sampleRate));
+		m_History.resize(m_WindowLength);
+		m_PeakQueue.resize(m_WindowLength);
+		Reset();
+	}
+
+	void QrsDetector::Reset() {
+		std::fill(m_History.begin(), m_History.end(), History{ 0.f, 0, 0 });
+		m_HistoryPosition = 0;
+		m_WindowSum = 0.f;
+		m_Processed = 0;
+		m_PeakHead = 0;
+		m_PeakCount = 0;
+		m_Previous = 0.f;
+		m_Rising = false;
+		m_SignalLevel = 0.f;
+		m_NoiseLevel = 0.f;
+		m_Threshold = 0.f;
+		m_LearningMax = 0.f;
+		m_LearningSum = 0.0;
+		m_LastBeat = 0;
+		m_LastBeatSlope = 0.f;
+		m_HaveBeat = false;
+		m_CandidateValue = 0.f;
+		m_CandidateSlope = 0.f;
+		m_CandidateSequence = 0;
+		m_CandidateTimestamp = 0;
+		m_RrCount = 0;
+		m_RrPosition = 0;
+		m_RrSum = 0;
+	}
+
+	void QrsDetector::UpdateThresholds() {
+		m_Threshold = std::max(m_MinimumPeak, m_NoiseLevel + 0.25f * (m_SignalLevel - m_NoiseLevel));
+	}
+
+	void QrsDetector::UpdateRrAverage(uint64_t sequence) {
+		if (m_HaveBeat) {
+			uint64_t rr = sequence - m_LastBeat;
+			if (m_RrCount == RR_HISTORY) {
+				m_RrSum -= m_RrIntervals[m_RrPosition];
+			} else {
+				m_RrCount++;
+			}
+			m_RrIntervals[m_RrPosition] = rr;
+			m_RrSum += rr;
+			m_RrPosition = (m_RrPosition + 1) % RR_HISTORY;
+		}
+		m_LastBeat = sequence;
+		m_HaveBeat = true;
+		m_CandidateValue = 0.f;
+	}
+
+	float QrsDetector::FindRPeak(uint64_t& sequence, int64_t& timestamp) const {
+		// The integrated peak trails the QRS, so the R peak is taken as the
+		// largest input sample in the integration window ending at the peak.
+		const History& best = m_PeakQueue[m_PeakHead];
+		sequence = best.sequence;
+		timestamp = best.timestamp;
+		return best.value;
+	}
+
+	void QrsDetector::PushRPeakCandidate(const History& entry) {
+		// Smaller inputs before this one can never be the maximum again;
+		// equal ones stay, so ties go to the earliest sample.
+		while (m_PeakCount > 0 && m_PeakQueue[(m_PeakHead + m_PeakCount - 1) % m_WindowLength].value < entry.value)
+			m_PeakCount--;
+		while (m_PeakCount > 0 && m_PeakQueue[m_PeakHead].sequence + m_WindowLength <= entry.sequence) {
+			m_PeakHead = (m_PeakHead + 1) % m_WindowLength;
+			m_PeakCount--;
+		}
+		m_PeakQueue[(m_PeakHead + m_PeakCount) % m_WindowLength] = entry;
+		m_PeakCount++;
+	}
+
+	bool QrsDetector::Process(float value, uint64_t sequence, int64_t timestamp, BeatEvent& beat) {
+		History& slot = m_History[m_HistoryPosition];
+		m_WindowSum += value - slot.value;
+		slot = History{ value, sequence, timestamp };
+		m_HistoryPosition = (m_HistoryPosition + 1) % m_WindowLength;
+		m_Processed++;
+
+		// Running sums drift with float rounding; resynchronise once per
+		// window.
+		if (m_HistoryPosition == 0) {
+			m_WindowSum = 0.f;
+			for (auto&& entry : m_History)
+				m_WindowSum += entry.value;
+		}
+		float integrated = m_WindowSum / m_WindowLength;
+
+		if (m_Processed <= m_LearningSamples) {
+			m_LearningMax = std::max(m_LearningMax, integrated);
+			m_LearningSum += integrated;
+			if (m_Processed == m_LearningSamples) {
+				m_SignalLevel = m_LearningMax / 3.f;
+				m_NoiseLevel = static_cast<float>(m_LearningSum / m_LearningSamples) / 2.f;
+				UpdateThresholds();
+			}
+			m_Rising = integrated > m_Previous;
+			m_Previous = integrated;
+			PushRPeakCandidate(slot);
+			return false;
+		}
+
+		bool detected = false;
+		bool falling = integrated < m_Previous;
+		if (m_Rising && falling) {
+			// The previous sample was a local maximum.
+			float peak = m_Previous;
+			uint64_t peakSequence = sequence - 1;
+			bool refractory = m_HaveBeat && (peakSequence - m_LastBeat) < m_RefractorySamples;
+
+			uint64_t rSequence;
+			int64_t rTimestamp;
+			float slope = FindRPeak(rSequence, rTimestamp);
+			bool tWave = m_HaveBeat && (rSequence - m_LastBeat) < m_TWaveSamples && slope < 0.5f * m_LastBeatSlope;
+
+			if (!refractory && !tWave && peak > m_Threshold) {
+				m_SignalLevel = 0.125f * peak + 0.875f * m_SignalLevel;
+				m_LastBeatSlope = slope;
+				beat.sequence = rSequence;
+				beat.timestamp = rTimestamp;
+				beat.amplitude = peak;
+				beat.searchback = false;
+				UpdateRrAverage(beat.sequence);
+				detected = true;
+			} else {
+				m_NoiseLevel = 0.125f * peak + 0.875f * m_NoiseLevel;
+				if (!refractory && !tWave && peak > 0.5f * m_Threshold && peak > m_MinimumPeak && peak > m_CandidateValue) {
+					m_CandidateValue = peak;
+					m_CandidateSequence = rSequence;
+					m_CandidateTimestamp = rTimestamp;
+					m_CandidateSlope = slope;
+				}
+			}
+			UpdateThresholds();
+		}
+		m_Rising = integrated > m_Previous || (m_Rising && integrated == m_Previous);
+		m_Previous = integrated;
+		// Only now, so a peak found above was looked up in the window
+		// ending at the previous sample.
+		PushRPeakCandidate(slot);
+
+		if (!detected && m_HaveBeat && m_RrCount > 0 && m_CandidateValue > 0.f) {
+			uint64_t searchbackInterval = (m_RrSum * 166) / (m_RrCount * 100);
+			if (sequence - m_LastBeat > searchbackInterval) {
+				m_SignalLevel = 0.25f * m_CandidateValue + 0.75f * m_SignalLevel;
+				UpdateThresholds();
+				beat.sequence = m_CandidateSequence;
+				beat.timestamp = m_CandidateTimestamp;
+				beat.amplitude = m_CandidateValue;
+				beat.searchback = true;
+				m_LastBeatSlope = m_CandidateSlope;
+				UpdateRrAverage(beat.sequence);
+				detected = true;
+			}
+		}
+		return detected;
+	}
+}
+
@@ -0,0 +1,121 @@
+#ifndef CEE_QRS_DETECTOR_H_
+#define CEE_QRS_DETECTOR_H_
+
+#include <vector>
+
+#include <cstdint>
+#include <cstddef>
+
+#include "fixedPoint.hh"
+
+namespace cee {
+	struct BeatEvent {
+		uint64_t sequence;   // sample sequence number of the R peak
+		int64_t timestamp;   // acquisition time of that sample
+		float amplitude;     // integrated QRS energy at detection
+		bool searchback;     // found by searchback rather than threshold I1
+	};
+
+	// Integrated level that white noise of QRS_NOISE_FLOOR_CODES RMS ADC
+	// codes reaches through DoubleDifferenceSquaredFilter<int32_t> on
+	// EcgFixed samples: the derivative's variance is 10 times the input's,
+	// and the 2 bits the square drops are won back by summing 4 squares.
+	// Noise reaches the same level at any sample rate, while a QRS's falls
+	// with the square of the rate; at 1 kHz one still integrates to
+	// several times this.
+	constexpr float QRS_NOISE_FLOOR_CODES = 2.f;
+	constexpr float QRS_MIN_PEAK = 10.f * (QRS_NOISE_FLOOR_CODES * ECG_FIXED_ONE) * (QRS_NOISE_FLOOR_CODES * ECG_FIXED_ONE);
+
+	// Streaming Pan-Tompkins style detector. Input is the squared-derivative
+	// signal (e.g. from DoubleDifferenceSquaredFilter); the detector adds the
+	// 150 ms moving window integration itself. Signal and noise peak levels
+	// adapt per peak, missed beats are recovered by searchback after 1.66
+	// average RR intervals, peaks within 200 ms of a QRS are ignored and
+	// peaks within 360 ms with less than half the previous QRS slope are
+	// treated as T waves. No peak below `minimumPeak` counts as a beat or a
+	// searchback candidate, so a flat or noise-only lead yields no beats
+	// rather than the noise being learned as signal.
+	// Calls cost O(1) amortised: the R peak, the largest input in the
+	// integration window, is kept by a monotonic queue rather than searched
+	// for, and only the once-per-window resync of the sum touches the
+	// whole window.
+	class QrsDetector {
+	public:
+		QrsDetector(float sampleRate, float minimumPeak = QRS_MIN_PEAK);
+		~QrsDetector() = default;
+
+		void Reset();
+
+		// Feeds one sample. Returns true and fills `beat` when a QRS is
+		// confirmed; beats are reported in order but may refer to a sample
+		// up to one searchback interval in the past.
+		bool Process(float value, uint64_t sequence, int64_t timestamp, BeatEvent& beat);
+
+		float GetSignalLevel() const { return m_SignalLevel; }
+		float GetNoiseLevel() const { return m_NoiseLevel; }
+		float GetThreshold() const { return m_Threshold; }
+
+	private:
+		struct History {
+			float value;
+			uint64_t sequence;
+			int64_t timestamp;
+		};
+
+		void UpdateThresholds();
+		void UpdateRrAverage(uint64_t sequence);
+		// Returns the largest input (squared slope) in the window ending at
+		// the previous sample.
+		float FindRPeak(uint64_t& sequence, int64_t& timestamp) const;
+		void PushRPeakCandidate(const History& entry);
+
+	private:
+		float m_SampleRate;
+		float m_MinimumPeak;
+		uint32_t m_WindowLength;
+		uint32_t m_RefractorySamples;
+		uint32_t m_TWaveSamples;
+		uint32_t m_LearningSamples;
+
+		// Moving window integration and the raw input it covers.
+		std::vector<History> m_History;
+		uint32_t m_HistoryPosition;
+		float m_WindowSum;
+		uint64_t m_Processed;
+
+		// Inputs in the window in sequence order with decreasing values, so
+		// the front is the window's maximum.
+		std::vector<History> m_PeakQueue;
+		uint32_t m_PeakHead;
+		uint32_t m_PeakCount;
+
+		// Local maximum tracking on the integrated signal.
+		float m_Previous;
+		bool m_Rising;
+
+		float m_SignalLevel;
+		float m_NoiseLevel;
+		float m_Threshold;
+		float m_LearningMax;
+		double m_LearningSum;
+
+		uint64_t m_LastBeat;
+		float m_LastBeatSlope;
+		bool m_HaveBeat;
+
+		// Largest sub-threshold peak since the last beat, for searchback.
+		float m_CandidateValue;
+		float m_CandidateSlope;
+		uint64_t m_CandidateSequence;
+		int64_t m_CandidateTimestamp;
+
+		static constexpr size_t RR_HISTORY = 8;
+		uint64_t m_RrIntervals[RR_HISTORY];
+		uint32_t m_RrCount;
+		uint32_t m_RrPosition;
+		uint64_t m_RrSum;
+	};
+}
+
+#endif
+
@@ -0,0 +1,196 @@
+#include "respiration.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "util.h"
+
+namespace cee {
+	// Detrending follows breathing down to about 3 per minute.
+	constexpr float BASELINE_TAU = 6.f;
+	constexpr float SMOOTH_TAU = 0.2f;
+	constexpr float AMPLITUDE_TAU = 8.f;
+	constexpr float HYSTERESIS_FRACTION = 0.5f;
+	// Breaths are ignored until the averages have had time to settle.
+	constexpr int64_t SETTLE_NS = 5 * NSEC_PER_SEC;
+	// Nothing faster than 60 breaths per minute is counted.
+	constexpr int64_t MIN_BREATH_INTERVAL_NS = NSEC_PER_SEC;
+	// Below two ADC codes of swing the resp channel is taken to be
+	// unconnected rather than breathing.
+	constexpr float MIN_IMPEDANCE_AMPLITUDE = 2.f * ECG_FIXED_ONE;
+
+	const char* GetRespirationSourceName(RespirationSource source) {
+		switch (source) {
+		case RespirationSource::NONE: return "none";
+		case RespirationSource::IMPEDANCE: return "impedance";
+		case RespirationSource::EDR: return "edr";
+		}
+		return "none";
+	}
+
+	BreathDetector::BreathDetector(size_t window)
+	 : m_Window(std::clamp<size_t>(window, 1, MAX_WINDOW))
+	{
+		Reset();
+	}
+
+	void BreathDetector::Reset() {
+		m_LastTimestamp = 0;
+		m_HaveSample = false;
+		m_Baseline = 0.f;
+		m_Smoothed = 0.f;
+		m_Amplitude = 0.f;
+		m_Inhaling = false;
+		m_IntervalCount = 0;
+		m_IntervalPosition = 0;
+		m_IntervalSum = 0;
+		m_LastBreath = 0;
+		m_HaveBreath = false;
+		m_Rate = 0;
+		m_IntervalAverageMs = 0.f;
+	}
+
+	bool BreathDetector::Process(int64_t timestamp, float value) {
+		if (!m_HaveSample) {
+			m_HaveSample = true;
+			m_LastTimestamp = timestamp;
+			m_Baseline = value;
+			// Doubles as the settling deadline until the first breath.
+			m_LastBreath = timestamp + SETTLE_NS;
+			return false;
+		}
+
+		float dt = static_cast<float>(timestamp - m_LastTimestamp) / NSEC_PER_SEC;
+		m_LastTimestamp = timestamp;
+		if (dt <= 0.f)
+			return false;
+
+		m_Baseline += (value - m_Baseline) * (1.f - std::exp(-dt / BASELINE_TAU));
+		m_Smoothed += (value - m_Baseline - m_Smoothed) * (1.f - std::exp(-dt / SMOOTH_TAU));
+		m_Amplitude += (std::fabs(m_Smoothed) - m_Amplitude) * (1.f - std::exp(-dt / AMPLITUDE_TAU));
+
+		const float hysteresis = HYSTERESIS_FRACTION * m_Amplitude;
+		if (m_Inhaling) {
+			if (m_Smoothed < -hysteresis)
+				m_Inhaling = false;
+			return false;
+		}
+		if (m_Smoothed <= hysteresis || m_Amplitude <= 0.f)
+			return false;
+
+		m_Inhaling = true;
+		if (!m_HaveBreath) {
+			if (timestamp < m_LastBreath)
+				return false;
+			m_HaveBreath = true;
+			m_LastBreath = timestamp;
+			return true;
+		}
+
+		int64_t interval = timestamp - m_LastBreath;
+		if (interval < MIN_BREATH_INTERVAL_NS)
+			return false;
+		if (m_IntervalCount == m_Window) {
+			m_IntervalSum -= m_Intervals[m_IntervalPosition];
+		} else {
+			m_IntervalCount++;
+		}
+		m_Intervals[m_IntervalPosition] = interval;
+		m_IntervalSum += interval;
+		m_IntervalPosition = (m_IntervalPosition + 1) % m_Window;
+		m_LastBreath = timestamp;
+		UpdateRate();
+		return true;
+	}
+
+	bool BreathDetector::Update(int64_t now, int64_t apneaTimeoutNs) {
+		if (m_IntervalCount == 0 || now - m_LastBreath <= apneaTimeoutNs)
+			return false;
+
+		// The next breath starts a new chain rather than closing a pause
+		// long enough to drag the average down for a whole window.
+		m_IntervalCount = 0;
+		m_IntervalPosition = 0;
+		m_IntervalSum = 0;
+		m_HaveBreath = false;
+		m_LastBreath = now;
+		UpdateRate();
+		return true;
+	}
+
+	void BreathDetector::UpdateRate() {
+		if (m_IntervalCount == 0 || m_IntervalSum <= 0) {
+			m_Rate = 0;
+			m_IntervalAverageMs = 0.f;
+			return;
+		}
+
+		double average = static_cast<double>(m_IntervalSum) / m_IntervalCount;
+		m_IntervalAverageMs = static_cast<float>(average / 1e6);
+		m_Rate = static_cast<uint32_t>(60.0 * NSEC_PER_SEC / average + 0.5);
+	}
+
+	RespirationMonitor::RespirationMonitor(float sampleRate, float decimatedRate, int64_t apneaTimeoutNs)
+	 : m_Decimation(std::max<uint32_t>(1, static_cast<uint32_t>(std::lround(sampleRate / decimatedRate)))),
+	   m_ApneaTimeout(apneaTimeoutNs)
+	{
+		Reset();
+	}
+
+	void RespirationMonitor::Reset() {
+		m_RespSum = 0;
+		m_RespCount = 0;
+		m_RespFirstTimestamp = 0;
+		m_Impedance.Reset();
+		m_Edr.Reset();
+		memset(&m_Snapshot, 0, sizeof(m_Snapshot));
+	}
+
+	void RespirationMonitor::AddSample(int64_t timestamp, EcgFixed resp) {
+		if (m_RespCount == 0)
+			m_RespFirstTimestamp = timestamp;
+		m_RespSum += resp;
+		if (++m_RespCount < m_Decimation)
+			return;
+
+		// The block mean belongs to the middle of the block.
+		m_Impedance.Process(m_RespFirstTimestamp + (timestamp - m_RespFirstTimestamp) / 2,
+				static_cast<float>(m_RespSum) / m_RespCount);
+		m_RespSum = 0;
+		m_RespCount = 0;
+	}
+
+	void RespirationMonitor::AddBeat(int64_t timestamp, float rAmplitude) {
+		m_Edr.Process(timestamp, rAmplitude);
+	}
+
+	bool RespirationMonitor::Update(int64_t now) {
+		m_Impedance.Update(now, m_ApneaTimeout);
+		m_Edr.Update(now, m_ApneaTimeout);
+
+		const BreathDetector* detector = nullptr;
+		RespirationSource source = RespirationSource::NONE;
+		if (m_Impedance.GetAmplitude() >= MIN_IMPEDANCE_AMPLITUDE) {
+			detector = &m_Impedance;
+			source = RespirationSource::IMPEDANCE;
+		} else if (m_Edr.GetRate() > 0) {
+			detector = &m_Edr;
+			source = RespirationSource::EDR;
+		}
+
+		RespirationSnapshot snapshot = {};
+		if (detector) {
+			snapshot.rate = detector->GetRate();
+			snapshot.intervalAverageMs = detector->GetIntervalAverageMs();
+			snapshot.lastBreathTimestamp = detector->GetLastBreathTimestamp();
+			snapshot.source = source;
+		}
+
+		if (snapshot.rate == m_Snapshot.rate && snapshot.source == m_Snapshot.source
+				&& snapshot.lastBreathTimestamp == m_Snapshot.lastBreathTimestamp)
+			return false;
+		m_Snapshot = snapshot;
+		return true;
+	}
+}
@@ -0,0 +1,111 @@
+#ifndef CEE_RESPIRATION_H_
+#define CEE_RESPIRATION_H_
+
+#include <cstdint>
+#include <cstddef>
+
+#include "fixedPoint.hh"
+
+namespace cee {
+	enum class RespirationSource : uint8_t {
+		NONE = 0,
+		IMPEDANCE,    // impedance pneumography on the resp channel
+		EDR           // ECG-derived, from R-peak amplitude modulation
+	};
+
+	const char* GetRespirationSourceName(RespirationSource source);
+
+	struct RespirationSnapshot {
+		uint32_t rate;                 // breaths per minute, 0 when there is none
+		float intervalAverageMs;
+		int64_t lastBreathTimestamp;
+		RespirationSource source;
+	};
+
+	// Finds breaths in a slow, possibly unevenly sampled signal. The input
+	// is detrended and smoothed with time-constant-aware exponential
+	// averages, so the same detector runs on the decimated resp channel and
+	// on one R amplitude per beat. A breath is a rising crossing of a
+	// hysteresis band sized from the running signal amplitude.
+	class BreathDetector {
+	public:
+		static constexpr size_t MAX_WINDOW = 16;
+
+	public:
+		BreathDetector(size_t window = 6);
+		~BreathDetector() = default;
+
+		void Reset();
+
+		// Returns true when `timestamp` starts a new breath.
+		bool Process(int64_t timestamp, float value);
+		// Forgets the breath intervals once none has been seen for the
+		// apnea timeout. Returns true if the rate changed.
+		bool Update(int64_t now, int64_t apneaTimeoutNs);
+
+		uint32_t GetRate() const { return m_Rate; }
+		float GetIntervalAverageMs() const { return m_IntervalAverageMs; }
+		float GetAmplitude() const { return m_Amplitude; }
+		int64_t GetLastBreathTimestamp() const { return m_LastBreath; }
+
+	private:
+		void UpdateRate();
+
+	private:
+		size_t m_Window;
+
+		int64_t m_LastTimestamp;
+		bool m_HaveSample;
+		float m_Baseline;
+		float m_Smoothed;
+		float m_Amplitude;
+		bool m_Inhaling;
+
+		int64_t m_Intervals[MAX_WINDOW];
+		size_t m_IntervalCount;
+		size_t m_IntervalPosition;
+		int64_t m_IntervalSum;
+		int64_t m_LastBreath;
+		bool m_HaveBreath;
+
+		uint32_t m_Rate;
+		float m_IntervalAverageMs;
+	};
+
+	// Respiration rate from the resp channel when it carries a signal, and
+	// from the R-peak amplitudes of the ECG otherwise. The resp channel is
+	// box-car decimated to about 4 Hz before it reaches the detector, so the
+	// per-sample cost is one add; the ECG path sees one value per beat and
+	// so can only follow breathing slower than half the heart rate.
+	class RespirationMonitor {
+	public:
+		RespirationMonitor(float sampleRate, float decimatedRate = 4.f, int64_t apneaTimeoutNs = 20000000000ll);
+		~RespirationMonitor() = default;
+
+		void Reset();
+
+		void AddSample(int64_t timestamp, EcgFixed resp);
+		// `rAmplitude` is the R-peak height above the beat's local mean.
+		void AddBeat(int64_t timestamp, float rAmplitude);
+		// Picks the source and checks for apnea. Returns true if the
+		// snapshot changed.
+		bool Update(int64_t now);
+
+		const RespirationSnapshot& GetSnapshot() const { return m_Snapshot; }
+
+	private:
+		uint32_t m_Decimation;
+		int64_t m_ApneaTimeout;
+
+		int32_t m_RespSum;
+		uint32_t m_RespCount;
+		int64_t m_RespFirstTimestamp;
+
+		BreathDetector m_Impedance;
+		BreathDetector m_Edr;
+
+		RespirationSnapshot m_Snapshot;
+	};
+}
+
+#endif
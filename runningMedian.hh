@@ -0,0 +1,187 @@
+#ifndef CEE_RUNNING_MEDIAN_H_
+#define CEE_RUNNING_MEDIAN_H_
+
+#include <algorithm>
+#include <type_traits>
+#include <vector>
+
+#include <cstdint>
+#include <cstddef>
+
+#include "fixedPoint.hh"
+
+namespace cee {
+	// Median of the last `window` samples in O(log window) per sample. The
+	// window is kept as a max-heap of the lower half and a min-heap of the
+	// upper half meeting at the median, with every sample's heap slot
+	// indexed so the outgoing sample is replaced in place by the incoming
+	// one. All storage is allocated in the constructor.
+	template<typename T>
+	class RunningMedian {
+		static_assert(std::is_arithmetic<T>::value, "T must be an arithmetic type.");
+
+	public:
+		RunningMedian(size_t window)
+		 : m_Window(window > 0 ? static_cast<int32_t>(window) : 1),
+		   m_Values(m_Window), m_Positions(m_Window), m_HeapStorage(m_Window)
+		{
+			// Slot 0 is the median, negative slots the max-heap, positive
+			// slots the min-heap.
+			m_Heap = m_HeapStorage.data() + m_Window / 2;
+			Reset();
+		}
+
+		void Reset() {
+			m_Next = 0;
+			m_Count = 0;
+			std::fill(m_Values.begin(), m_Values.end(), T());
+			for (int32_t i = m_Window - 1; i >= 0; i--) {
+				m_Positions[i] = ((i + 1) / 2) * ((i & 1) ? -1 : 1);
+				m_Heap[m_Positions[i]] = i;
+			}
+		}
+
+		size_t GetWindow() const { return m_Window; }
+
+		T Process(T value) {
+			const int32_t slot = m_Positions[m_Next];
+			const T old = m_Values[m_Next];
+			// Until the window is full the slot is a new leaf rather than a
+			// replacement, so it can only move towards the median.
+			const bool growing = m_Count < m_Window;
+			m_Values[m_Next] = value;
+			m_Next = (m_Next + 1) % m_Window;
+			if (growing)
+				m_Count++;
+
+			if (slot > 0) {
+				if (!growing && old < value) {
+					MinSortDown(slot);
+				} else if (MinSortUp(slot) && MaxCount() > 0 && CompareExchange(0, -1)) {
+					MaxSortDown(-1);
+				}
+			} else if (slot < 0) {
+				if (!growing && value < old) {
+					MaxSortDown(slot);
+				} else if (MaxSortUp(slot) && MinCount() > 0 && CompareExchange(1, 0)) {
+					MinSortDown(1);
+				}
+			} else {
+				if (MaxCount() > 0 && CompareExchange(0, -1)) {
+					MaxSortDown(-1);
+				} else if (MinCount() > 0 && CompareExchange(1, 0)) {
+					MinSortDown(1);
+				}
+			}
+
+			return GetMedian();
+		}
+
+		T GetMedian() const {
+			T median = m_Values[m_Heap[0]];
+			if ((m_Count & 1) == 0)
+				median = (median + m_Values[m_Heap[-1]]) / 2;
+			return median;
+		}
+
+	private:
+		int32_t MinCount() const { return (m_Count - 1) / 2; }
+		int32_t MaxCount() const { return m_Count / 2; }
+
+		bool Less(int32_t i, int32_t j) const {
+			return m_Values[m_Heap[i]] < m_Values[m_Heap[j]];
+		}
+
+		// Swaps slots i and j if i holds the smaller value.
+		bool CompareExchange(int32_t i, int32_t j) {
+			if (!Less(i, j))
+				return false;
+			std::swap(m_Heap[i], m_Heap[j]);
+			m_Positions[m_Heap[i]] = i;
+			m_Positions[m_Heap[j]] = j;
+			return true;
+		}
+
+		// The Up variants return true if the value reached the median slot.
+		bool MinSortUp(int32_t i) {
+			while (i > 0 && CompareExchange(i, i / 2))
+				i /= 2;
+			return i == 0;
+		}
+
+		bool MaxSortUp(int32_t i) {
+			while (i < 0 && CompareExchange(i / 2, i))
+				i /= 2;
+			return i == 0;
+		}
+
+		void MinSortDown(int32_t i) {
+			for (i *= 2; i <= MinCount(); i *= 2) {
+				if (i < MinCount() && Less(i + 1, i))
+					i++;
+				if (!CompareExchange(i, i / 2))
+					break;
+			}
+		}
+
+		void MaxSortDown(int32_t i) {
+			for (i *= 2; i >= -MaxCount(); i *= 2) {
+				if (i > -MaxCount() && Less(i, i - 1))
+					i--;
+				if (!CompareExchange(i / 2, i))
+					break;
+			}
+		}
+
+	private:
+		int32_t m_Window;
+		int32_t m_Next;
+		int32_t m_Count;
+
+		std::vector<T> m_Values;
+		std::vector<int32_t> m_Positions;
+		std::vector<int32_t> m_HeapStorage;
+		int32_t* m_Heap;
+	};
+
+	// Baseline wander removal by two cascaded medians: ~200 ms removes the
+	// QRS and P waves, ~600 ms then removes the T wave, leaving the
+	// baseline, which is subtracted from the input delayed to match.
+	template<DspSample T = float>
+	class BaselineFilter {
+	public:
+		BaselineFilter(float sampleRate)
+		 : m_ShortMedian(OddWindow(0.2f * sampleRate)), m_LongMedian(OddWindow(0.6f * sampleRate)),
+		   m_Delay((m_ShortMedian.GetWindow() - 1) / 2 + (m_LongMedian.GetWindow() - 1) / 2),
+		   m_History(m_Delay + 1, T(0)), m_Position(0)
+		{
+		}
+
+		// Output is for the input GetDelay() samples ago.
+		T Process(T in) {
+			using Accumulator = typename SampleTraits<T>::Accumulator;
+			T baseline = m_LongMedian.Process(m_ShortMedian.Process(in));
+			m_History[m_Position] = in;
+			m_Position = (m_Position + 1) % m_History.size();
+			return SampleTraits<T>::Saturate(Accumulator(m_History[m_Position]) - Accumulator(baseline));
+		}
+
+		size_t GetDelay() const { return m_Delay; }
+
+	private:
+		static size_t OddWindow(float length) {
+			size_t window = static_cast<size_t>(length + 0.5f);
+			return window | 1;
+		}
+
+	private:
+		RunningMedian<T> m_ShortMedian;
+		RunningMedian<T> m_LongMedian;
+		size_t m_Delay;
+		std::vector<T> m_History;
+		size_t m_Position;
+	};
+}
+
+#endif
+
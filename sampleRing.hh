@@ -0,0 +1,108 @@
+#ifndef CEE_SAMPLE_RING_H_
+#define CEE_SAMPLE_RING_H_
+
+#include <algorithm>
+#include <atomic>
+#include <type_traits>
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+namespace cee {
+	// Single-producer/single-consumer ring of samples. The producer never
+	// blocks: once the ring is full the oldest samples are overwritten, and
+	// the consumer detects and drops anything that was overwritten while it
+	// was copying. Additional readers can follow the ring with their own
+	// cursor through ReadSince without affecting the producer.
+	template<typename T, size_t Capacity>
+	class SampleRing {
+		static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two.");
+		static_assert(std::is_trivially_copyable<T>::value, "T must be trivially copyable.");
+
+	public:
+		SampleRing()
+		 : m_Claimed(0), m_Head(0), m_Tail(0)
+		{
+		}
+
+		// Producer only.
+		void Push(const T& sample) {
+			uint64_t head = m_Head.load(std::memory_order_relaxed);
+			m_Claimed.store(head + 1, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+			m_Slots[head & (Capacity - 1)] = sample;
+			m_Head.store(head + 1, std::memory_order_release);
+		}
+
+		// Total number of samples ever pushed; the sequence number of the
+		// next sample.
+		uint64_t GetHead() const {
+			return m_Head.load(std::memory_order_acquire);
+		}
+
+		// Copies the newest `count` samples, oldest first. Returns the number
+		// copied and the sequence number of the first one.
+		size_t Snapshot(T* out, size_t count, uint64_t* firstSequence = nullptr) const {
+			uint64_t head = m_Head.load(std::memory_order_acquire);
+			uint64_t first = head > count ? head - count : 0;
+			return CopyRange(first, head, out, firstSequence);
+		}
+
+		// Consumer only. Copies the samples pushed since the previous call,
+		// oldest first. If more than `maxCount` are pending only the newest
+		// are returned.
+		size_t ReadNew(T* out, size_t maxCount, uint64_t* firstSequence = nullptr) {
+			uint64_t tail = m_Tail.load(std::memory_order_relaxed);
+			uint64_t head = m_Head.load(std::memory_order_acquire);
+			uint64_t first = (head - tail > maxCount) ? head - maxCount : tail;
+			size_t count = CopyRange(first, head, out, firstSequence);
+			m_Tail.store(head, std::memory_order_relaxed);
+			return count;
+		}
+
+		// Like ReadNew, but with a cursor owned by the caller so any number
+		// of readers can follow the ring.
+		size_t ReadSince(uint64_t& cursor, T* out, size_t maxCount, uint64_t* firstSequence = nullptr) const {
+			uint64_t head = m_Head.load(std::memory_order_acquire);
+			uint64_t first = (head - cursor > maxCount) ? head - maxCount : cursor;
+			size_t count = CopyRange(first, head, out, firstSequence);
+			cursor = head;
+			return count;
+		}
+
+	private:
+		size_t CopyRange(uint64_t first, uint64_t last, T* out, uint64_t* firstSequence) const {
+			if (last - first > Capacity)
+				first = last - Capacity;
+
+			for (uint64_t seq = first; seq < last; seq++) {
+				out[seq - first] = m_Slots[seq & (Capacity - 1)];
+			}
+
+			// Any sample the producer claimed a slot over while we copied may
+			// be torn, so only keep the ones that are still intact.
+			std::atomic_thread_fence(std::memory_order_acquire);
+			uint64_t claimed = m_Claimed.load(std::memory_order_relaxed);
+			uint64_t valid = first;
+			if (claimed > Capacity)
+				valid = std::min(std::max(first, claimed - Capacity), last);
+
+			size_t count = static_cast<size_t>(last - valid);
+			if (valid != first)
+				memmove(out, out + (valid - first), count * sizeof(T));
+			if (firstSequence)
+				*firstSequence = valid;
+			return count;
+		}
+
+	private:
+		alignas(64) std::atomic<uint64_t> m_Claimed;
+		std::atomic<uint64_t> m_Head;
+		alignas(64) std::atomic<uint64_t> m_Tail;
+		alignas(64) T m_Slots[Capacity];
+	};
+}
+
+#endif
+
@@ -0,0 +1,169 @@
+#include "sampleSource.hh"
+
+#include <algorithm>
+#include <chrono>
+
+#include <cmath>
+#include <cstdlib>
+
+#include "util.h"
+#include "virtualI2C.hh"
+#include "acquisitionScheduler.hh"
+
+namespace cee {
+	AdcSampleSource::AdcSampleSource(const std::shared_ptr<I2C>& i2c, uint32_t address)
+	 : m_I2CBus(i2c), m_Adc(i2c, ADCType::PCF8591, address)
+	{
+	}
+
+	bool AdcSampleSource::Acquire(int64_t, std::span<uint8_t, 4> samples) {
+		return m_Adc.ReadAllChannels(samples);
+	}
+
+	ReplaySampleSource::ReplaySampleSource(const std::string& filename)
+	 : m_File(nullptr)
+	{
+		m_File = fopen(filename.c_str(), "rb");
+		if (!m_File) {
+			printf("Failed to open replay file \"%s\".\n", filename.c_str());
+		}
+	}
+
+	ReplaySampleSource::~ReplaySampleSource() {
+		if (m_File)
+			fclose(m_File);
+	}
+
+	bool ReplaySampleSource::Acquire(int64_t, std::span<uint8_t, 4> samples) {
+		if (!m_File)
+			return false;
+
+		if (fread(samples.data(), 1, samples.size(), m_File) != samples.size()) {
+			rewind(m_File);
+			if (fread(samples.data(), 1, samples.size(), m_File) != samples.size())
+				return false;
+		}
+		return true;
+	}
+
+	static SyntheticEcgConfig MakeSyntheticConfig(float sampleRate, EcgRhythm rhythm, uint32_t seed) {
+		SyntheticEcgConfig config;
+		config.sampleRate = sampleRate;
+		config.rhythm = rhythm;
+		config.seed = seed;
+		config.noiseAmplitude = 0.004f;
+		config.wanderAmplitude = 0.01f;
+		config.respiratoryModulation = 0.1f;
+		return config;
+	}
+
+	// Scaled so lead III = lead II - lead I, with lead II spanning about half
+	// of the positive code range.
+	static constexpr float SYNTHETIC_LEAD_GAINS[] = { 0.12f, 0.2f, 0.08f };
+
+	static uint8_t VoltsToCode(float value) {
+		// Inverse of the scaling the sensor thread uses to map codes to volts.
+		float code = (value / 0.4f + 1.f) * 0.5f * 255.f;
+		return static_cast<uint8_t>(std::clamp(std::lround(code), 0l, 255l));
+	}
+
+	SyntheticSampleSource::SyntheticSampleSource(float sampleRate, EcgRhythm rhythm, uint32_t seed)
+	 : m_Ecg(MakeSyntheticConfig(sampleRate, rhythm, seed), 1, SYNTHETIC_LEAD_GAINS),
+	   m_Period(static_cast<int64_t>(NSEC_PER_SEC / sampleRate)), m_FrameTime(-1), m_Frame{ 0 }
+	{
+	}
+
+	void SyntheticSampleSource::Advance(size_t frames, int64_t timestamp) {
+		const size_t leads = std::size(SYNTHETIC_LEAD_GAINS);
+		if (m_Leads.size() < frames * leads)
+			m_Leads.resize(frames * leads);
+
+		m_Ecg.Generate(m_Leads.data(), frames);
+		for (size_t lead = 0; lead < leads; lead++) {
+			m_Frame[lead] = VoltsToCode(m_Leads[lead * frames + frames - 1]);
+		}
+
+		float t = static_cast<float>(timestamp % (int64_t(1000) * NSEC_PER_SEC)) / NSEC_PER_SEC;
+		m_Frame[3] = VoltsToCode(0.3f * std::sin(2.f * static_cast<float>(M_PI) * m_Ecg.GetConfig().respirationRate / 60.f * t));
+	}
+
+	uint8_t SyntheticSampleSource::GenerateChannel(uint32_t channel, int64_t timestamp) {
+		if (m_FrameTime < 0) {
+			Advance(1, timestamp);
+			m_FrameTime = timestamp;
+		} else if (timestamp - m_FrameTime >= m_Period) {
+			// Cap the catch-up at one second of samples after a long stall.
+			int64_t frames = std::min<int64_t>((timestamp - m_FrameTime) / m_Period, NSEC_PER_SEC / m_Period);
+			Advance(static_cast<size_t>(frames), timestamp);
+			m_FrameTime = timestamp;
+		}
+		return m_Frame[channel & 0b11];
+	}
+
+	bool SyntheticSampleSource::Acquire(int64_t timestamp, std::span<uint8_t, 4> samples) {
+		Advance(1, timestamp);
+		m_FrameTime = timestamp;
+		std::copy(m_Frame, m_Frame + 4, samples.begin());
+		return true;
+	}
+
+	static int64_t GetMonotonicNs() {
+		timespec now;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		return static_cast<int64_t>(now.tv_sec) * NSEC_PER_SEC + now.tv_nsec;
+	}
+
+	static EcgRhythm ParseRhythm(const std::string& name) {
+		if (name == "tachy")
+			return EcgRhythm::TACHYCARDIA;
+		if (name == "brady")
+			return EcgRhythm::BRADYCARDIA;
+		if (name == "pvc")
+			return EcgRhythm::PVC;
+		if (name == "asystole")
+			return EcgRhythm::ASYSTOLE;
+		return EcgRhythm::SINUS;
+	}
+
+	std::unique_ptr<SampleSource> CreateSampleSource(const std::string& spec, float sampleRate, uint32_t seed) {
+		std::string name = spec.substr(0, spec.find(':'));
+		std::string argument = spec.find(':') == std::string::npos ? "" : spec.substr(spec.find(':') + 1);
+
+		if (name == "pcf8591") {
+			return std::make_unique<AdcSampleSource>(std::make_shared<I2C>(), 0x48);
+		} else if (name == "virtual") {
+			auto latency = std::chrono::microseconds(argument.empty() ? 0 : atoi(argument.c_str()));
+			auto synthetic = std::make_shared<SyntheticSampleSource>(sampleRate);
+			auto bus = std::make_shared<VirtualI2C>(0x48,
+					[synthetic](uint32_t channel) { return synthetic->GenerateChannel(channel, GetMonotonicNs()); },
+					latency, std::chrono::microseconds(90));
+			return std::make_unique<AdcSampleSource>(bus, 0x48);
+		} else if (name == "multi") {
+			auto scheduler = std::make_unique<AcquisitionScheduler>();
+			size_t start = 0;
+			while (start < argument.size()) {
+				size_t end = argument.find(',', start);
+				if (end == std::string::npos)
+					end = argument.size();
+				scheduler->AddBus(std::make_shared<I2C>(argument.substr(start, end - start)));
+				start = end + 1;
+			}
+			if (scheduler->GetDeviceCount() == 0) {
+				printf("No PCF8591 found on \"%s\".\n", argument.c_str());
+				return nullptr;
+			}
+			return scheduler;
+		} else if (name == "replay") {
+			auto source = std::make_unique<ReplaySampleSource>(argument);
+			if (!source->IsOpen())
+				return nullptr;
+			return source;
+		} else if (name == "synthetic") {
+			return std::make_unique<SyntheticSampleSource>(sampleRate, ParseRhythm(argument), seed);
+		}
+
+		printf("Unknown sample source \"%s\".\n", spec.c_str());
+		return nullptr;
+	}
+}
+
@@ -0,0 +1,95 @@
+#ifndef CEE_SAMPLE_SOURCE_H_
+#define CEE_SAMPLE_SOURCE_H_
+
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <cstdint>
+#include <cstdio>
+
+#include "adc.hh"
+#include "i2c.hh"
+#include "syntheticEcg.hh"
+
+namespace cee {
+	// Supplies one frame of raw 8-bit codes for the four ECG channels per
+	// sample period, in cee::EcgChannel order.
+	class SampleSource {
+	public:
+		virtual ~SampleSource() = default;
+
+		virtual bool Acquire(int64_t timestamp, std::span<uint8_t, 4> samples) = 0;
+		virtual const char* GetName() const = 0;
+		virtual void PrintStats(FILE*) const {}
+	};
+
+	// PCF8591 on a real or virtual I2C bus.
+	class AdcSampleSource : public SampleSource {
+	public:
+		AdcSampleSource(const std::shared_ptr<I2C>& i2c, uint32_t address);
+		virtual ~AdcSampleSource() = default;
+
+		virtual bool Acquire(int64_t timestamp, std::span<uint8_t, 4> samples) override;
+		virtual const char* GetName() const override { return "pcf8591"; }
+
+	private:
+		std::shared_ptr<I2C> m_I2CBus;
+		ADC m_Adc;
+	};
+
+	// Replays a file of interleaved 4-byte frames, looping at the end.
+	class ReplaySampleSource : public SampleSource {
+	public:
+		ReplaySampleSource(const std::string& filename);
+		virtual ~ReplaySampleSource();
+
+		bool IsOpen() const { return m_File != nullptr; }
+
+		virtual bool Acquire(int64_t timestamp, std::span<uint8_t, 4> samples) override;
+		virtual const char* GetName() const override { return "replay"; }
+
+	private:
+		FILE* m_File;
+	};
+
+	// Synthetic three-lead ECG plus a respiration sine, quantised like the
+	// PCF8591 would. Sources with different seeds give different patients.
+	class SyntheticSampleSource : public SampleSource {
+	public:
+		SyntheticSampleSource(float sampleRate, EcgRhythm rhythm = EcgRhythm::SINUS, uint32_t seed = 1);
+		virtual ~SyntheticSampleSource() = default;
+
+		// Random access for the virtual bus: advances the generator to
+		// `timestamp` and returns the channel from the current frame.
+		uint8_t GenerateChannel(uint32_t channel, int64_t timestamp);
+
+		virtual bool Acquire(int64_t timestamp, std::span<uint8_t, 4> samples) override;
+		virtual const char* GetName() const override { return "synthetic"; }
+
+	private:
+		void Advance(size_t frames, int64_t timestamp);
+
+	private:
+		SyntheticEcg m_Ecg;
+		int64_t m_Period;
+		int64_t m_FrameTime;
+		uint8_t m_Frame[4];
+		std::vector<float> m_Leads;
+	};
+
+	// Builds a source from a command line spec:
+	//   pcf8591                  PCF8591 at 0x48 on /dev/i2c-1
+	//   virtual[:latencyUs]      emulated PCF8591 fed by the synthetic source
+	//   multi:<bus>[,<bus>...]   every PCF8591 found on the listed buses
+	//   replay:<file>            raw frame file
+	//   synthetic[:rhythm]       synthetic ECG, rhythm is one of sinus, tachy,
+	//                            brady, pvc or asystole
+	// Returns nullptr if the spec is unknown or the source cannot be opened.
+	// `seed` picks the synthetic patient.
+	std::unique_ptr<SampleSource> CreateSampleSource(const std::string& spec, float sampleRate, uint32_t seed = 1);
+}
+
+#endif
+
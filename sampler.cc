@@ -0,0 +1,141 @@
+#include "sampler.hh"
+
+#include <cmath>
+#include <cstring>
+#include <ctime>
+#include <cerrno>
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+
+#include "util.h"
+
+namespace cee {
+	static int64_t TimespecToNs(const timespec& ts) {
+		return static_cast<int64_t>(ts.tv_sec) * NSEC_PER_SEC + ts.tv_nsec;
+	}
+
+	static timespec NsToTimespec(int64_t ns) {
+		timespec ts;
+		ts.tv_sec = ns / NSEC_PER_SEC;
+		ts.tv_nsec = ns % NSEC_PER_SEC;
+		return ts;
+	}
+
+	Sampler::Sampler(std::chrono::duration<double, std::nano> period, bool realtime, int32_t priority, bool lockMemory)
+	 : m_Period(period), m_Realtime(realtime), m_Priority(priority), m_LockMemory(lockMemory),
+	   m_Samples(0), m_Overruns(0), m_SkippedDeadlines(0), m_MaxLatencyNs(0)
+	{
+		for (auto&& bucket : m_JitterHistogram)
+			bucket.store(0, std::memory_order_relaxed);
+	}
+
+	void Sampler::ConfigureThread() {
+		if (m_LockMemory) {
+			if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+				printf("Sampler WARNING: mlockall failed (%s)\n", strerror(errno));
+			}
+		}
+
+		if (m_Realtime) {
+			sched_param param;
+			memset(&param, 0, sizeof(param));
+			param.sched_priority = m_Priority;
+			int ec = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+			if (ec != 0) {
+				printf("Sampler WARNING: failed to set SCHED_FIFO priority %d (%s)\n", m_Priority, strerror(ec));
+			}
+		}
+		fflush(stdout);
+	}
+
+	void Sampler::Run(const std::atomic<bool>& terminate, const Callback& callback) {
+		ConfigureThread();
+
+		const double periodNs = m_Period.count();
+		timespec now;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		const int64_t startNs = TimespecToNs(now);
+
+		// Deadlines are computed from the start time rather than accumulated
+		// so rounding of a fractional period never builds up.
+		uint64_t tick = 0;
+		while (!terminate.load(std::memory_order_relaxed)) {
+			int64_t deadlineNs = startNs + static_cast<int64_t>(std::llround(tick * periodNs));
+			timespec deadline = NsToTimespec(deadlineNs);
+			while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, nullptr) == EINTR) {
+				if (terminate.load(std::memory_order_relaxed))
+					return;
+			}
+
+			clock_gettime(CLOCK_MONOTONIC, &now);
+			int64_t wokenNs = TimespecToNs(now);
+			RecordLatency(wokenNs - deadlineNs);
+
+			callback(wokenNs);
+			m_Samples.fetch_add(1, std::memory_order_relaxed);
+
+			// If the callback ran past the next deadline, skip the missed
+			// periods instead of bursting to catch up.
+			tick++;
+			clock_gettime(CLOCK_MONOTONIC, &now);
+			int64_t doneNs = TimespecToNs(now);
+			int64_t nextNs = startNs + static_cast<int64_t>(std::llround(tick * periodNs));
+			if (doneNs > nextNs) {
+				m_Overruns.fetch_add(1, std::memory_order_relaxed);
+				uint64_t missed = static_cast<uint64_t>((doneNs - nextNs) / periodNs) + 1;
+				m_SkippedDeadlines.fetch_add(missed, std::memory_order_relaxed);
+				tick += missed;
+			}
+		}
+	}
+
+	void Sampler::RecordLatency(int64_t latencyNs) {
+		if (latencyNs < 0)
+			latencyNs = 0;
+
+		int64_t latencyUs = latencyNs / 1000;
+		size_t bucket = 0;
+		while (latencyUs > 0 && bucket < SAMPLER_JITTER_BUCKETS - 1) {
+			latencyUs >>= 1;
+			bucket++;
+		}
+		m_JitterHistogram[bucket].fetch_add(1, std::memory_order_relaxed);
+
+		// Only the sampler thread writes, so a plain compare is enough.
+		if (latencyNs > m_MaxLatencyNs.load(std::memory_order_relaxed))
+			m_MaxLatencyNs.store(latencyNs, std::memory_order_relaxed);
+	}
+
+	SamplerStats Sampler::GetStats() const {
+		SamplerStats stats;
+		stats.samples = m_Samples.load(std::memory_order_relaxed);
+		stats.overruns = m_Overruns.load(std::memory_order_relaxed);
+		stats.skippedDeadlines = m_SkippedDeadlines.load(std::memory_order_relaxed);
+		stats.maxLatencyNs = m_MaxLatencyNs.load(std::memory_order_relaxed);
+		for (size_t i = 0; i < SAMPLER_JITTER_BUCKETS; i++)
+			stats.jitterHistogram[i] = m_JitterHistogram[i].load(std::memory_order_relaxed);
+		return stats;
+	}
+
+	void Sampler::PrintStats(FILE* stream) const {
+		SamplerStats stats = GetStats();
+		fprintf(stream, "Sampler: %llu samples, %llu overruns, %llu skipped deadlines, max latency %lld us\n",
+				static_cast<unsigned long long>(stats.samples),
+				static_cast<unsigned long long>(stats.overruns),
+				static_cast<unsigned long long>(stats.skippedDeadlines),
+				static_cast<long long>(stats.maxLatencyNs / 1000));
+		for (size_t i = 0; i < SAMPLER_JITTER_BUCKETS; i++) {
+			if (i == SAMPLER_JITTER_BUCKETS - 1) {
+				fprintf(stream, "  >= %6u us: %llu\n", 1u << (i - 1),
+						static_cast<unsigned long long>(stats.jitterHistogram[i]));
+			} else {
+				fprintf(stream, "  <  %6u us: %llu\n", 1u << i,
+						static_cast<unsigned long long>(stats.jitterHistogram[i]));
+			}
+		}
+		fflush(stream);
+	}
+}
+
@@ -0,0 +1,61 @@
+#ifndef CEE_SAMPLER_H_
+#define CEE_SAMPLER_H_
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <functional>
+
+#include <cstdint>
+#include <cstdio>
+
+namespace cee {
+	// Wake-up latency buckets in microseconds: [0,1), [1,2), [2,4), ... and
+	// a final bucket for everything above 2^14 us.
+	constexpr size_t SAMPLER_JITTER_BUCKETS = 16;
+
+	struct SamplerStats {
+		uint64_t samples;
+		uint64_t overruns;
+		uint64_t skippedDeadlines;
+		int64_t maxLatencyNs;
+		std::array<uint64_t, SAMPLER_JITTER_BUCKETS> jitterHistogram;
+	};
+
+	// Calls a callback on absolute CLOCK_MONOTONIC deadlines so the sample
+	// rate does not drift with the time spent in the callback.
+	class Sampler {
+	public:
+		// Called once per period with the CLOCK_MONOTONIC time in
+		// nanoseconds at which the thread actually woke up.
+		using Callback = std::function<void(int64_t timestampNs)>;
+
+	public:
+		Sampler(std::chrono::duration<double, std::nano> period, bool realtime = false, int32_t priority = 80, bool lockMemory = false);
+		~Sampler() = default;
+
+		void Run(const std::atomic<bool>& terminate, const Callback& callback);
+
+		SamplerStats GetStats() const;
+		void PrintStats(FILE* stream) const;
+
+	private:
+		void ConfigureThread();
+		void RecordLatency(int64_t latencyNs);
+
+	private:
+		std::chrono::duration<double, std::nano> m_Period;
+		bool m_Realtime;
+		int32_t m_Priority;
+		bool m_LockMemory;
+
+		std::atomic<uint64_t> m_Samples;
+		std::atomic<uint64_t> m_Overruns;
+		std::atomic<uint64_t> m_SkippedDeadlines;
+		std::atomic<int64_t> m_MaxLatencyNs;
+		std::array<std::atomic<uint64_t>, SAMPLER_JITTER_BUCKETS> m_JitterHistogram;
+	};
+}
+
+#endif
+
@@ -0,0 +1,127 @@
+#include "signalQuality.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace cee {
+	// Moments are taken on the sample with its low fraction bits dropped so
+	// the fourth-power sum can't overflow even for saturated input.
+	constexpr int MOMENT_SHIFT = 4;
+	// Codes 0 and 255, where an open input sits.
+	constexpr EcgFixed RAIL_LOW = AdcCodeToFixed(static_cast<uint8_t>(0));
+	constexpr EcgFixed RAIL_HIGH = AdcCodeToFixed(static_cast<uint8_t>(255));
+	// Two ADC codes of standard deviation, in shifted units squared. Input
+	// noise alone stays below this, so asystole reads as flat rather than
+	// as a noisy signal.
+	constexpr double FLAT_DEVIATION = 2.0 * ECG_FIXED_ONE / (1 << MOMENT_SHIFT);
+	constexpr double FLAT_VARIANCE = FLAT_DEVIATION * FLAT_DEVIATION;
+	constexpr float LEAD_OFF_SATURATION = 0.5f;
+	// A fifth of the window at a rail takes the score to zero.
+	constexpr float SATURATION_PENALTY = 5.f;
+	// Gaussian noise has a kurtosis of 3 and clean ECG well above 5.
+	constexpr float NOISE_KURTOSIS = 3.f;
+	constexpr float ECG_KURTOSIS = 5.f;
+	// White noise gives 6; the QRS alone keeps clean ECG around 1-2.
+	constexpr float CLEAN_HF_NOISE = 2.5f;
+	constexpr float NOISY_HF_NOISE = 5.f;
+	// Below this rate the QRS is a sample or two wide and its second
+	// difference looks like white noise, so only kurtosis is scored.
+	constexpr float HF_NOISE_MIN_SAMPLE_RATE = 150.f;
+
+	SignalQualityMonitor::SignalQualityMonitor(float sampleRate, float windowSeconds)
+	 : m_ScoreHfNoise(sampleRate >= HF_NOISE_MIN_SAMPLE_RATE)
+	{
+		m_Window.resize(std::max<size_t>(4, static_cast<size_t>(std::lround(sampleRate * windowSeconds))));
+		Reset();
+	}
+
+	void SignalQualityMonitor::Reset() {
+		std::fill(m_Window.begin(), m_Window.end(), Entry{ 0, 0, false });
+		m_Position = 0;
+		m_Count = 0;
+		m_Previous[0] = m_Previous[1] = 0;
+		m_History = 0;
+		m_Sum = m_Sum2 = m_Sum3 = m_Sum4 = 0;
+		m_DifferenceSum2 = 0;
+		m_RailCount = 0;
+		memset(&m_Quality, 0, sizeof(m_Quality));
+	}
+
+	const SignalQuality& SignalQualityMonitor::Process(EcgFixed raw, EcgFixed filtered) {
+		Entry& entry = m_Window[m_Position];
+		if (m_Count == m_Window.size()) {
+			int64_t x = entry.value;
+			int64_t x2 = x * x;
+			m_Sum -= x;
+			m_Sum2 -= x2;
+			m_Sum3 -= x2 * x;
+			m_Sum4 -= x2 * x2;
+			m_DifferenceSum2 -= static_cast<int64_t>(entry.secondDifference) * entry.secondDifference;
+			m_RailCount -= entry.railed;
+		} else {
+			m_Count++;
+		}
+
+		const EcgFixed value = static_cast<EcgFixed>(filtered >> MOMENT_SHIFT);
+		int32_t secondDifference = 0;
+		if (m_History >= 2) {
+			secondDifference = value - 2 * m_Previous[0] + m_Previous[1];
+		} else {
+			m_History++;
+		}
+		m_Previous[1] = m_Previous[0];
+		m_Previous[0] = value;
+
+		entry.value = value;
+		entry.secondDifference = secondDifference;
+		entry.railed = raw <= RAIL_LOW || raw >= RAIL_HIGH;
+		m_Position = (m_Position + 1) % m_Window.size();
+
+		int64_t x = value;
+		int64_t x2 = x * x;
+		m_Sum += x;
+		m_Sum2 += x2;
+		m_Sum3 += x2 * x;
+		m_Sum4 += x2 * x2;
+		m_DifferenceSum2 += static_cast<int64_t>(secondDifference) * secondDifference;
+		m_RailCount += entry.railed;
+
+		UpdateQuality();
+		return m_Quality;
+	}
+
+	void SignalQualityMonitor::UpdateQuality() {
+		const double n = static_cast<double>(m_Count);
+		const double mean = m_Sum / n;
+		const double m2 = m_Sum2 / n;
+		const double variance = m2 - mean * mean;
+
+		m_Quality.saturation = static_cast<float>(m_RailCount / n);
+		m_Quality.flat = variance < FLAT_VARIANCE;
+		m_Quality.leadOff = m_Quality.saturation >= LEAD_OFF_SATURATION;
+		const float saturation = m_Quality.leadOff ? 0.f : 1.f - std::min(1.f, m_Quality.saturation * SATURATION_PENALTY);
+		if (m_Quality.flat) {
+			// Without a lead-off comparator a flat line can't be told from
+			// asystole, so it is left to the rhythm analysis rather than
+			// scored as unusable. The detector finds no beats in it, as no
+			// peak clears QRS_MIN_PEAK.
+			m_Quality.hfNoise = 0.f;
+			m_Quality.kurtosis = 0.f;
+			m_Quality.score = static_cast<uint8_t>(std::lround(100.f * saturation));
+			return;
+		}
+
+		// Central fourth moment from the raw power sums.
+		const double m3 = m_Sum3 / n;
+		const double m4 = m_Sum4 / n;
+		const double mean2 = mean * mean;
+		const double central4 = m4 - 4.0 * mean * m3 + 6.0 * mean2 * m2 - 3.0 * mean2 * mean2;
+		m_Quality.kurtosis = static_cast<float>(central4 / (variance * variance));
+		m_Quality.hfNoise = static_cast<float>(m_DifferenceSum2 / n / variance);
+
+		float kurtosis = std::clamp((m_Quality.kurtosis - NOISE_KURTOSIS) / (ECG_KURTOSIS - NOISE_KURTOSIS), 0.f, 1.f);
+		float hfNoise = !m_ScoreHfNoise ? 1.f : std::clamp((NOISY_HF_NOISE - m_Quality.hfNoise) / (NOISY_HF_NOISE - CLEAN_HF_NOISE), 0.f, 1.f);
+		m_Quality.score = static_cast<uint8_t>(std::lround(100.f * saturation * kurtosis * hfNoise));
+	}
+}
@@ -0,0 +1,72 @@
+#ifndef CEE_SIGNAL_QUALITY_H_
+#define CEE_SIGNAL_QUALITY_H_
+
+#include <vector>
+
+#include <cstdint>
+#include <cstddef>
+
+#include "fixedPoint.hh"
+
+namespace cee {
+	struct SignalQuality {
+		uint8_t score;        // 0-100, 0 when the lead is off
+		bool leadOff;
+		float saturation;     // fraction of the window stuck at a rail
+		bool flat;
+		float hfNoise;        // second-difference energy over signal variance
+		float kurtosis;       // ECG is spiky (> 5); noise and hum are not
+	};
+
+	// Streaming signal quality for one ECG channel over a sliding window
+	// (2 s by default). Every statistic is a running integer sum over the
+	// window ring, so each sample costs O(1) whatever the window length.
+	// The front end has no lead-off comparator; an open electrode pulls its
+	// input to a rail, and a window mostly at a rail is flagged as lead off.
+	// A flat line is reported but not scored down, since it may be asystole;
+	// the QRS detector's minimum peak keeps it from finding beats in one.
+	class SignalQualityMonitor {
+	public:
+		SignalQualityMonitor(float sampleRate, float windowSeconds = 2.f);
+		~SignalQualityMonitor() = default;
+
+		void Reset();
+
+		// `raw` is the channel as converted from the ADC, used for rail
+		// detection; `filtered` is the same sample with baseline wander
+		// removed (or `raw` again), used for the shape statistics.
+		const SignalQuality& Process(EcgFixed raw, EcgFixed filtered);
+
+		const SignalQuality& GetQuality() const { return m_Quality; }
+
+	private:
+		void UpdateQuality();
+
+	private:
+		struct Entry {
+			EcgFixed value;
+			int32_t secondDifference;
+			bool railed;
+		};
+
+		bool m_ScoreHfNoise;
+
+		std::vector<Entry> m_Window;
+		size_t m_Position;
+		size_t m_Count;
+
+		EcgFixed m_Previous[2];
+		uint32_t m_History;
+
+		int64_t m_Sum;
+		int64_t m_Sum2;
+		int64_t m_Sum3;
+		int64_t m_Sum4;
+		int64_t m_DifferenceSum2;
+		uint32_t m_RailCount;
+
+		SignalQuality m_Quality;
+	};
+}
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef CEE_SNAPSHOT_H_
+#define CEE_SNAPSHOT_H_
+
+#include <atomic>
+#include <type_traits>
+
+#include <cstdint>
+
+namespace cee {
+	// Single-writer value that readers copy without locking. The writer
+	// never waits; a reader that races with a publish retries its copy.
+	template<typename T>
+	class Snapshot {
+		static_assert(std::is_trivially_copyable<T>::value, "T must be trivially copyable.");
+
+	public:
+		Snapshot()
+		 : m_Version(0), m_Value{}
+		{
+		}
+
+		// Writer only.
+		void Publish(const T& value) {
+			uint64_t version = m_Version.load(std::memory_order_relaxed);
+			m_Version.store(version + 1, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+			m_Value = value;
+			m_Version.store(version + 2, std::memory_order_release);
+		}
+
+		T Read() const {
+			for (;;) {
+				uint64_t before = m_Version.load(std::memory_order_acquire);
+				if (before & 1)
+					continue;
+
+				T value = m_Value;
+				std::atomic_thread_fence(std::memory_order_acquire);
+				if (m_Version.load(std::memory_order_relaxed) == before)
+					return value;
+			}
+		}
+
+		// Increases by two on every publish.
+		uint64_t GetVersion() const {
+			return m_Version.load(std::memory_order_acquire);
+		}
+
+	private:
+		alignas(64) std::atomic<uint64_t> m_Version;
+		T m_Value;
+	};
+}
+
+#endif
+
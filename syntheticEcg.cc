@@ -0,0 +1,211 @@
+#include "syntheticEcg.hh"
+
+#include <algorithm>
+#include <cmath>
+
+namespace cee {
+	// Beat tables cover one second (one beat at 60 bpm), with one guard entry
+	// so interpolation never reads past the end.
+	static constexpr uint32_t BEAT_TABLE_SIZE = 1024;
+	static constexpr uint32_t SINE_TABLE_BITS = 10;
+	static constexpr uint32_t SINE_TABLE_SIZE = 1 << SINE_TABLE_BITS;
+
+	struct Wave {
+		float amplitude;
+		float center;
+		float width;
+	};
+
+	static void BuildBeat(std::vector<float>& table, std::span<const Wave> waves) {
+		table.assign(BEAT_TABLE_SIZE + 1, 0.f);
+		for (uint32_t i = 0; i <= BEAT_TABLE_SIZE; i++) {
+			float t = static_cast<float>(i) / BEAT_TABLE_SIZE;
+			float value = 0.f;
+			for (auto&& wave : waves) {
+				float x = (t - wave.center) / wave.width;
+				value += wave.amplitude * std::exp(-0.5f * x * x);
+			}
+			table[i] = value;
+		}
+	}
+
+	// Counter based hash so noise for sample n does not depend on sample
+	// n - 1, which keeps the per-sample loop vectorisable.
+	static inline float HashNoise(uint32_t key) {
+		key ^= key >> 16;
+		key *= 0x7feb352du;
+		key ^= key >> 15;
+		key *= 0x846ca68bu;
+		key ^= key >> 16;
+		return static_cast<float>(key) * (2.f / 4294967296.f) - 1.f;
+	}
+
+	float SyntheticEcg::GetDefaultHeartRate(EcgRhythm rhythm) {
+		switch (rhythm) {
+		case EcgRhythm::TACHYCARDIA: return 160.f;
+		case EcgRhythm::BRADYCARDIA: return 40.f;
+		default: return 72.f;
+		}
+	}
+
+	SyntheticEcg::SyntheticEcg(const SyntheticEcgConfig& config, size_t patients, std::span<const float> leadGains)
+	 : m_Config(config), m_HeartRate(config.heartRate), m_LeadGains(leadGains.begin(), leadGains.end())
+	{
+		if (m_HeartRate <= 0.f)
+			m_HeartRate = GetDefaultHeartRate(m_Config.rhythm);
+		if (m_LeadGains.empty())
+			m_LeadGains.push_back(1.f);
+
+		static constexpr Wave normalWaves[] = {
+			{  0.15f, 0.16f, 0.025f }, // P
+			{ -0.12f, 0.27f, 0.008f }, // Q
+			{  1.00f, 0.30f, 0.010f }, // R
+			{ -0.25f, 0.33f, 0.010f }, // S
+			{  0.30f, 0.58f, 0.045f }  // T
+		};
+		static constexpr Wave pvcWaves[] = {
+			{  1.20f, 0.30f, 0.035f },
+			{ -0.50f, 0.38f, 0.030f },
+			{ -0.40f, 0.60f, 0.060f }
+		};
+		BuildBeat(m_NormalBeat, normalWaves);
+		BuildBeat(m_PvcBeat, pvcWaves);
+		m_FlatBeat.assign(BEAT_TABLE_SIZE + 1, 0.f);
+
+		m_SineTable.resize(SINE_TABLE_SIZE);
+		for (uint32_t i = 0; i < SINE_TABLE_SIZE; i++) {
+			m_SineTable[i] = std::sin(2.f * static_cast<float>(M_PI) * i / SINE_TABLE_SIZE);
+		}
+		m_WanderStep = static_cast<uint32_t>(m_Config.wanderFrequency / m_Config.sampleRate * 4294967296.0);
+		m_RespirationStep = static_cast<uint32_t>(m_Config.respirationRate / 60.f / m_Config.sampleRate * 4294967296.0);
+
+		m_Patients.resize(patients);
+		for (size_t i = 0; i < patients; i++) {
+			PatientState& patient = m_Patients[i];
+			patient.rng.seed(m_Config.seed + static_cast<uint32_t>(i) * 7919u);
+			patient.compensatoryPause = false;
+			patient.sampleIndex = 0;
+			patient.wanderPhase = static_cast<uint32_t>(patient.rng());
+			patient.respirationPhase = static_cast<uint32_t>(patient.rng());
+			patient.tablePosition = 0.f;
+			patient.tableStep = 1.f;
+			StartBeat(patient);
+			// Stagger patients so they do not all beat in phase.
+			patient.tablePosition = static_cast<float>(patient.rng() % BEAT_TABLE_SIZE);
+		}
+		m_LeadOffRemaining.assign(GetChannelCount(), 0);
+	}
+
+	void SyntheticEcg::StartBeat(PatientState& patient) {
+		float rr = 60.f / m_HeartRate;
+		if (m_Config.heartRateVariability > 0.f) {
+			std::normal_distribution<float> variability(1.f, m_Config.heartRateVariability);
+			rr *= std::clamp(variability(patient.rng), 0.5f, 1.5f);
+		}
+
+		patient.beat = m_NormalBeat.data();
+		if (m_Config.rhythm == EcgRhythm::ASYSTOLE) {
+			patient.beat = m_FlatBeat.data();
+		} else if (patient.compensatoryPause) {
+			// The sinus beat after a PVC arrives late enough that the pair
+			// spans two normal RR intervals.
+			rr *= 1.4f;
+			patient.compensatoryPause = false;
+		} else if (m_Config.rhythm == EcgRhythm::PVC) {
+			std::uniform_real_distribution<float> chance(0.f, 1.f);
+			if (chance(patient.rng) < m_Config.pvcProbability) {
+				patient.beat = m_PvcBeat.data();
+				patient.compensatoryPause = true;
+				rr *= 0.6f;
+			}
+		}
+
+		float newStep = BEAT_TABLE_SIZE / (rr * m_Config.sampleRate);
+		// Carry the overshoot past the end of the last beat into the new one.
+		float overshoot = std::max(patient.tablePosition - BEAT_TABLE_SIZE, 0.f);
+		if (patient.tablePosition > 0.f)
+			overshoot = overshoot / patient.tableStep * newStep;
+		patient.tablePosition = overshoot;
+		patient.tableStep = newStep;
+	}
+
+	void SyntheticEcg::GenerateClean(PatientState& patient, float* out, size_t count) {
+		size_t done = 0;
+		while (done < count) {
+			if (patient.tablePosition >= BEAT_TABLE_SIZE)
+				StartBeat(patient);
+
+			size_t remaining = static_cast<size_t>(std::ceil((BEAT_TABLE_SIZE - patient.tablePosition) / patient.tableStep));
+			size_t n = std::min(remaining, count - done);
+			const float* beat = patient.beat;
+			float position = patient.tablePosition;
+			float step = patient.tableStep;
+			float* dst = out + done;
+			for (size_t i = 0; i < n; i++) {
+				float p = position + static_cast<float>(i) * step;
+				uint32_t index = std::min(static_cast<uint32_t>(p), BEAT_TABLE_SIZE - 1);
+				float fraction = p - static_cast<float>(index);
+				dst[i] = beat[index] + fraction * (beat[index + 1] - beat[index]);
+			}
+			patient.tablePosition = position + static_cast<float>(n) * step;
+			done += n;
+		}
+	}
+
+	void SyntheticEcg::Generate(float* out, size_t count) {
+		if (m_Clean.size() < count)
+			m_Clean.resize(count);
+
+		const size_t leads = m_LeadGains.size();
+		const float noise = m_Config.noiseAmplitude;
+		const float wander = m_Config.wanderAmplitude;
+		const float* sine = m_SineTable.data();
+		const float leadOffChance = m_Config.leadOffRate * count / m_Config.sampleRate;
+		const uint32_t leadOffSamples = static_cast<uint32_t>(m_Config.leadOffDuration * m_Config.sampleRate);
+		std::uniform_real_distribution<float> chance(0.f, 1.f);
+
+		for (size_t p = 0; p < m_Patients.size(); p++) {
+			PatientState& patient = m_Patients[p];
+			float* clean = m_Clean.data();
+			GenerateClean(patient, clean, count);
+			if (m_Config.respiratoryModulation > 0.f) {
+				// Breathing moves the heart's electrical axis, which shows up
+				// as a slow swing in QRS amplitude on every lead.
+				const float modulation = m_Config.respiratoryModulation;
+				for (size_t i = 0; i < count; i++) {
+					uint32_t phase = patient.respirationPhase + static_cast<uint32_t>(i) * m_RespirationStep;
+					clean[i] *= 1.f + modulation * sine[phase >> (32 - SINE_TABLE_BITS)];
+				}
+			}
+
+			for (size_t lead = 0; lead < leads; lead++) {
+				size_t channel = p * leads + lead;
+				float* dst = out + channel * count;
+
+				if (leadOffChance > 0.f && m_LeadOffRemaining[channel] == 0 && chance(patient.rng) < leadOffChance)
+					m_LeadOffRemaining[channel] = leadOffSamples;
+				if (m_LeadOffRemaining[channel] > 0) {
+					std::fill(dst, dst + count, m_Config.leadOffLevel);
+					m_LeadOffRemaining[channel] -= std::min<uint32_t>(m_LeadOffRemaining[channel], count);
+					continue;
+				}
+
+				const float gain = m_LeadGains[lead];
+				const uint32_t noiseKey = static_cast<uint32_t>(patient.sampleIndex) + static_cast<uint32_t>(channel) * 0x9e3779b9u + m_Config.seed;
+				const uint32_t wanderPhase = patient.wanderPhase;
+				const uint32_t wanderStep = m_WanderStep;
+				for (size_t i = 0; i < count; i++) {
+					uint32_t phase = wanderPhase + static_cast<uint32_t>(i) * wanderStep;
+					dst[i] = gain * clean[i]
+						+ wander * sine[phase >> (32 - SINE_TABLE_BITS)]
+						+ noise * HashNoise(noiseKey + static_cast<uint32_t>(i));
+				}
+			}
+
+			patient.wanderPhase += static_cast<uint32_t>(count) * m_WanderStep;
+			patient.respirationPhase += static_cast<uint32_t>(count) * m_RespirationStep;
+			patient.sampleIndex += count;
+		}
+	}
+}
+
@@ -0,0 +1,90 @@
+#ifndef CEE_SYNTHETIC_ECG_H_
+#define CEE_SYNTHETIC_ECG_H_
+
+#include <random>
+#include <span>
+#include <vector>
+
+#include <cstdint>
+#include <cstddef>
+
+namespace cee {
+	enum class EcgRhythm {
+		SINUS = 0,
+		TACHYCARDIA,
+		BRADYCARDIA,
+		PVC,
+		ASYSTOLE
+	};
+
+	struct SyntheticEcgConfig {
+		float sampleRate = 1000.f;
+		EcgRhythm rhythm = EcgRhythm::SINUS;
+		float heartRate = 0.f;               // bpm, 0 uses the rhythm's default
+		float heartRateVariability = 0.05f;  // RR standard deviation as a fraction of the mean
+		float pvcProbability = 0.15f;        // EcgRhythm::PVC only
+		float noiseAmplitude = 0.01f;
+		float wanderAmplitude = 0.05f;
+		float wanderFrequency = 0.3f;        // Hz
+		float respirationRate = 15.f;        // breaths per minute
+		float respiratoryModulation = 0.f;   // QRS amplitude swing with breathing, as a fraction
+		float leadOffRate = 0.f;             // lead-off events per second per lead
+		float leadOffDuration = 2.f;         // seconds
+		float leadOffLevel = -2.f;
+		uint32_t seed = 1;
+	};
+
+	// Table-driven ECG generator for load testing and deterministic input.
+	// One beat of each morphology is precomputed at 60 bpm and stretched to
+	// every new RR interval, so per-sample cost is a table lookup plus noise.
+	//
+	// Output is structure-of-arrays: channel c of a batch of n samples is
+	// out[c * n .. c * n + n), where c = patient * leads + lead.
+	class SyntheticEcg {
+	public:
+		SyntheticEcg(const SyntheticEcgConfig& config, size_t patients = 1, std::span<const float> leadGains = {});
+		~SyntheticEcg() = default;
+
+		const SyntheticEcgConfig& GetConfig() const { return m_Config; }
+		size_t GetChannelCount() const { return m_Patients.size() * m_LeadGains.size(); }
+		bool IsLeadOff(size_t channel) const { return m_LeadOffRemaining[channel] > 0; }
+
+		void Generate(float* out, size_t count);
+
+		static float GetDefaultHeartRate(EcgRhythm rhythm);
+
+	private:
+		struct PatientState {
+			float tablePosition;
+			float tableStep;
+			const float* beat;
+			bool compensatoryPause;
+			uint32_t wanderPhase;
+			uint32_t respirationPhase;
+			uint64_t sampleIndex;
+			std::minstd_rand rng;
+		};
+
+		void StartBeat(PatientState& patient);
+		void GenerateClean(PatientState& patient, float* out, size_t count);
+
+	private:
+		SyntheticEcgConfig m_Config;
+		float m_HeartRate;
+		std::vector<float> m_LeadGains;
+		std::vector<PatientState> m_Patients;
+		std::vector<uint32_t> m_LeadOffRemaining;
+
+		std::vector<float> m_NormalBeat;
+		std::vector<float> m_PvcBeat;
+		std::vector<float> m_FlatBeat;
+		std::vector<float> m_SineTable;
+		uint32_t m_WanderStep;
+		uint32_t m_RespirationStep;
+
+		std::vector<float> m_Clean;
+	};
+}
+
+#endif
+
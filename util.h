@@ -22,8 +22,10 @@
 #error "Wrong Endian"
 #endif
 
-#define NSEC_PER_SEC 1000000000l
-#define USEC_PER_SEC 1000000l
+// 64-bit so products like 60 * NSEC_PER_SEC cannot overflow where long is
+// 32 bits.
+#define NSEC_PER_SEC INT64_C(1000000000)
+#define USEC_PER_SEC INT64_C(1000000)
 
 #if defined(__cplusplus)
 extern "C" {
@@ -0,0 +1,78 @@
+#include "virtualI2C.hh"
+
+#include <thread>
+
+namespace cee {
+	VirtualI2C::VirtualI2C(uint32_t address, const InputCallback& input,
+			std::chrono::microseconds transactionLatency, std::chrono::microseconds byteLatency)
+	 : I2C(-1), m_Address(address), m_Input(input), m_TransactionLatency(transactionLatency),
+	   m_ByteLatency(byteLatency), m_ControlByte(0), m_Channel(0), m_LastConversion(0x80)
+	{
+	}
+
+	bool VirtualI2C::CheckForDevice(uint32_t address) {
+		Transact(0);
+		return address == m_Address;
+	}
+
+	std::vector<uint32_t> VirtualI2C::ScanForDevices() {
+		return { m_Address };
+	}
+
+	ssize_t VirtualI2C::WriteToDevice(uint32_t address, void* data, size_t size) {
+		if (address != m_Address)
+			return -1;
+
+		Transact(size);
+		WriteRegisters(reinterpret_cast<const uint8_t*>(data), size);
+		return static_cast<ssize_t>(size);
+	}
+
+	ssize_t VirtualI2C::ReadFromDevice(uint32_t address, void* data, size_t size) {
+		if (address != m_Address)
+			return -1;
+
+		Transact(size);
+		ReadConversions(reinterpret_cast<uint8_t*>(data), size);
+		return static_cast<ssize_t>(size);
+	}
+
+	ssize_t VirtualI2C::WriteReadDevice(uint32_t address, const void* writeData, size_t writeSize, void* readData, size_t readSize) {
+		if (address != m_Address)
+			return -1;
+
+		Transact(writeSize + readSize);
+		WriteRegisters(reinterpret_cast<const uint8_t*>(writeData), writeSize);
+		ReadConversions(reinterpret_cast<uint8_t*>(readData), readSize);
+		return static_cast<ssize_t>(readSize);
+	}
+
+	void VirtualI2C::Transact(size_t bytes) {
+		auto latency = m_TransactionLatency + m_ByteLatency * static_cast<int64_t>(bytes);
+		if (latency.count() > 0)
+			std::this_thread::sleep_for(latency);
+	}
+
+	void VirtualI2C::WriteRegisters(const uint8_t* data, size_t size) {
+		// First byte is the control byte, anything after it is DAC data
+		// which is not emulated.
+		if (size == 0)
+			return;
+
+		m_ControlByte = data[0];
+		m_Channel = m_ControlByte & 0b11;
+	}
+
+	void VirtualI2C::ReadConversions(uint8_t* data, size_t size) {
+		// Like the real part, each byte read returns the previous conversion
+		// and starts a new one on the selected channel.
+		bool autoIncrement = m_ControlByte & (1 << 2);
+		for (size_t i = 0; i < size; i++) {
+			data[i] = m_LastConversion;
+			m_LastConversion = m_Input(m_Channel);
+			if (autoIncrement)
+				m_Channel = (m_Channel + 1) & 0b11;
+		}
+	}
+}
+
@@ -0,0 +1,50 @@
+#ifndef CEE_VIRTUAL_I2C_H_
+#define CEE_VIRTUAL_I2C_H_
+
+#include <chrono>
+#include <functional>
+
+#include "i2c.hh"
+
+namespace cee {
+	// In-process I2C bus with a single emulated PCF8591 attached, for running
+	// the acquisition path without the hat.
+	class VirtualI2C : public I2C {
+	public:
+		// Returns the 8-bit conversion result for an analog input.
+		using InputCallback = std::function<uint8_t(uint32_t channel)>;
+
+	public:
+		// Each transaction costs `transactionLatency` plus `byteLatency` per
+		// byte moved, roughly 90 us per byte on a 100 kHz bus.
+		VirtualI2C(uint32_t address, const InputCallback& input,
+				std::chrono::microseconds transactionLatency = std::chrono::microseconds(0),
+				std::chrono::microseconds byteLatency = std::chrono::microseconds(0));
+		virtual ~VirtualI2C() = default;
+
+		virtual bool CheckForDevice(uint32_t address) override;
+		virtual std::vector<uint32_t> ScanForDevices() override;
+
+		virtual ssize_t WriteToDevice(uint32_t address, void* data, size_t size) override;
+		virtual ssize_t ReadFromDevice(uint32_t address, void* data, size_t size) override;
+		virtual ssize_t WriteReadDevice(uint32_t address, const void* writeData, size_t writeSize, void* readData, size_t readSize) override;
+
+	private:
+		void Transact(size_t bytes);
+		void WriteRegisters(const uint8_t* data, size_t size);
+		void ReadConversions(uint8_t* data, size_t size);
+
+	private:
+		uint32_t m_Address;
+		InputCallback m_Input;
+		std::chrono::microseconds m_TransactionLatency;
+		std::chrono::microseconds m_ByteLatency;
+
+		uint8_t m_ControlByte;
+		uint8_t m_Channel;
+		uint8_t m_LastConversion;
+	};
+}
+
+#endif
+
@@ -0,0 +1,138 @@
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <sys/stat.h>
+
+#include "util.h"
+#include "fixedPoint.hh"
+#include "sampleSource.hh"
+#include "waveformRecorder.hh"
+
+// Samples handed to the recorder at a time, as the recording thread takes
+// them from the ring.
+#define VERIFY_BATCH_SAMPLES    16
+
+static float g_SampleRate = 250.f;
+static float g_VerifyMinutes = 0.f;
+static std::string g_VerifyRhythm = "sinus";
+
+// Decodes the whole file and prints what it holds.
+static int Summarise(const std::string& filename) {
+	cee::WaveformReader reader;
+	if (!reader.Open(filename)) {
+		return EXIT_FAILURE;
+	}
+
+	std::vector<cee::EcgSample> samples;
+	uint64_t chunks = 0, count = 0;
+	int64_t first = 0, last = 0;
+	while (reader.ReadChunk(samples)) {
+		if (chunks++ == 0)
+			first = samples.front().timestamp;
+		last = samples.back().timestamp;
+		count += samples.size();
+		samples.clear();
+	}
+
+	struct stat info;
+	double bytes = stat(filename.c_str(), &info) == 0 ? static_cast<double>(info.st_size) : 0.0;
+	printf("\"%s\": %.0f Hz, %llu samples in %llu chunks, %.1f min, %.2f bits/value, %llu corrupt chunks.\n",
+			filename.c_str(), reader.GetSampleRate(), static_cast<unsigned long long>(count),
+			static_cast<unsigned long long>(chunks), (last - first) / 60e9,
+			8.0 * bytes / std::max<double>(1.0, static_cast<double>(count * cee::ECG_CHANNEL_COUNT)),
+			static_cast<unsigned long long>(reader.GetCorruptChunks()));
+	return EXIT_SUCCESS;
+}
+
+// Records synthetic ECG to a new file, reads it back and checks every
+// sample's raw values and timestamp survived the round trip.
+static int Verify(const std::string& filename) {
+	struct stat info;
+	if (stat(filename.c_str(), &info) == 0) {
+		printf("\"%s\" already exists; --verify needs a new file.\n", filename.c_str());
+		return EXIT_FAILURE;
+	}
+
+	std::unique_ptr<cee::SampleSource> source = cee::CreateSampleSource("synthetic:" + g_VerifyRhythm, g_SampleRate);
+	const uint64_t total = static_cast<uint64_t>(g_VerifyMinutes * 60.f * g_SampleRate);
+	const int64_t period = static_cast<int64_t>(NSEC_PER_SEC / g_SampleRate);
+	std::vector<cee::EcgSample> written(total);
+	for (uint64_t n = 0; n < total; n++) {
+		uint8_t codes[cee::ECG_CHANNEL_COUNT];
+		cee::EcgSample& sample = written[n];
+		sample.timestamp = static_cast<int64_t>(n) * period;
+		source->Acquire(sample.timestamp, std::span<uint8_t, 4>(codes, 4));
+		for (uint32_t channel = 0; channel < cee::ECG_CHANNEL_COUNT; channel++)
+			sample.channels[channel] = sample.raw[channel] = cee::AdcCodeToFixed(codes[channel]);
+		sample.leadsConnected = true;
+		sample.quality = 100;
+	}
+
+	{
+		cee::WaveformRecorder recorder(filename, g_SampleRate);
+		if (!recorder.IsOpen()) {
+			return EXIT_FAILURE;
+		}
+		for (uint64_t n = 0; n < total; n += VERIFY_BATCH_SAMPLES) {
+			recorder.AddSamples(&written[n], static_cast<size_t>(std::min<uint64_t>(VERIFY_BATCH_SAMPLES, total - n)), n);
+		}
+		if (!recorder.Flush()) {
+			return EXIT_FAILURE;
+		}
+		recorder.PrintStats(stdout);
+	}
+
+	cee::WaveformReader reader;
+	if (!reader.Open(filename)) {
+		return EXIT_FAILURE;
+	}
+	std::vector<cee::EcgSample> read;
+	read.reserve(total);
+	while (reader.ReadChunk(read)) {
+	}
+
+	if (reader.GetSampleRate() != g_SampleRate || reader.GetCorruptChunks() != 0 || read.size() != total) {
+		printf("Read back %zu of %llu samples at %.0f Hz with %llu corrupt chunks.\n", read.size(),
+				static_cast<unsigned long long>(total), reader.GetSampleRate(),
+				static_cast<unsigned long long>(reader.GetCorruptChunks()));
+		return EXIT_FAILURE;
+	}
+	for (uint64_t n = 0; n < total; n++) {
+		if (read[n].timestamp != written[n].timestamp
+				|| memcmp(read[n].raw, written[n].raw, sizeof(written[n].raw)) != 0) {
+			printf("Sample %llu differs after the round trip.\n", static_cast<unsigned long long>(n));
+			return EXIT_FAILURE;
+		}
+	}
+	printf("Round trip of %llu samples (%.1f min of %s rhythm at %.0f Hz) matches.\n",
+			static_cast<unsigned long long>(total), g_VerifyMinutes, g_VerifyRhythm.c_str(), g_SampleRate);
+	return EXIT_SUCCESS;
+}
+
+int main(int argc, char** arg) {
+	std::string recording;
+	for (int i = 1; i < argc; i++) {
+		if (strncmp(arg[i], "--rate=", 7) == 0) {
+			g_SampleRate = std::max(50.f, strtof(arg[i] + 7, nullptr));
+		} else if (strncmp(arg[i], "--verify=", 9) == 0) {
+			g_VerifyMinutes = std::max(0.f, strtof(arg[i] + 9, nullptr));
+		} else if (strncmp(arg[i], "--rhythm=", 9) == 0) {
+			g_VerifyRhythm = arg[i] + 9;
+		} else if (arg[i][0] != '-') {
+			recording = arg[i];
+		}
+	}
+
+	if (recording.empty()) {
+		printf("Usage: %s recording\n"
+				"       %s --verify=minutes [--rhythm=sinus|tachy|brady|pvc|asystole] [--rate=Hz] new-recording\n", arg[0], arg[0]);
+		return EXIT_FAILURE;
+	}
+	return g_VerifyMinutes > 0.f ? Verify(recording) : Summarise(recording);
+}
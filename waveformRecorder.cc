@@ -0,0 +1,510 @@
+#include "waveformRecorder.hh"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "util.h"
+
+namespace cee {
+	// Headers are written as laid out in memory.
+	static_assert(__BYTE_ORDER == __LITTLE_ENDIAN, "Waveform files are little endian.");
+
+	constexpr char FILE_MAGIC[4] = { 'C', 'E', 'E', 'W' };
+	constexpr char CHUNK_MAGIC[4] = { 'C', 'E', 'E', 'C' };
+	constexpr uint32_t FILE_VERSION = 1;
+
+	struct FileHeader {
+		char magic[4];
+		uint32_t version;
+		float sampleRate;
+		uint32_t channelCount;
+	};
+	static_assert(sizeof(FileHeader) == 16);
+
+	struct ChunkHeader {
+		char magic[4];
+		uint32_t payloadSize;
+		uint32_t crc;            // over this header with crc zeroed, then the payload
+		uint16_t sampleCount;
+		uint8_t channelCount;
+		uint8_t flags;
+		int64_t firstTimestamp;
+		int64_t lastTimestamp;
+	};
+	static_assert(sizeof(ChunkHeader) == 32);
+
+	// Residuals with a quotient this large are written raw after the
+	// escape, so one lead-off step can't cost hundreds of unary bits.
+	constexpr uint32_t RICE_ESCAPE = 24;
+	constexpr uint32_t RICE_RAW_BITS = 32;
+	constexpr uint32_t MAX_RICE_PARAMETER = 15;
+	// Per channel: predictor order and shift, Rice parameter, first value.
+	constexpr size_t CHANNEL_HEADER_BYTES = 4;
+	constexpr size_t MAX_PAYLOAD_BYTES = ECG_CHANNEL_COUNT * (CHANNEL_HEADER_BYTES
+			+ (WaveformRecorder::MAX_CHUNK_SAMPLES * (RICE_ESCAPE + RICE_RAW_BITS) + 7) / 8);
+
+	// CRC-32 (IEEE 802.3, reflected), as used by zlib.
+	static constexpr std::array<uint32_t, 256> MakeCrcTable() {
+		std::array<uint32_t, 256> table = {};
+		for (uint32_t i = 0; i < 256; i++) {
+			uint32_t crc = i;
+			for (int bit = 0; bit < 8; bit++)
+				crc = (crc >> 1) ^ ((crc & 1) ? 0xedb88320u : 0u);
+			table[i] = crc;
+		}
+		return table;
+	}
+	static constexpr std::array<uint32_t, 256> CRC_TABLE = MakeCrcTable();
+
+	static uint32_t UpdateCrc(uint32_t crc, const uint8_t* data, size_t size) {
+		crc = ~crc;
+		for (size_t i = 0; i < size; i++)
+			crc = CRC_TABLE[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+		return ~crc;
+	}
+
+	static uint32_t ZigZag(int32_t value) {
+		return (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31);
+	}
+
+	static int32_t UnZigZag(uint32_t value) {
+		return static_cast<int32_t>(value >> 1) ^ -static_cast<int32_t>(value & 1);
+	}
+
+	static uint32_t RiceBits(uint32_t value, uint32_t k) {
+		uint32_t quotient = value >> k;
+		return quotient < RICE_ESCAPE ? quotient + 1 + k : RICE_ESCAPE + RICE_RAW_BITS;
+	}
+
+	namespace {
+		class BitWriter {
+		public:
+			BitWriter(std::vector<uint8_t>& out)
+			 : m_Out(out), m_Bits(0), m_Count(0)
+			{
+			}
+
+			// Up to 32 bits, least significant first.
+			void Put(uint32_t value, uint32_t count) {
+				m_Bits |= static_cast<uint64_t>(value & (count == 32 ? ~0u : (1u << count) - 1)) << m_Count;
+				m_Count += count;
+				while (m_Count >= 8) {
+					m_Out.push_back(static_cast<uint8_t>(m_Bits));
+					m_Bits >>= 8;
+					m_Count -= 8;
+				}
+			}
+
+			void PutRice(uint32_t value, uint32_t k) {
+				uint32_t quotient = value >> k;
+				if (quotient >= RICE_ESCAPE) {
+					Put((1u << RICE_ESCAPE) - 1, RICE_ESCAPE);
+					Put(value, RICE_RAW_BITS);
+					return;
+				}
+				// Quotient ones then a zero.
+				Put((1u << quotient) - 1, quotient + 1);
+				Put(value, k);
+			}
+
+			void Align() {
+				if (m_Count > 0)
+					Put(0, 8 - m_Count);
+			}
+
+		private:
+			std::vector<uint8_t>& m_Out;
+			uint64_t m_Bits;
+			uint32_t m_Count;
+		};
+
+		class BitReader {
+		public:
+			BitReader(const uint8_t* data, size_t size)
+			 : m_Data(data), m_Size(size), m_Position(0), m_Bits(0), m_Count(0), m_Overrun(false)
+			{
+			}
+
+			uint32_t Get(uint32_t count) {
+				while (m_Count < count) {
+					if (m_Position < m_Size) {
+						m_Bits |= static_cast<uint64_t>(m_Data[m_Position++]) << m_Count;
+					} else {
+						m_Overrun = true;
+					}
+					m_Count += 8;
+				}
+				uint32_t value = static_cast<uint32_t>(m_Bits & (count == 32 ? ~0u : (1u << count) - 1));
+				m_Bits >>= count;
+				m_Count -= count;
+				return value;
+			}
+
+			uint32_t GetRice(uint32_t k) {
+				uint32_t quotient = 0;
+				while (quotient < RICE_ESCAPE && Get(1))
+					quotient++;
+				if (quotient == RICE_ESCAPE)
+					return Get(RICE_RAW_BITS);
+				return (quotient << k) | Get(k);
+			}
+
+			// Drops the rest of the current byte.
+			void Align() {
+				m_Bits >>= m_Count % 8;
+				m_Count -= m_Count % 8;
+			}
+
+			bool Overrun() const { return m_Overrun; }
+
+		private:
+			const uint8_t* m_Data;
+			size_t m_Size;
+			size_t m_Position;
+			uint64_t m_Bits;
+			uint32_t m_Count;
+			bool m_Overrun;
+		};
+
+		void EncodeChannel(const EcgSample* samples, size_t count, uint32_t channel, std::vector<uint8_t>& out) {
+			uint32_t setBits = 0;
+			for (size_t n = 0; n < count; n++)
+				setBits |= static_cast<uint16_t>(samples[n].raw[channel]);
+			const uint32_t shift = setBits ? std::min<uint32_t>(std::countr_zero(setBits), 15) : 0;
+
+			// Both predictors' residuals, costed for every Rice parameter.
+			uint32_t residuals[2][WaveformRecorder::MAX_CHUNK_SAMPLES];
+			uint64_t bits[2][MAX_RICE_PARAMETER + 1] = {};
+			int32_t previous = samples[0].raw[channel] >> shift;
+			int32_t previousDelta = 0;
+			for (size_t n = 1; n < count; n++) {
+				int32_t value = samples[n].raw[channel] >> shift;
+				int32_t delta = value - previous;
+				residuals[0][n] = ZigZag(delta);
+				residuals[1][n] = ZigZag(n == 1 ? delta : delta - previousDelta);
+				previous = value;
+				previousDelta = delta;
+				for (uint32_t order = 0; order < 2; order++) {
+					for (uint32_t k = 0; k <= MAX_RICE_PARAMETER; k++)
+						bits[order][k] += RiceBits(residuals[order][n], k);
+				}
+			}
+
+			uint32_t bestOrder = 0, bestK = 0;
+			for (uint32_t order = 0; order < 2; order++) {
+				for (uint32_t k = 0; k <= MAX_RICE_PARAMETER; k++) {
+					if (bits[order][k] < bits[bestOrder][bestK]) {
+						bestOrder = order;
+						bestK = k;
+					}
+				}
+			}
+
+			uint16_t first = static_cast<uint16_t>(samples[0].raw[channel]);
+			out.push_back(static_cast<uint8_t>(bestOrder | (shift << 1)));
+			out.push_back(static_cast<uint8_t>(bestK));
+			out.push_back(static_cast<uint8_t>(first));
+			out.push_back(static_cast<uint8_t>(first >> 8));
+
+			BitWriter writer(out);
+			for (size_t n = 1; n < count; n++)
+				writer.PutRice(residuals[bestOrder][n], bestK);
+			writer.Align();
+		}
+
+		bool DecodeChannel(BitReader& reader, EcgSample* samples, size_t count, uint32_t channel) {
+			uint32_t mode = reader.Get(8);
+			uint32_t k = reader.Get(8);
+			uint32_t first = reader.Get(16);
+			if (k > MAX_RICE_PARAMETER || mode > 0x1f)
+				return false;
+			const uint32_t order = mode & 1;
+			const uint32_t shift = mode >> 1;
+
+			samples[0].raw[channel] = static_cast<EcgFixed>(first);
+			int32_t previous = samples[0].raw[channel] >> shift;
+			int32_t previousDelta = 0;
+			for (size_t n = 1; n < count; n++) {
+				int32_t residual = UnZigZag(reader.GetRice(k));
+				int32_t delta = (order == 0 || n == 1) ? residual : residual + previousDelta;
+				int32_t value = previous + delta;
+				samples[n].raw[channel] = static_cast<EcgFixed>(value * (1 << shift));
+				previous = value;
+				previousDelta = delta;
+			}
+			reader.Align();
+			return !reader.Overrun();
+		}
+	}
+
+	WaveformRecorder::WaveformRecorder(const std::string& filename, float sampleRate, size_t chunkSamples,
+			int64_t syncPeriodNs, size_t writeBlockBytes)
+	 : m_Fd(-1), m_Filename(filename), m_ChunkSamples(std::clamp<size_t>(chunkSamples, 2, MAX_CHUNK_SAMPLES)),
+	   m_SyncPeriod(syncPeriodNs), m_WriteBlock(writeBlockBytes), m_NextSequence(0), m_HaveSequence(false),
+	   m_LastSync(0), m_HaveSync(false)
+	{
+		memset(&m_Stats, 0, sizeof(m_Stats));
+		m_Chunk.reserve(m_ChunkSamples);
+		m_Pending.reserve(m_WriteBlock + sizeof(ChunkHeader) + MAX_PAYLOAD_BYTES);
+
+		m_Fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+		if (m_Fd < 0) {
+			printf("Failed to open recording \"%s\": %s.\n", filename.c_str(), strerror(errno));
+			return;
+		}
+
+		struct stat info;
+		if (fstat(m_Fd, &info) == 0 && info.st_size > 0) {
+			// Appending to an earlier session; its header must match.
+			FileHeader header;
+			int readFd = open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+			bool valid = readFd >= 0 && read(readFd, &header, sizeof(header)) == sizeof(header)
+					&& memcmp(header.magic, FILE_MAGIC, sizeof(header.magic)) == 0
+					&& header.version == FILE_VERSION && header.channelCount == ECG_CHANNEL_COUNT;
+			if (readFd >= 0)
+				close(readFd);
+			if (!valid) {
+				printf("\"%s\" exists and is not a waveform recording.\n", filename.c_str());
+				close(m_Fd);
+				m_Fd = -1;
+			} else if (header.sampleRate != sampleRate) {
+				// Chunks carry no rate of their own, so mixing rates would
+				// silently mistime the earlier session or this one.
+				printf("\"%s\" was recorded at %.0f Hz, not %.0f Hz.\n", filename.c_str(), header.sampleRate, sampleRate);
+				close(m_Fd);
+				m_Fd = -1;
+			}
+			return;
+		}
+
+		FileHeader header;
+		memcpy(header.magic, FILE_MAGIC, sizeof(header.magic));
+		header.version = FILE_VERSION;
+		header.sampleRate = sampleRate;
+		header.channelCount = ECG_CHANNEL_COUNT;
+		const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&header);
+		m_Pending.insert(m_Pending.end(), bytes, bytes + sizeof(header));
+	}
+
+	WaveformRecorder::~WaveformRecorder() {
+		if (m_Fd < 0)
+			return;
+		Flush();
+		close(m_Fd);
+	}
+
+	void WaveformRecorder::AddSamples(const EcgSample* samples, size_t count, uint64_t firstSequence) {
+		if (m_Fd < 0 || count == 0)
+			return;
+
+		// Samples between chunks can't be spaced evenly across a gap.
+		if (m_HaveSequence && firstSequence != m_NextSequence) {
+			m_Stats.droppedSamples += firstSequence - m_NextSequence;
+			EndChunk();
+		}
+		m_NextSequence = firstSequence + count;
+		m_HaveSequence = true;
+
+		for (size_t n = 0; n < count; n++) {
+			if (!m_HaveSync) {
+				m_LastSync = samples[n].timestamp;
+				m_HaveSync = true;
+			}
+			m_Chunk.push_back(samples[n]);
+			if (m_Chunk.size() == m_ChunkSamples)
+				EndChunk();
+
+			// EndChunk syncs each full write block as it goes out. At rates
+			// too low to fill a block within the sync period, the completed
+			// chunks are synced here instead, leaving the open chunk alone
+			// so that no sync costs an extra chunk header.
+			if (samples[n].timestamp - m_LastSync >= m_SyncPeriod) {
+				Sync();
+				m_LastSync = samples[n].timestamp;
+			}
+		}
+		m_Stats.samples += count;
+	}
+
+	bool WaveformRecorder::Flush() {
+		if (m_Fd < 0)
+			return false;
+
+		EndChunk();
+		return Sync();
+	}
+
+	bool WaveformRecorder::Sync() {
+		if (!WritePending())
+			return false;
+		if (fdatasync(m_Fd) != 0) {
+			printf("Failed to sync \"%s\": %s.\n", m_Filename.c_str(), strerror(errno));
+			return false;
+		}
+		m_Stats.syncs++;
+		return true;
+	}
+
+	void WaveformRecorder::EndChunk() {
+		if (m_Chunk.empty())
+			return;
+
+		size_t headerOffset = m_Pending.size();
+		m_Pending.resize(headerOffset + sizeof(ChunkHeader));
+		for (uint32_t channel = 0; channel < ECG_CHANNEL_COUNT; channel++)
+			EncodeChannel(m_Chunk.data(), m_Chunk.size(), channel, m_Pending);
+
+		ChunkHeader header;
+		memcpy(header.magic, CHUNK_MAGIC, sizeof(header.magic));
+		header.payloadSize = static_cast<uint32_t>(m_Pending.size() - headerOffset - sizeof(ChunkHeader));
+		header.crc = 0;
+		header.sampleCount = static_cast<uint16_t>(m_Chunk.size());
+		header.channelCount = ECG_CHANNEL_COUNT;
+		header.flags = 0;
+		header.firstTimestamp = m_Chunk.front().timestamp;
+		header.lastTimestamp = m_Chunk.back().timestamp;
+		memcpy(&m_Pending[headerOffset], &header, sizeof(header));
+		header.crc = UpdateCrc(0, &m_Pending[headerOffset], m_Pending.size() - headerOffset);
+		memcpy(&m_Pending[headerOffset], &header, sizeof(header));
+
+		m_Stats.chunks++;
+		m_Stats.bytes += m_Pending.size() - headerOffset;
+		const int64_t lastTimestamp = m_Chunk.back().timestamp;
+		m_Chunk.clear();
+
+		if (m_Pending.size() >= m_WriteBlock && Sync())
+			m_LastSync = lastTimestamp;
+	}
+
+	bool WaveformRecorder::WritePending() {
+		size_t written = 0;
+		while (written < m_Pending.size()) {
+			ssize_t result = write(m_Fd, m_Pending.data() + written, m_Pending.size() - written);
+			if (result < 0) {
+				if (errno == EINTR)
+					continue;
+				// The buffered chunks are dropped rather than letting the
+				// backlog grow without bound on a failing card.
+				printf("Failed to write \"%s\": %s.\n", m_Filename.c_str(), strerror(errno));
+				m_Pending.clear();
+				return false;
+			}
+			written += static_cast<size_t>(result);
+		}
+		if (written > 0)
+			m_Stats.writes++;
+		m_Pending.clear();
+		return true;
+	}
+
+	void WaveformRecorder::PrintStats(FILE* stream) const {
+		// Against 8-bit codes per channel, as the ADC delivers them, and
+		// against EcgSample's timestamp plus 16-bit raw channels.
+		double codeBytes = static_cast<double>(m_Stats.samples * ECG_CHANNEL_COUNT);
+		double fixedBytes = static_cast<double>(m_Stats.samples) * (sizeof(int64_t) + ECG_CHANNEL_COUNT * sizeof(EcgFixed));
+		double bytes = static_cast<double>(std::max<uint64_t>(1, m_Stats.bytes));
+		fprintf(stream, "Recorder: %llu samples in %llu chunks, %llu bytes (%.2f bits/value, %.1fx vs 8-bit codes, %.1fx vs 16-bit + timestamp), %llu writes, %llu syncs, %llu samples dropped\n",
+				static_cast<unsigned long long>(m_Stats.samples), static_cast<unsigned long long>(m_Stats.chunks),
+				static_cast<unsigned long long>(m_Stats.bytes), 8.0 * bytes / std::max(1.0, codeBytes),
+				codeBytes / bytes, fixedBytes / bytes, static_cast<unsigned long long>(m_Stats.writes),
+				static_cast<unsigned long long>(m_Stats.syncs), static_cast<unsigned long long>(m_Stats.droppedSamples));
+	}
+
+	WaveformReader::WaveformReader()
+	 : m_File(nullptr), m_SampleRate(0.f), m_CorruptChunks(0)
+	{
+	}
+
+	WaveformReader::~WaveformReader() {
+		if (m_File)
+			fclose(m_File);
+	}
+
+	bool WaveformReader::Open(const std::string& filename) {
+		if (m_File)
+			fclose(m_File);
+		m_CorruptChunks = 0;
+
+		m_File = fopen(filename.c_str(), "rb");
+		if (!m_File) {
+			printf("Failed to open recording \"%s\": %s.\n", filename.c_str(), strerror(errno));
+			return false;
+		}
+
+		FileHeader header;
+		if (fread(&header, sizeof(header), 1, m_File) != 1 || memcmp(header.magic, FILE_MAGIC, sizeof(header.magic)) != 0
+				|| header.version != FILE_VERSION || header.channelCount != ECG_CHANNEL_COUNT) {
+			printf("\"%s\" is not a waveform recording.\n", filename.c_str());
+			fclose(m_File);
+			m_File = nullptr;
+			return false;
+		}
+		m_SampleRate = header.sampleRate;
+		return true;
+	}
+
+	bool WaveformReader::ReadChunk(std::vector<EcgSample>& samples) {
+		if (!m_File)
+			return false;
+
+		while (true) {
+			long start = ftell(m_File);
+			ChunkHeader header;
+			if (fread(&header, sizeof(header), 1, m_File) != 1)
+				return false;
+
+			bool valid = memcmp(header.magic, CHUNK_MAGIC, sizeof(header.magic)) == 0
+					&& header.payloadSize <= MAX_PAYLOAD_BYTES && header.sampleCount > 0
+					&& header.sampleCount <= WaveformRecorder::MAX_CHUNK_SAMPLES && header.channelCount == ECG_CHANNEL_COUNT;
+			if (valid) {
+				m_Payload.resize(header.payloadSize);
+				if (fread(m_Payload.data(), 1, m_Payload.size(), m_File) != m_Payload.size()) {
+					// Torn by power loss mid-write.
+					m_CorruptChunks++;
+					return false;
+				}
+				uint32_t crc = header.crc;
+				header.crc = 0;
+				valid = UpdateCrc(UpdateCrc(0, reinterpret_cast<const uint8_t*>(&header), sizeof(header)), m_Payload.data(), m_Payload.size()) == crc;
+			}
+
+			if (valid) {
+				size_t offset = samples.size();
+				samples.resize(offset + header.sampleCount);
+				EcgSample* chunk = samples.data() + offset;
+				BitReader reader(m_Payload.data(), m_Payload.size());
+				for (uint32_t channel = 0; channel < ECG_CHANNEL_COUNT && valid; channel++)
+					valid = DecodeChannel(reader, chunk, header.sampleCount, channel);
+				if (valid) {
+					const int64_t span = header.lastTimestamp - header.firstTimestamp;
+					const size_t intervals = std::max<size_t>(1, header.sampleCount - 1);
+					for (size_t n = 0; n < header.sampleCount; n++) {
+						chunk[n].timestamp = header.firstTimestamp + static_cast<int64_t>(span * static_cast<double>(n) / intervals);
+						std::copy(chunk[n].raw, chunk[n].raw + ECG_CHANNEL_COUNT, chunk[n].channels);
+						chunk[n].leadsConnected = true;
+						chunk[n].quality = 0;
+					}
+					return true;
+				}
+				samples.resize(offset);
+			}
+
+			// Resume at the next chunk magic after this one's start.
+			m_CorruptChunks++;
+			fseek(m_File, start + 1, SEEK_SET);
+			int matched = 0, c;
+			while (matched < 4 && (c = fgetc(m_File)) != EOF)
+				matched = c == CHUNK_MAGIC[matched] ? matched + 1 : (c == CHUNK_MAGIC[0] ? 1 : 0);
+			if (matched < 4)
+				return false;
+			fseek(m_File, -4, SEEK_CUR);
+		}
+	}
+}
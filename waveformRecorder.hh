@@ -0,0 +1,117 @@
+#ifndef CEE_WAVEFORM_RECORDER_H_
+#define CEE_WAVEFORM_RECORDER_H_
+
+#include <string>
+#include <vector>
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+
+#include "ecgSample.hh"
+
+namespace cee {
+	// Append-only waveform file. A 16-byte file header (magic "CEEW",
+	// version, sample rate, channel count) is followed by self-contained
+	// chunks, each a 32-byte header and a payload:
+	//
+	//   magic "CEEC", payload size, CRC-32 of header and payload,
+	//   sample count, channel count, flags, first and last timestamp (ns)
+	//
+	// The payload holds every channel's raw values in turn. A channel is
+	// the first value, then the residuals of a first- or second-order
+	// predictor, zig-zag mapped and Rice coded with the parameter that
+	// minimises the chunk's size. Trailing zero bits shared by the whole
+	// channel (the fraction bits of unfiltered ADC codes) are dropped.
+	// Samples are evenly spaced between the chunk's timestamps; a gap in
+	// acquisition ends a chunk. Everything is little endian.
+	//
+	// A torn or corrupted chunk fails its CRC and the reader resumes at the
+	// next chunk magic.
+	struct WaveformRecorderStats {
+		uint64_t samples;
+		uint64_t chunks;
+		uint64_t bytes;          // chunk headers and payloads
+		uint64_t writes;
+		uint64_t syncs;
+		uint64_t droppedSamples; // overwritten in the ring before recording
+	};
+
+	class WaveformRecorder {
+	public:
+		static constexpr size_t MAX_CHUNK_SAMPLES = 4096;
+
+	public:
+		// Appends to `filename`, creating it if needed; an existing file
+		// must have been recorded at the same rate. Chunks are written and
+		// synced in blocks of `writeBlockBytes`, so the card sees few large
+		// writes rather than one per chunk. At low rates a block takes
+		// minutes to fill (about 9 at 68 Hz), so completed chunks are also
+		// synced once `syncPeriodNs` of sample time has passed without one.
+		// On power failure the samples since the last sync are lost: up to
+		// a sync period plus a chunk.
+		WaveformRecorder(const std::string& filename, float sampleRate, size_t chunkSamples = 512,
+				int64_t syncPeriodNs = 300000000000ll, size_t writeBlockBytes = 65536);
+		~WaveformRecorder();
+
+		WaveformRecorder(const WaveformRecorder&) = delete;
+		WaveformRecorder& operator=(const WaveformRecorder&) = delete;
+
+		bool IsOpen() const { return m_Fd >= 0; }
+
+		// Samples in ring order; `firstSequence` is the ring sequence of the
+		// first, used to notice samples the recorder fell behind on.
+		void AddSamples(const EcgSample* samples, size_t count, uint64_t firstSequence);
+		// Ends the current chunk and writes and syncs everything buffered.
+		bool Flush();
+
+		const WaveformRecorderStats& GetStats() const { return m_Stats; }
+		void PrintStats(FILE* stream) const;
+
+	private:
+		void EndChunk();
+		bool Sync();
+		bool WritePending();
+
+	private:
+		int m_Fd;
+		std::string m_Filename;
+		size_t m_ChunkSamples;
+		int64_t m_SyncPeriod;
+		size_t m_WriteBlock;
+
+		std::vector<EcgSample> m_Chunk;
+		uint64_t m_NextSequence;
+		bool m_HaveSequence;
+		int64_t m_LastSync;
+		bool m_HaveSync;
+
+		std::vector<uint8_t> m_Pending;
+		WaveformRecorderStats m_Stats;
+	};
+
+	// Decodes a waveform file chunk by chunk.
+	class WaveformReader {
+	public:
+		WaveformReader();
+		~WaveformReader();
+
+		bool Open(const std::string& filename);
+		float GetSampleRate() const { return m_SampleRate; }
+
+		// Appends the next valid chunk's samples to `samples`, with both the
+		// channels and raw values set to the recorded values. Returns false
+		// at the end of the file.
+		bool ReadChunk(std::vector<EcgSample>& samples);
+		// Chunks skipped for a bad CRC or a truncated tail.
+		uint64_t GetCorruptChunks() const { return m_CorruptChunks; }
+
+	private:
+		FILE* m_File;
+		float m_SampleRate;
+		uint64_t m_CorruptChunks;
+		std::vector<uint8_t> m_Payload;
+	};
+}
+
+#endif
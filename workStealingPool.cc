@@ -0,0 +1,133 @@
+#include "workStealingPool.hh"
+
+#include <algorithm>
+
+namespace cee {
+	static uint64_t PackRange(uint32_t front, uint32_t back) {
+		return (static_cast<uint64_t>(back) << 32) | front;
+	}
+
+	WorkStealingPool::WorkStealingPool(size_t threadCount)
+	 : m_ThreadCount(threadCount ? threadCount : std::max(1u, std::thread::hardware_concurrency())),
+	   m_Queues(std::make_unique<Queue[]>(m_ThreadCount)),
+	   m_Job(nullptr), m_Count(0), m_Grain(1), m_Remaining(0), m_Steals(0),
+	   m_Generation(0), m_Stop(false)
+	{
+		for (size_t i = 0; i < m_ThreadCount; i++)
+			m_Queues[i].range.store(0, std::memory_order_relaxed);
+
+		// Worker 0 is whichever thread calls ParallelFor.
+		m_Threads.reserve(m_ThreadCount - 1);
+		for (size_t i = 1; i < m_ThreadCount; i++)
+			m_Threads.emplace_back(&WorkStealingPool::WorkerMain, this, i);
+	}
+
+	WorkStealingPool::~WorkStealingPool() {
+		{
+			std::scoped_lock lock(m_Mutex);
+			m_Stop = true;
+		}
+		m_WakeCondition.notify_all();
+		for (std::thread& thread : m_Threads)
+			thread.join();
+	}
+
+	void WorkStealingPool::ParallelFor(size_t count, size_t grain, const Job& job) {
+		if (count == 0)
+			return;
+
+		grain = std::max<size_t>(1, grain);
+		const size_t chunks = (count + grain - 1) / grain;
+		m_Job = &job;
+		m_Count = count;
+		m_Grain = grain;
+		m_Remaining.store(chunks, std::memory_order_relaxed);
+
+		// Contiguous runs keep each worker on neighbouring items; the
+		// release stores publish the job to whoever pops a chunk.
+		for (size_t i = 0; i < m_ThreadCount; i++) {
+			uint32_t front = static_cast<uint32_t>(chunks * i / m_ThreadCount);
+			uint32_t back = static_cast<uint32_t>(chunks * (i + 1) / m_ThreadCount);
+			m_Queues[i].range.store(PackRange(front, back), std::memory_order_release);
+		}
+
+		if (m_ThreadCount > 1) {
+			{
+				std::scoped_lock lock(m_Mutex);
+				m_Generation++;
+			}
+			m_WakeCondition.notify_all();
+		}
+
+		RunChunks(0);
+
+		std::unique_lock lock(m_Mutex);
+		m_DoneCondition.wait(lock, [this] { return m_Remaining.load(std::memory_order_acquire) == 0; });
+		m_Job = nullptr;
+	}
+
+	void WorkStealingPool::WorkerMain(size_t index) {
+		uint64_t generation = 0;
+		while (true) {
+			{
+				std::unique_lock lock(m_Mutex);
+				m_WakeCondition.wait(lock, [&] { return m_Stop || m_Generation != generation; });
+				if (m_Stop)
+					return;
+				generation = m_Generation;
+			}
+			RunChunks(index);
+		}
+	}
+
+	void WorkStealingPool::RunChunks(size_t index) {
+		uint32_t chunk;
+		while (Pop(index, chunk) || Steal(index, chunk)) {
+			size_t begin = chunk * m_Grain;
+			(*m_Job)(begin, std::min(begin + m_Grain, m_Count));
+
+			if (m_Remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+				// Taking the lock orders this against the caller's check.
+				{
+					std::scoped_lock lock(m_Mutex);
+				}
+				m_DoneCondition.notify_all();
+			}
+		}
+	}
+
+	bool WorkStealingPool::Pop(size_t index, uint32_t& chunk) {
+		std::atomic<uint64_t>& range = m_Queues[index].range;
+		uint64_t current = range.load(std::memory_order_acquire);
+		while (true) {
+			uint32_t front = static_cast<uint32_t>(current);
+			uint32_t back = static_cast<uint32_t>(current >> 32);
+			if (front >= back)
+				return false;
+			if (range.compare_exchange_weak(current, PackRange(front + 1, back), std::memory_order_acq_rel, std::memory_order_acquire)) {
+				chunk = front;
+				return true;
+			}
+		}
+	}
+
+	bool WorkStealingPool::Steal(size_t index, uint32_t& chunk) {
+		for (size_t offset = 1; offset < m_ThreadCount; offset++) {
+			std::atomic<uint64_t>& range = m_Queues[(index + offset) % m_ThreadCount].range;
+			uint64_t current = range.load(std::memory_order_acquire);
+			while (true) {
+				uint32_t front = static_cast<uint32_t>(current);
+				uint32_t back = static_cast<uint32_t>(current >> 32);
+				if (front >= back)
+					break;
+				// From the back, away from where the owner is working.
+				if (range.compare_exchange_weak(current, PackRange(front, back - 1), std::memory_order_acq_rel, std::memory_order_acquire)) {
+					chunk = back - 1;
+					m_Steals.fetch_add(1, std::memory_order_relaxed);
+					return true;
+				}
+			}
+		}
+		return false;
+	}
+}
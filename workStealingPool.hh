@@ -0,0 +1,73 @@
+#ifndef CEE_WORK_STEALING_POOL_H_
+#define CEE_WORK_STEALING_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <cstdint>
+#include <cstddef>
+
+namespace cee {
+	// Fixed set of worker threads running fork-join rounds. Each round's
+	// chunks are dealt out to the workers in contiguous runs, so a worker
+	// normally walks neighbouring items in order; a worker that runs dry
+	// steals single chunks from the far end of another's run. A queue is
+	// one 64-bit word holding its [front, back) chunk range, so popping and
+	// stealing are each a single compare-and-swap.
+	class WorkStealingPool {
+	public:
+		using Job = std::function<void(size_t begin, size_t end)>;
+
+	public:
+		// `threadCount` includes the thread calling ParallelFor, which works
+		// through its own queue while it waits; 0 uses every hardware thread.
+		WorkStealingPool(size_t threadCount = 0);
+		~WorkStealingPool();
+
+		WorkStealingPool(const WorkStealingPool&) = delete;
+		WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+		// Calls `job` over [0, count) in chunks of at most `grain` items and
+		// returns once every chunk has finished. Not reentrant.
+		void ParallelFor(size_t count, size_t grain, const Job& job);
+
+		size_t GetThreadCount() const { return m_ThreadCount; }
+		// Chunks taken from another worker's queue since construction.
+		uint64_t GetStealCount() const { return m_Steals.load(std::memory_order_relaxed); }
+
+	private:
+		// Own line each, so neighbouring workers don't contend on a queue.
+		struct alignas(64) Queue {
+			std::atomic<uint64_t> range;
+		};
+
+		void WorkerMain(size_t index);
+		void RunChunks(size_t index);
+		bool Pop(size_t index, uint32_t& chunk);
+		bool Steal(size_t index, uint32_t& chunk);
+
+	private:
+		size_t m_ThreadCount;
+		std::unique_ptr<Queue[]> m_Queues;
+		std::vector<std::thread> m_Threads;
+
+		const Job* m_Job;
+		size_t m_Count;
+		size_t m_Grain;
+		std::atomic<size_t> m_Remaining;
+		std::atomic<uint64_t> m_Steals;
+
+		std::mutex m_Mutex;
+		std::condition_variable m_WakeCondition;
+		std::condition_variable m_DoneCondition;
+		uint64_t m_Generation;
+		bool m_Stop;
+	};
+}
+
+#endif